@@ -0,0 +1,452 @@
+// Apache 2.0 License
+// Author: Christopher Diggins of Ara 3D Inc for Speckle Systems Ltd.
+// Native benchmark of the phases of loading an IFC file through the DLL's Api, without the .NET layers.
+// Times parsing, element collection, tessellation (per IFC type), wrapper construction, bulk export
+// and the relation and property tables, and writes the results as JSON.
+// The input is either an IFC file or a synthetic file produced by IfcGenerator.
+//
+// Usage: WebIfcBench [--input file.ifc] [--output results.json] [--write-ifc synthetic.ifc]
+//                    [--storeys n] [--walls n] [--extrusions n] [--profile-sides n] [--booleans n]
+//                    [--boolean-cuts n] [--mapped n] [--mapped-shapes n] [--properties n] [--scale x]
+
+// Api.cpp is compiled into this translation unit, so that the phases can be timed separately
+// using the Model and Api internals rather than only the exported functions.
+#include "../WebIfcDll/Api.cpp"
+#include "IfcGenerator.h"
+
+#include <chrono>
+#include <map>
+#include <sstream>
+
+#ifdef _WIN32
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/resource.h>
+#endif
+
+// Peak resident set size of the process so far, in bytes
+static int64_t PeakRssBytes()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return (int64_t)counters.PeakWorkingSetSize;
+    return 0;
+#else
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+#ifdef __APPLE__
+    return (int64_t)usage.ru_maxrss;
+#else
+    return (int64_t)usage.ru_maxrss * 1024;
+#endif
+#endif
+}
+
+struct Stopwatch
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    double Seconds() const
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+};
+
+// Timing of a phase. Throughput fields are written only when non-zero.
+struct PhaseResult
+{
+    std::string name;
+    double seconds = 0;
+    int64_t bytes = 0;
+    int64_t elements = 0;
+    int64_t triangles = 0;
+    int64_t peakRssBytes = 0;
+};
+
+// Tessellation totals for one IFC type
+struct TypeResult
+{
+    double seconds = 0;
+    int64_t elements = 0;
+    int64_t meshes = 0;
+    int64_t vertices = 0;
+    int64_t triangles = 0;
+};
+
+// Minimal JSON output, written in order
+class JsonWriter
+{
+    std::ostringstream out;
+    std::vector<bool> first = { true };
+
+    void Separator()
+    {
+        if (!first.back())
+            out << ",";
+        first.back() = false;
+    }
+
+public:
+
+    JsonWriter()
+    {
+        out.precision(10);
+    }
+
+    static std::string Quote(std::string_view s)
+    {
+        std::string r = "\"";
+        for (auto c : s)
+        {
+            if (c == '"' || c == '\\')
+                r += '\\';
+            if ((unsigned char)c < 0x20)
+            {
+                char buffer[8];
+                std::snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+                r += buffer;
+                continue;
+            }
+            r += c;
+        }
+        return r + "\"";
+    }
+
+    JsonWriter& Key(std::string_view key)
+    {
+        Separator();
+        out << Quote(key) << ":";
+        first.back() = true;
+        return *this;
+    }
+
+    template<typename T>
+    JsonWriter& Value(const T& value)
+    {
+        Separator();
+        if constexpr (std::is_convertible_v<T, std::string_view>)
+            out << Quote(value);
+        else
+            out << value;
+        return *this;
+    }
+
+    template<typename T>
+    JsonWriter& Field(std::string_view key, const T& value)
+    {
+        return Key(key).Value(value);
+    }
+
+    JsonWriter& Begin(char bracket)
+    {
+        Separator();
+        out << bracket;
+        first.push_back(true);
+        return *this;
+    }
+
+    JsonWriter& End(char bracket)
+    {
+        out << bracket;
+        first.pop_back();
+        return *this;
+    }
+
+    std::string Str() const
+    {
+        return out.str();
+    }
+};
+
+static double PerSecond(double amount, double seconds)
+{
+    return seconds > 0 ? amount / seconds : 0;
+}
+
+static void WritePhase(JsonWriter& json, const PhaseResult& p)
+{
+    json.Begin('{')
+        .Field("name", p.name)
+        .Field("seconds", p.seconds);
+    if (p.bytes)
+        json.Field("bytes", p.bytes).Field("mbPerSecond", PerSecond(p.bytes / 1e6, p.seconds));
+    if (p.elements)
+        json.Field("elements", p.elements).Field("elementsPerSecond", PerSecond((double)p.elements, p.seconds));
+    if (p.triangles)
+        json.Field("triangles", p.triangles).Field("trianglesPerSecond", PerSecond((double)p.triangles, p.seconds));
+    json.Field("peakRssBytes", p.peakRssBytes)
+        .End('}');
+}
+
+static bool ParseArgs(int argc, char** argv, std::map<std::string, std::string>& args)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg.rfind("--", 0) != 0 || i + 1 >= argc)
+        {
+            std::cerr << "Unexpected argument: " << arg << std::endl;
+            return false;
+        }
+        args[arg.substr(2)] = argv[++i];
+    }
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    std::map<std::string, std::string> args;
+    if (!ParseArgs(argc, argv, args))
+        return 1;
+
+    auto intArg = [&](const char* name, int32_t& value)
+    {
+        if (args.count(name))
+            value = std::stoi(args[name]);
+    };
+
+    IfcGeneratorOptions generatorOptions;
+    intArg("storeys", generatorOptions.storeys);
+    intArg("walls", generatorOptions.walls);
+    intArg("extrusions", generatorOptions.extrusions);
+    intArg("profile-sides", generatorOptions.profileSides);
+    intArg("booleans", generatorOptions.booleans);
+    intArg("boolean-cuts", generatorOptions.booleanCuts);
+    intArg("mapped", generatorOptions.mapped);
+    intArg("mapped-shapes", generatorOptions.mappedShapes);
+    intArg("properties", generatorOptions.properties);
+    if (args.count("scale"))
+        generatorOptions.scale = std::stod(args["scale"]);
+
+    // The source must outlive the model, which may request chunks of it again
+    MappedFile file;
+    std::string generated;
+    const char* data;
+    size_t size;
+    Stopwatch generateTimer;
+    double generateSeconds = 0;
+    if (args.count("input"))
+    {
+        if (!file.Open(args["input"].c_str()))
+        {
+            std::cerr << "Could not open " << args["input"] << std::endl;
+            return 1;
+        }
+        data = file.Data();
+        size = file.Size();
+    }
+    else
+    {
+        generated = IfcGenerator(generatorOptions).Generate();
+        generateSeconds = generateTimer.Seconds();
+        data = generated.data();
+        size = generated.size();
+        if (args.count("write-ifc"))
+            std::ofstream(args["write-ifc"], std::ios::binary).write(data, (std::streamsize)size);
+    }
+
+    std::vector<PhaseResult> phases;
+    auto phase = [&](const char* name, auto body)
+    {
+        PhaseResult p;
+        p.name = name;
+        Stopwatch timer;
+        body(p);
+        p.seconds = timer.Seconds();
+        p.peakRssBytes = PeakRssBytes();
+        phases.push_back(p);
+    };
+
+    auto api = InitializeApi();
+
+    // Same steps as Api::LoadModel in lazy mode, with each one timed
+    auto modelId = api->manager->CreateModel(*api->settings);
+    auto model = new ::Model(api->manager->GetIfcLoader(modelId), api->manager->GetGeometryProcessor(modelId), modelId);
+    api->models.insert(model);
+    model->sourceData = data;
+    model->sourceSize = size;
+
+    // The engine tokenizes chunks of the source on demand while it indexes lines, so the two are timed together
+    phase("parse", [&](PhaseResult& p)
+    {
+        LoadFromMemory(model->loader, data, size);
+        p.bytes = (int64_t)size;
+    });
+
+    phase("collectElements", [&](PhaseResult& p)
+    {
+        model->CollectElements(api->schemaManager);
+        p.elements = (int64_t)model->elementIds.size();
+    });
+
+    // Every element is tessellated then wrapped on this thread, so that the time of each is attributed to its type
+    std::map<uint32_t, TypeResult> byType;
+    double tessellateSeconds = 0;
+    double wrapSeconds = 0;
+    int64_t totalTriangles = 0;
+    int64_t totalVertices = 0;
+    int64_t totalMeshes = 0;
+    for (auto eId : model->elementIds)
+    {
+        auto& t = byType[model->loader->GetLineType(eId)];
+
+        Stopwatch tessellateTimer;
+        auto flatMesh = model->geometryProcessor->GetFlatMesh(eId);
+        auto seconds = tessellateTimer.Seconds();
+        t.seconds += seconds;
+        tessellateSeconds += seconds;
+        t.elements++;
+        t.meshes += flatMesh.geometries.size();
+        for (auto& pg : flatMesh.geometries)
+        {
+            auto& g = model->geometryProcessor->GetGeometry(pg.geometryExpressID);
+            t.vertices += g.vertexData.size() / 6;
+            t.triangles += g.indexData.size() / 3;
+        }
+
+        Stopwatch wrapTimer;
+        model->geometries[eId] = model->ToGeometry(model->geometryProcessor, eId, flatMesh, &model->arena);
+        wrapSeconds += wrapTimer.Seconds();
+    }
+    for (auto& kv : byType)
+    {
+        totalTriangles += kv.second.triangles;
+        totalVertices += kv.second.vertices;
+        totalMeshes += kv.second.meshes;
+    }
+
+    PhaseResult tessellate;
+    tessellate.name = "tessellate";
+    tessellate.seconds = tessellateSeconds;
+    tessellate.elements = (int64_t)model->elementIds.size();
+    tessellate.triangles = totalTriangles;
+    tessellate.peakRssBytes = PeakRssBytes();
+    phases.push_back(tessellate);
+
+    PhaseResult wrap;
+    wrap.name = "wrappers";
+    wrap.seconds = wrapSeconds;
+    wrap.elements = (int64_t)model->elementIds.size();
+    wrap.peakRssBytes = tessellate.peakRssBytes;
+    phases.push_back(wrap);
+
+    MeshCounts counts = {};
+    phase("export", [&](PhaseResult& p)
+    {
+        VertexEncoding encoding = { VertexFormatFloat, 1, 0, 0, 0 };
+        counts = model->GetMeshCounts();
+        std::vector<uint8_t> vertices(counts.numVertices * VertexStride(encoding.format));
+        std::vector<uint32_t> indices(counts.numIndices);
+        std::vector<uint32_t> elementIds(counts.numMeshes);
+        std::vector<int64_t> vertexOffsets(counts.numMeshes);
+        std::vector<int32_t> vertexCounts(counts.numMeshes);
+        std::vector<int64_t> indexOffsets(counts.numMeshes);
+        std::vector<int32_t> indexCounts(counts.numMeshes);
+        std::vector<double> colors(counts.numMeshes * 4);
+        MeshBuffers buffers = {};
+        buffers.vertices = vertices.data();
+        buffers.indices = indices.data();
+        buffers.elementIds = elementIds.data();
+        buffers.vertexOffsets = vertexOffsets.data();
+        buffers.vertexCounts = vertexCounts.data();
+        buffers.indexOffsets = indexOffsets.data();
+        buffers.indexCounts = indexCounts.data();
+        buffers.colors = colors.data();
+        buffers.meshCapacity = counts.numMeshes;
+        buffers.vertexCapacity = counts.numVertices;
+        buffers.indexCapacity = counts.numIndices;
+        model->ExportMeshes(buffers, encoding);
+        p.bytes = (int64_t)(vertices.size() + indices.size() * sizeof(uint32_t));
+        p.elements = counts.numElements;
+        p.triangles = counts.numIndices / 3;
+    });
+
+    phase("relationIndex", [&](PhaseResult& p)
+    {
+        p.elements = (int64_t)model->GetRelationIndex().NumRelations();
+    });
+
+    phase("propertyTable", [&](PhaseResult& p)
+    {
+        p.elements = (int64_t)model->GetPropertyTable().NumRows();
+    });
+
+    auto memory = api->GetMemoryStats(model);
+
+    JsonWriter json;
+    json.Begin('{');
+    json.Key("source").Begin('{');
+    if (args.count("input"))
+    {
+        json.Field("path", args["input"]);
+    }
+    else
+    {
+        json.Key("synthetic").Begin('{')
+            .Field("storeys", generatorOptions.storeys)
+            .Field("walls", generatorOptions.walls)
+            .Field("extrusions", generatorOptions.extrusions)
+            .Field("profileSides", generatorOptions.profileSides)
+            .Field("booleans", generatorOptions.booleans)
+            .Field("booleanCuts", generatorOptions.booleanCuts)
+            .Field("mapped", generatorOptions.mapped)
+            .Field("mappedShapes", generatorOptions.mappedShapes)
+            .Field("properties", generatorOptions.properties)
+            .Field("scale", generatorOptions.scale)
+            .Field("generateSeconds", generateSeconds)
+            .End('}');
+    }
+    json.Field("bytes", (int64_t)size)
+        .Field("lines", (int64_t)model->loader->GetMaxExpressId())
+        .Field("elements", (int64_t)model->elementIds.size())
+        .Field("meshes", totalMeshes)
+        .Field("vertices", totalVertices)
+        .Field("triangles", totalTriangles)
+        .End('}');
+
+    json.Key("phases").Begin('[');
+    for (auto& p : phases)
+        WritePhase(json, p);
+    json.End(']');
+
+    json.Key("tessellationByType").Begin('[');
+    for (auto& kv : byType)
+    {
+        auto& t = kv.second;
+        json.Begin('{')
+            .Field("type", api->schemaManager->IfcTypeCodeToType(kv.first))
+            .Field("elements", t.elements)
+            .Field("meshes", t.meshes)
+            .Field("vertices", t.vertices)
+            .Field("triangles", t.triangles)
+            .Field("seconds", t.seconds)
+            .Field("elementsPerSecond", PerSecond((double)t.elements, t.seconds))
+            .Field("trianglesPerSecond", PerSecond((double)t.triangles, t.seconds))
+            .End('}');
+    }
+    json.End(']');
+
+    json.Key("memory").Begin('{')
+        .Field("sourceBytes", memory.sourceBytes)
+        .Field("tokenStreamBytes", memory.tokenStreamBytes)
+        .Field("lineIndexBytes", memory.lineIndexBytes)
+        .Field("geometryBytes", memory.geometryBytes)
+        .Field("wrapperBytes", memory.wrapperBytes)
+        .Field("tableBytes", memory.tableBytes)
+        .Field("peakRssBytes", PeakRssBytes())
+        .End('}');
+    json.End('}');
+
+    UnloadModel(api, model);
+    FinalizeApi(api);
+
+    auto result = json.Str() + "\n";
+    if (args.count("output"))
+        std::ofstream(args["output"], std::ios::binary) << result;
+    else
+        std::cout << result;
+    return 0;
+}
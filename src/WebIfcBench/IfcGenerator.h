@@ -0,0 +1,307 @@
+// Apache 2.0 License
+// Author: Christopher Diggins of Ara 3D Inc for Speckle Systems Ltd.
+// Generates synthetic IFC4 files of configurable size and composition, for benchmarking.
+// Output is deterministic for a given set of options.
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Number of elements of each kind generated on every storey
+struct IfcGeneratorOptions
+{
+    int32_t storeys = 4;
+
+    // IfcWall with an extruded rectangle
+    int32_t walls = 200;
+
+    // IfcColumn with an extruded polygon of profileSides sides
+    int32_t extrusions = 100;
+    int32_t profileSides = 16;
+
+    // IfcSlab made of an extruded rectangle with booleanCuts boxes subtracted
+    int32_t booleans = 20;
+    int32_t booleanCuts = 4;
+
+    // IfcBuildingElementProxy placing one of mappedShapes shared representation maps
+    int32_t mapped = 200;
+    int32_t mappedShapes = 8;
+
+    // Number of single value properties in a property set attached to each element, or 0 for none
+    int32_t properties = 4;
+
+    // Multiplies the number of elements of every kind
+    double scale = 1.0;
+};
+
+class IfcGenerator
+{
+    const IfcGeneratorOptions& options;
+    std::string out;
+    uint32_t nextId = 1;
+    uint64_t nextGuid = 0;
+
+    // Shared entities
+    uint32_t context = 0;
+    uint32_t zAxis = 0;
+    uint32_t xAxis = 0;
+    uint32_t origin = 0;
+    uint32_t origin2d = 0;
+    uint32_t identity = 0;
+    uint32_t buildingPlacement = 0;
+
+public:
+
+    explicit IfcGenerator(const IfcGeneratorOptions& options)
+        : options(options)
+    { }
+
+    std::string Generate()
+    {
+        out.clear();
+        nextId = 1;
+        nextGuid = 0;
+
+        out += "ISO-10303-21;\nHEADER;\n"
+            "FILE_DESCRIPTION(('ViewDefinition [ReferenceView]'),'2;1');\n"
+            "FILE_NAME('synthetic.ifc','2024-01-01T00:00:00',(''),(''),'WebIfcBench','WebIfcBench','');\n"
+            "FILE_SCHEMA(('IFC4'));\nENDSEC;\nDATA;\n";
+
+        origin = Line("IFCCARTESIANPOINT((0.,0.,0.))");
+        origin2d = Line("IFCCARTESIANPOINT((0.,0.))");
+        zAxis = Line("IFCDIRECTION((0.,0.,1.))");
+        xAxis = Line("IFCDIRECTION((1.,0.,0.))");
+        identity = Line("IFCAXIS2PLACEMENT3D(" + Ref(origin) + "," + Ref(zAxis) + "," + Ref(xAxis) + ")");
+        context = Line("IFCGEOMETRICREPRESENTATIONCONTEXT($,'Model',3,1.E-05," + Ref(identity) + ",$)");
+        auto lengthUnit = Line("IFCSIUNIT(*,.LENGTHUNIT.,$,.METRE.)");
+        auto areaUnit = Line("IFCSIUNIT(*,.AREAUNIT.,$,.SQUARE_METRE.)");
+        auto volumeUnit = Line("IFCSIUNIT(*,.VOLUMEUNIT.,$,.CUBIC_METRE.)");
+        auto angleUnit = Line("IFCSIUNIT(*,.PLANEANGLEUNIT.,$,.RADIAN.)");
+        auto units = Line("IFCUNITASSIGNMENT((" + Ref(lengthUnit) + "," + Ref(areaUnit) + ","
+            + Ref(volumeUnit) + "," + Ref(angleUnit) + "))");
+        auto project = Line("IFCPROJECT('" + Guid() + "',$,'Synthetic',$,$,$,$,(" + Ref(context) + ")," + Ref(units) + ")");
+
+        auto sitePlacement = Line("IFCLOCALPLACEMENT($," + Ref(identity) + ")");
+        auto site = Line("IFCSITE('" + Guid() + "',$,'Site',$,$," + Ref(sitePlacement) + ",$,$,.ELEMENT.,$,$,$,$,$)");
+        buildingPlacement = Line("IFCLOCALPLACEMENT(" + Ref(sitePlacement) + "," + Ref(identity) + ")");
+        auto building = Line("IFCBUILDING('" + Guid() + "',$,'Building',$,$," + Ref(buildingPlacement) + ",$,$,.ELEMENT.,$,$,$)");
+        Line("IFCRELAGGREGATES('" + Guid() + "',$,$,$," + Ref(project) + ",(" + Ref(site) + "))");
+        Line("IFCRELAGGREGATES('" + Guid() + "',$,$,$," + Ref(site) + ",(" + Ref(building) + "))");
+
+        auto maps = MakeRepresentationMaps();
+
+        std::string storeys;
+        for (int32_t s = 0; s < options.storeys; ++s)
+        {
+            auto storey = MakeStorey(s, maps);
+            storeys += (storeys.empty() ? "" : ",") + Ref(storey);
+        }
+        if (!storeys.empty())
+            Line("IFCRELAGGREGATES('" + Guid() + "',$,$,$," + Ref(building) + ",(" + storeys + "))");
+
+        out += "ENDSEC;\nEND-ISO-10303-21;\n";
+        return std::move(out);
+    }
+
+    // Total number of elements with geometry that Generate() produces
+    int64_t NumElements() const
+    {
+        return (int64_t)options.storeys
+            * (Count(options.walls) + Count(options.extrusions) + Count(options.booleans) + Count(options.mapped));
+    }
+
+private:
+
+    int64_t Count(int32_t n) const
+    {
+        return (int64_t)(n * options.scale + 0.5);
+    }
+
+    uint32_t Line(const std::string& entity)
+    {
+        auto id = nextId++;
+        out += "#" + std::to_string(id) + "=" + entity + ";\n";
+        return id;
+    }
+
+    static std::string Ref(uint32_t id)
+    {
+        return "#" + std::to_string(id);
+    }
+
+    static std::string Real(double x)
+    {
+        char buffer[32];
+        std::snprintf(buffer, sizeof(buffer), "%.6G", x);
+        // STEP reals always have a decimal point
+        std::string r = buffer;
+        if (r.find('.') == std::string::npos)
+            r.insert(std::min(r.find('E'), r.size()), ".");
+        return r;
+    }
+
+    std::string Point(double x, double y, double z)
+    {
+        return Ref(Line("IFCCARTESIANPOINT((" + Real(x) + "," + Real(y) + "," + Real(z) + "))"));
+    }
+
+    std::string Point(double x, double y)
+    {
+        return Ref(Line("IFCCARTESIANPOINT((" + Real(x) + "," + Real(y) + "))"));
+    }
+
+    // A unique IFC GlobalId: 128 bits in the 22 character IFC base 64 encoding
+    std::string Guid()
+    {
+        static const char* digits = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz_$";
+        uint64_t hi = 0x5EEDB17C0FFEE000ull;
+        uint64_t lo = ++nextGuid * 0x9E3779B97F4A7C15ull;
+        std::string r(22, '0');
+        // The first character holds the top 2 bits, every other character 6 bits
+        r[0] = digits[hi >> 62];
+        for (int i = 1; i < 22; ++i)
+        {
+            auto shift = 126 - 6 * i;
+            uint64_t v = shift >= 64
+                ? hi >> (shift - 64)
+                : (lo >> shift) | (shift > 0 ? hi << (64 - shift) : 0);
+            r[i] = digits[v & 63];
+        }
+        return r;
+    }
+
+    std::string Placement(double x, double y, double z, uint32_t relativeTo)
+    {
+        auto axes = Line("IFCAXIS2PLACEMENT3D(" + Point(x, y, z) + "," + Ref(zAxis) + "," + Ref(xAxis) + ")");
+        return Ref(Line("IFCLOCALPLACEMENT(" + Ref(relativeTo) + "," + Ref(axes) + ")"));
+    }
+
+    std::string Extrusion(const std::string& profile, double x, double y, double z, double depth)
+    {
+        auto position = Line("IFCAXIS2PLACEMENT3D(" + Point(x, y, z) + ",$,$)");
+        return Ref(Line("IFCEXTRUDEDAREASOLID(" + profile + "," + Ref(position) + "," + Ref(zAxis) + "," + Real(depth) + ")"));
+    }
+
+    std::string Rectangle(double dx, double dy)
+    {
+        auto position = Line("IFCAXIS2PLACEMENT2D(" + Ref(origin2d) + ",$)");
+        return Ref(Line("IFCRECTANGLEPROFILEDEF(.AREA.,$," + Ref(position) + "," + Real(dx) + "," + Real(dy) + ")"));
+    }
+
+    std::string Polygon(int32_t sides, double radius)
+    {
+        std::string points;
+        for (int32_t i = 0; i <= sides; ++i)
+        {
+            auto a = 6.283185307179586 * (i % sides) / sides;
+            points += (i == 0 ? "" : ",") + Point(radius * std::cos(a), radius * std::sin(a));
+        }
+        auto polyline = Line("IFCPOLYLINE((" + points + "))");
+        return Ref(Line("IFCARBITRARYCLOSEDPROFILEDEF(.AREA.,$," + Ref(polyline) + ")"));
+    }
+
+    std::string Shape(const std::string& items, const char* type)
+    {
+        auto rep = Line("IFCSHAPEREPRESENTATION(" + Ref(context) + ",'Body','" + type + "',(" + items + "))");
+        return Ref(Line("IFCPRODUCTDEFINITIONSHAPE($,$,(" + Ref(rep) + "))"));
+    }
+
+    std::string Element(const char* entity, const char* name, const std::string& placement, const std::string& shape)
+    {
+        return Ref(Line(std::string(entity) + "('" + Guid() + "',$,'" + name + "',$,$," + placement + "," + shape + ",$,$)"));
+    }
+
+    std::vector<std::string> MakeRepresentationMaps()
+    {
+        std::vector<std::string> maps;
+        for (int32_t i = 0; i < options.mappedShapes; ++i)
+        {
+            auto body = Extrusion(Polygon(6 + 2 * i, 0.3 + 0.05 * i), 0, 0, 0, 0.8 + 0.1 * i);
+            auto top = Extrusion(Rectangle(1.2, 0.8), 0, 0, 0.8 + 0.1 * i, 0.05);
+            auto rep = Line("IFCSHAPEREPRESENTATION(" + Ref(context) + ",'Body','SweptSolid',(" + body + "," + top + "))");
+            maps.push_back(Ref(Line("IFCREPRESENTATIONMAP(" + Ref(identity) + "," + Ref(rep) + ")")));
+        }
+        return maps;
+    }
+
+    void AddProperties(const std::string& element, int64_t index)
+    {
+        if (options.properties <= 0)
+            return;
+        std::string props;
+        for (int32_t p = 0; p < options.properties; ++p)
+        {
+            auto value = p % 3 == 0 ? "IFCLABEL('Value " + std::to_string((index + p) % 17) + "')"
+                : p % 3 == 1 ? "IFCREAL(" + Real((double)(index % 100) + p * 0.25) + ")"
+                : "IFCBOOLEAN(." + std::string((index + p) % 2 ? "T" : "F") + ".)";
+            auto prop = Line("IFCPROPERTYSINGLEVALUE('Property" + std::to_string(p) + "',$," + value + ",$)");
+            props += (props.empty() ? "" : ",") + Ref(prop);
+        }
+        auto pset = Line("IFCPROPERTYSET('" + Guid() + "',$,'Pset_Synthetic',$,(" + props + "))");
+        Line("IFCRELDEFINESBYPROPERTIES('" + Guid() + "',$,$,$,(" + element + ")," + Ref(pset) + ")");
+    }
+
+    uint32_t MakeStorey(int32_t s, const std::vector<std::string>& maps)
+    {
+        const double storeyHeight = 3.0;
+        auto elevation = s * storeyHeight;
+        auto placementAxes = Line("IFCAXIS2PLACEMENT3D(" + Point(0, 0, elevation) + "," + Ref(zAxis) + "," + Ref(xAxis) + ")");
+        auto placement = Line("IFCLOCALPLACEMENT(" + Ref(buildingPlacement) + "," + Ref(placementAxes) + ")");
+        auto storey = Line("IFCBUILDINGSTOREY('" + Guid() + "',$,'Storey " + std::to_string(s) + "',$,$,"
+            + Ref(placement) + ",$,$,.ELEMENT.," + Real(elevation) + ")");
+
+        std::string contained;
+        int64_t index = 0;
+        auto add = [&](const std::string& element)
+        {
+            contained += (contained.empty() ? "" : ",") + element;
+            AddProperties(element, index++);
+        };
+
+        // Elements of each kind are laid out on a row of a grid
+        const double spacing = 2.0;
+        auto walls = Count(options.walls);
+        for (int64_t i = 0; i < walls; ++i)
+        {
+            auto solid = Extrusion(Rectangle(1.8, 0.2), 0, 0, 0, storeyHeight);
+            add(Element("IFCWALL", "Wall", Placement(i * spacing, 0, 0, placement), Shape(solid, "SweptSolid")));
+        }
+
+        auto extrusions = Count(options.extrusions);
+        for (int64_t i = 0; i < extrusions; ++i)
+        {
+            auto solid = Extrusion(Polygon(std::max(options.profileSides, 3), 0.25), 0, 0, 0, storeyHeight);
+            add(Element("IFCCOLUMN", "Column", Placement(i * spacing, 4, 0, placement), Shape(solid, "SweptSolid")));
+        }
+
+        auto booleans = Count(options.booleans);
+        for (int64_t i = 0; i < booleans; ++i)
+        {
+            auto result = Extrusion(Rectangle(1.9, 1.9), 0, 0, 0, 0.3);
+            for (int32_t c = 0; c < options.booleanCuts; ++c)
+            {
+                auto offset = -0.6 + 1.2 * c / std::max(options.booleanCuts - 1, 1);
+                auto cut = Extrusion(Rectangle(0.3, 0.3), offset, offset * 0.5, -0.1, 0.5);
+                result = Ref(Line("IFCBOOLEANRESULT(.DIFFERENCE.," + result + "," + cut + ")"));
+            }
+            add(Element("IFCSLAB", "Slab", Placement(i * spacing, 8, 0, placement), Shape(result, "CSG")));
+        }
+
+        auto mapped = Count(options.mapped);
+        for (int64_t i = 0; i < mapped && !maps.empty(); ++i)
+        {
+            auto target = Line("IFCCARTESIANTRANSFORMATIONOPERATOR3D($,$," + Ref(origin) + ",1.,$)");
+            auto item = Ref(Line("IFCMAPPEDITEM(" + maps[i % maps.size()] + "," + Ref(target) + ")"));
+            add(Element("IFCBUILDINGELEMENTPROXY", "Proxy", Placement(i * spacing, 12, 0, placement), Shape(item, "MappedRepresentation")));
+        }
+
+        if (!contained.empty())
+            Line("IFCRELCONTAINEDINSPATIALSTRUCTURE('" + Guid() + "',$,$,$,(" + contained + ")," + Ref(storey) + ")");
+        return storey;
+    }
+};
@@ -29,6 +29,16 @@
 #include <memory>
 #include "../engine_web-ifc/src/cpp/modelmanager/ModelManager.h"
 #include "../engine_web-ifc/src/cpp/version.h"
+// Headers shared with the DLL. They are compiled with /clr here, where std::thread is not available,
+// so they must not start threads: parallel work is passed in by the DLL as a forEach parameter.
+#include "../WebIfcDll/VertexFormats.h"
+#include "../WebIfcDll/MappedFile.h"
+#include "../WebIfcDll/LineDecoder.h"
+#include "../WebIfcDll/RelationIndex.h"
+#include "../WebIfcDll/PropertyTable.h"
+#include "../WebIfcDll/GlobalIdTable.h"
+#include "../WebIfcDll/ElementFilter.h"
+#include "../WebIfcDll/SpatialIndex.h"
 #include <iostream>
 #include <fstream>
 
@@ -36,6 +46,7 @@
 
 #include <codecvt>
 #include <msclr\marshal_cppstd.h>
+#include <msclr\lock.h>
 
 using namespace System;
 using namespace System::Collections::Generic;
@@ -50,9 +61,12 @@ namespace  WebIfcClrWrapper
     // Forward declarations of classes
     ref class Model;
     ref class DotNetApi;
+    ref class ElementFilterSpec;
 
     // Forward declaration of functions
     Model^ CreateModel(DotNetApi^ api, ModelManager* manager, int modelId, IfcLoader* loader);
+    void SetModelSource(Model^ model, MappedFile* source);
+    void SetModelFilter(Model^ model, ElementFilterSpec^ filter);
     String^ MarshalString(const std::string& s);
 
     /// <summary>
@@ -123,6 +137,458 @@ namespace  WebIfcClrWrapper
         RefValue(uint32_t expressId) : ExpressId(expressId) {}
     };
 
+    /// <summary>
+    /// Selects the elements of a model to tessellate. Filtered elements are never tessellated.
+    /// Empty lists do not filter. Opening elements and spaces are dropped unless NoDefaultExclusions 
+    /// is set or their type is in IncludeTypes.
+    /// Containers are spatial structure elements (e.g. a building or a storey) whose contents are kept,
+    /// found through IfcRelAggregates and IfcRelContainedInSpatialStructure.
+    /// </summary>
+    public ref class ElementFilterSpec
+    {
+    public:
+        List<uint32_t>^ IncludeTypes = gcnew List<uint32_t>();
+        List<uint32_t>^ ExcludeTypes = gcnew List<uint32_t>();
+        List<uint32_t>^ Containers = gcnew List<uint32_t>();
+        List<uint32_t>^ ExpressIds = gcnew List<uint32_t>();
+        bool NoDefaultExclusions = false;
+
+        ::ElementFilter ToNative() {
+            ::ElementFilter r;
+            for each (auto id in IncludeTypes)
+                r.includeTypes.push_back(id);
+            for each (auto id in ExcludeTypes)
+                r.excludeTypes.push_back(id);
+            for each (auto id in Containers)
+                r.containers.push_back(id);
+            for each (auto id in ExpressIds)
+                r.expressIds.push_back(id);
+            r.noDefaultExclusions = NoDefaultExclusions;
+            return r;
+        }
+    };
+
+    /// <summary>
+    /// The kind of each value in a LineTable. 
+    /// </summary>
+    public enum class LineValueTag : Byte
+    {
+        Empty = LineValueEmpty,
+        Integer = LineValueInteger,
+        Real = LineValueReal,
+        Ref = LineValueRef,
+        String = LineValueString,
+        Enum = LineValueEnum,
+        Label = LineValueLabel,
+        Set = LineValueSet,
+    };
+
+    // Copies a native vector into a new managed array
+    template<typename T>
+    array<T>^ ToArray(const std::vector<T>& v) {
+        auto r = gcnew array<T>((int)v.size());
+        if (v.size() > 0) {
+            pin_ptr<T> dst = &r[0];
+            memcpy(dst, v.data(), v.size() * sizeof(T));
+        }
+        return r;
+    }
+
+    /// <summary>
+    /// The arguments of many lines decoded natively in one pass, as flat arrays (see LineDecoder.h).
+    /// Values are stored in pre-order: the values of line i are in [LineOffsets[i], LineOffsets[i + 1]).
+    /// A Set value holds the index one past its last descendant, a Real value holds an index into Reals,
+    /// and String, Enum and Label values hold an index into Strings. A Label is always followed by a Set.
+    /// Arguments can be read directly from the arrays without allocating,
+    /// or converted to LineData in the same shape as produced by Model::GetLineData.
+    /// </summary>
+    public ref class LineTable
+    {
+    private:
+
+        // Integers are boxed as the type returned by the loader, as in GetArgs
+        typedef decltype(std::declval<IfcLoader&>().GetIntArgument()) IntArgument;
+
+    public:
+
+        array<uint32_t>^ LineIds;
+        array<uint32_t>^ LineTypes;
+        array<uint32_t>^ LineOffsets;
+        array<Byte>^ Tags;
+        array<int64_t>^ Values;
+        array<double>^ Reals;
+        array<String^>^ Strings;
+
+        LineTable(const ::LineTable& table) {
+            LineIds = ToArray(table.lineIds);
+            LineTypes = ToArray(table.lineTypes);
+            LineOffsets = ToArray(table.lineOffsets);
+            Tags = ToArray(table.tags);
+            Values = ToArray(table.values);
+            Reals = ToArray(table.reals);
+            Strings = gcnew array<String^>((int)table.NumStrings());
+            for (size_t i = 0; i < table.NumStrings(); i++)
+                Strings[(int)i] = MarshalString(std::string(table.GetString(i)));
+        }
+
+        int NumLines() {
+            return LineIds->Length;
+        }
+
+        LineValueTag GetTag(int value) {
+            return (LineValueTag)Tags[value];
+        }
+
+        LineData^ GetLineData(int line) {
+            auto r = gcnew LineData();
+            r->ExpressId = LineIds[line];
+            r->TypeCode = LineTypes[line];
+            r->Arguments = GetArguments(LineOffsets[line], LineOffsets[line + 1]);
+            return r;
+        }
+
+        List<LineData^>^ GetLines() {
+            auto r = gcnew List<LineData^>(NumLines());
+            for (int i = 0; i < NumLines(); i++)
+                r->Add(GetLineData(i));
+            return r;
+        }
+
+        /// <summary>
+        /// Builds the argument list for the values in [begin, end), boxing values as DotNetApi::GetArgs does. 
+        /// </summary>
+        List<Object^>^ GetArguments(int begin, int end) {
+            auto r = gcnew List<Object^>(0);
+            for (int i = begin; i < end; )
+            {
+                auto value = Values[i];
+                switch (GetTag(i))
+                {
+                case LineValueTag::Empty:
+                    r->Add(nullptr);
+                    break;
+                case LineValueTag::Integer:
+                    r->Add((IntArgument)value);
+                    break;
+                case LineValueTag::Real:
+                    r->Add(Reals[(int)value]);
+                    break;
+                case LineValueTag::Ref:
+                    r->Add(gcnew RefValue((uint32_t)value));
+                    break;
+                case LineValueTag::String:
+                    r->Add(Strings[(int)value]);
+                    break;
+                case LineValueTag::Enum:
+                    r->Add(gcnew EnumValue(Strings[(int)value]));
+                    break;
+                case LineValueTag::Label:
+                {
+                    auto setEnd = (int)Values[i + 1];
+                    r->Add(gcnew LabelValue(Strings[(int)value], GetArguments(i + 2, setEnd)));
+                    i = setEnd;
+                    continue;
+                }
+                case LineValueTag::Set:
+                    r->Add(GetArguments(i + 1, (int)value));
+                    i = (int)value;
+                    continue;
+                }
+                i++;
+            }
+            return r;
+        }
+    };
+
+    /// <summary>
+    /// Relations of a model (IfcRelAggregates, IfcRelContainedInSpatialStructure, IfcRelDefinesByProperties, etc.)
+    /// as compressed sparse row adjacency arrays built natively in one pass (see RelationIndex.h).
+    /// Edges go from the relating object to the related objects. For an express ID, the related objects
+    /// are ForwardIds[ForwardOffsets[id] .. ForwardOffsets[id + 1]), and the relating objects are
+    /// found the same way in the reverse arrays. The relation arrays give the index in RelationIds of the 
+    /// relation that produced each edge.
+    /// </summary>
+    public ref class RelationIndex
+    {
+    private:
+
+        static ArraySegment<uint32_t> GetRange(array<uint32_t>^ offsets, array<uint32_t>^ values, uint32_t id) {
+            if ((int64_t)id + 1 >= offsets->Length)
+                return ArraySegment<uint32_t>(values, 0, 0);
+            return ArraySegment<uint32_t>(values, (int)offsets[id], (int)(offsets[id + 1] - offsets[id]));
+        }
+
+    public:
+
+        array<uint32_t>^ RelationIds;
+        array<uint32_t>^ RelationTypes;
+        array<uint32_t>^ ForwardOffsets;
+        array<uint32_t>^ ForwardIds;
+        array<uint32_t>^ ForwardRelations;
+        array<uint32_t>^ ReverseOffsets;
+        array<uint32_t>^ ReverseIds;
+        array<uint32_t>^ ReverseRelations;
+
+        RelationIndex(const ::RelationIndex& index) {
+            RelationIds = ToArray(index.relationIds);
+            RelationTypes = ToArray(index.relationTypes);
+            ForwardOffsets = ToArray(index.forward.offsets);
+            ForwardIds = ToArray(index.forward.ids);
+            ForwardRelations = ToArray(index.forward.relations);
+            ReverseOffsets = ToArray(index.reverse.offsets);
+            ReverseIds = ToArray(index.reverse.ids);
+            ReverseRelations = ToArray(index.reverse.relations);
+        }
+
+        ArraySegment<uint32_t> GetRelated(uint32_t id) {
+            return GetRange(ForwardOffsets, ForwardIds, id);
+        }
+
+        ArraySegment<uint32_t> GetRelationsFrom(uint32_t id) {
+            return GetRange(ForwardOffsets, ForwardRelations, id);
+        }
+
+        ArraySegment<uint32_t> GetRelating(uint32_t id) {
+            return GetRange(ReverseOffsets, ReverseIds, id);
+        }
+
+        ArraySegment<uint32_t> GetRelationsTo(uint32_t id) {
+            return GetRange(ReverseOffsets, ReverseRelations, id);
+        }
+    };
+
+    /// <summary>
+    /// How the value of a PropertyTable row is stored.
+    /// </summary>
+    public enum class PropertyValueKind : Byte
+    {
+        None = PropertyValueNone,
+        Integer = PropertyValueInteger,
+        Real = PropertyValueReal,
+        String = PropertyValueString,
+        Enum = PropertyValueEnum,
+        Ref = PropertyValueRef,
+    };
+
+    /// <summary>
+    /// The properties of every element, flattened natively into columns with one row per element, property and value
+    /// (see PropertyTable.h). Names and string values are indices into Strings, or NoString when absent.
+    /// Integer values, string indices, enum indices and references are in IntValues, numbers are in RealValues.
+    /// </summary>
+    public ref class PropertyTable
+    {
+    public:
+
+        static const uint32_t NoString = ::PropertyTable::NoString;
+
+        array<uint32_t>^ ElementIds;
+        array<uint32_t>^ PropertySetIds;
+        array<uint32_t>^ PropertySetNameIds;
+        array<uint32_t>^ PropertyIds;
+        array<uint32_t>^ PropertyNameIds;
+        array<uint32_t>^ ComplexNameIds;
+        array<uint32_t>^ ValueTypeIds;
+        array<int32_t>^ ValueIndices;
+        array<Byte>^ ValueKinds;
+        array<int64_t>^ IntValues;
+        array<double>^ RealValues;
+        array<String^>^ Strings;
+
+        PropertyTable(const ::PropertyTable& table) {
+            ElementIds = ToArray(table.elementIds);
+            PropertySetIds = ToArray(table.propertySetIds);
+            PropertySetNameIds = ToArray(table.propertySetNameIds);
+            PropertyIds = ToArray(table.propertyIds);
+            PropertyNameIds = ToArray(table.propertyNameIds);
+            ComplexNameIds = ToArray(table.complexNameIds);
+            ValueTypeIds = ToArray(table.valueTypeIds);
+            ValueIndices = ToArray(table.valueIndices);
+            ValueKinds = ToArray(table.valueKinds);
+            IntValues = ToArray(table.intValues);
+            RealValues = ToArray(table.realValues);
+            Strings = gcnew array<String^>((int)table.lines.NumStrings());
+            for (size_t i = 0; i < table.lines.NumStrings(); i++)
+                Strings[(int)i] = MarshalString(std::string(table.lines.GetString(i)));
+        }
+
+        int NumRows() {
+            return ElementIds->Length;
+        }
+
+        String^ GetString(uint32_t index) {
+            return index == NoString ? nullptr : Strings[(int)index];
+        }
+
+        /// <summary>
+        /// Returns the value of a row boxed as a String, EnumValue, RefValue, Int64, Double, or null.
+        /// </summary>
+        Object^ GetValue(int row) {
+            switch ((PropertyValueKind)ValueKinds[row])
+            {
+            case PropertyValueKind::Integer: return IntValues[row];
+            case PropertyValueKind::Real: return RealValues[row];
+            case PropertyValueKind::String: return Strings[(int)IntValues[row]];
+            case PropertyValueKind::Enum: return gcnew EnumValue(Strings[(int)IntValues[row]]);
+            case PropertyValueKind::Ref: return gcnew RefValue((uint32_t)IntValues[row]);
+            default: return nullptr;
+            }
+        }
+    };
+
+    /// <summary>
+    /// The GlobalId of every IfcRoot entity, decoded natively (see GlobalIdTable.h), with lookups in both directions.
+    /// ExpressIds is ascending, and Guids holds the GlobalId of each. When a GlobalId is used more than once,
+    /// GetExpressId returns the lowest express ID.
+    /// </summary>
+    public ref class GlobalIdIndex
+    {
+    private:
+
+        Dictionary<Guid, uint32_t>^ expressIdOfGuid;
+
+    public:
+
+        array<uint32_t>^ ExpressIds;
+        array<Guid>^ Guids;
+
+        GlobalIdIndex(const ::GlobalIdTable& table) {
+            ExpressIds = ToArray(table.expressIds);
+            Guids = gcnew array<Guid>((int)table.Size());
+            expressIdOfGuid = gcnew Dictionary<Guid, uint32_t>((int)table.Size());
+            for (size_t i = 0; i < table.Size(); i++) {
+                Guids[(int)i] = ToGuid(table.guids[i]);
+                expressIdOfGuid->TryAdd(Guids[(int)i], table.expressIds[i]);
+            }
+        }
+
+        static Guid ToGuid(const IfcGuid& g) {
+            auto b = g.bytes;
+            return Guid((int)((uint32_t)b[0] << 24 | (uint32_t)b[1] << 16 | (uint32_t)b[2] << 8 | b[3]),
+                (short)(b[4] << 8 | b[5]), (short)(b[6] << 8 | b[7]),
+                b[8], b[9], b[10], b[11], b[12], b[13], b[14], b[15]);
+        }
+
+        /// <summary>
+        /// Decodes a 22 character IFC GlobalId, or returns Guid.Empty if it is not valid.
+        /// </summary>
+        static Guid Decode(String^ globalId) {
+            IfcGuid g;
+            return IfcGuid::Decode(marshal_as<std::string>(globalId), g) ? ToGuid(g) : Guid::Empty;
+        }
+
+        /// <summary>
+        /// Returns the GlobalId of an express ID, or Guid.Empty if it has none.
+        /// </summary>
+        Guid GetGuid(uint32_t expressId) {
+            auto i = Array::BinarySearch(ExpressIds, expressId);
+            return i >= 0 ? Guids[i] : Guid::Empty;
+        }
+
+        /// <summary>
+        /// Returns the express ID with a GlobalId, or 0 if there is none.
+        /// </summary>
+        uint32_t GetExpressId(Guid guid) {
+            uint32_t r;
+            return expressIdOfGuid->TryGetValue(guid, r) ? r : 0;
+        }
+    };
+
+    /// <summary>
+    /// A bounding volume hierarchy over the world-space bounds of elements, built natively (see SpatialIndex.h).
+    /// Boxes are 6 values: min xyz, max xyz. Queries return express IDs.
+    /// </summary>
+    public ref class SpatialIndex
+    {
+    private:
+        ::SpatialIndex* index;
+
+        static List<uint32_t>^ ToList(const std::vector<std::pair<double, uint32_t>>& hits, List<double>^ distances) {
+            auto r = gcnew List<uint32_t>((int)hits.size());
+            for (auto& h : hits) {
+                r->Add(h.second);
+                if (distances != nullptr)
+                    distances->Add(h.first);
+            }
+            return r;
+        }
+
+    public:
+
+        SpatialIndex(const std::vector<uint32_t>& ids, const std::vector<Aabb>& boxes) {
+            index = new ::SpatialIndex();
+            index->Build(ids, boxes);
+        }
+
+        ~SpatialIndex() {
+            this->!SpatialIndex();
+        }
+
+        !SpatialIndex() {
+            delete index;
+            index = nullptr;
+        }
+
+        int Count() {
+            return (int)index->Size();
+        }
+
+        /// <summary>
+        /// Returns the elements whose bounds intersect the box.
+        /// </summary>
+        List<uint32_t>^ QueryBox(array<double>^ box) {
+            if (box == nullptr || box->Length != 6)
+                throw gcnew ArgumentException("Expected a box with 6 values");
+            pin_ptr<double> p = &box[0];
+            auto r = gcnew List<uint32_t>();
+            std::vector<uint32_t> ids;
+            index->QueryBox(Aabb::FromArray(p), [&](uint32_t id) { ids.push_back(id); });
+            for (auto id : ids)
+                r->Add(id);
+            return r;
+        }
+
+        /// <summary>
+        /// Returns the elements whose bounds are not entirely outside one of the planes,
+        /// given as 4 values (a, b, c, d) each, with the inside where ax + by + cz + d >= 0.
+        /// </summary>
+        List<uint32_t>^ QueryFrustum(array<double>^ planes) {
+            if (planes == nullptr || planes->Length % 4 != 0)
+                throw gcnew ArgumentException("Expected 4 values per plane");
+            auto r = gcnew List<uint32_t>();
+            if (planes->Length == 0)
+                return r;
+            pin_ptr<double> p = &planes[0];
+            std::vector<uint32_t> ids;
+            index->QueryFrustum(p, planes->Length / 4, [&](uint32_t id) { ids.push_back(id); });
+            for (auto id : ids)
+                r->Add(id);
+            return r;
+        }
+
+        /// <summary>
+        /// Returns the elements whose bounds are hit by the ray within maxDistance, sorted by the distance 
+        /// at which the ray enters them. If not null, distances receives those distances.
+        /// </summary>
+        List<uint32_t>^ QueryRay(array<double>^ origin, array<double>^ direction, double maxDistance, List<double>^ distances) {
+            if (origin == nullptr || origin->Length != 3 || direction == nullptr || direction->Length != 3)
+                throw gcnew ArgumentException("Expected an origin and a direction with 3 values");
+            pin_ptr<double> o = &origin[0];
+            pin_ptr<double> d = &direction[0];
+            return ToList(index->QueryRay(o, d, maxDistance), distances);
+        }
+
+        /// <summary>
+        /// Returns the count elements whose bounds are closest to the point, from the closest.
+        /// If not null, distances receives the distance from the point to each of their bounds.
+        /// </summary>
+        List<uint32_t>^ QueryNearest(array<double>^ point, int count, List<double>^ distances) {
+            if (point == nullptr || point->Length != 3)
+                throw gcnew ArgumentException("Expected a point with 3 values");
+            pin_ptr<double> p = &point[0];
+            return ToList(index->QueryNearest(p, (size_t)Math::Max(count, 0)), distances);
+        }
+    };
+
     /// <summary>
     /// This is the layout of vertex data, as it is stored in the web-ifc engine.
     /// </summary>
@@ -134,18 +600,28 @@ namespace  WebIfcClrWrapper
 
     /// <summary>
     /// This is a .NET wrapper around the Web-IFC engine. 
+    /// Different models may be loaded and used from several threads at once, as long as each model 
+    /// is used by one thread at a time. The engine's model manager is not thread-safe, so every call to it
+    /// is made while holding ManagerLock. Parsing and tessellation run without the lock.
+    /// The schema tables are immutable, and shared by every instance.
     /// </summary>
     public ref class DotNetApi
     {
     public:
         const bool MT_ENABLED = false;
 
+        // Guards the model manager and the list of mapped sources
+        Object^ ManagerLock = gcnew Object();
+
         static IfcSchemaManager* schemaManager = new IfcSchemaManager();
 
         void DisposeAll()
         {
             delete settings;
             delete manager;
+            for (auto file : *sources)
+                delete file;
+            delete sources;
         }
 
         void DisposeStatic()
@@ -160,16 +636,78 @@ namespace  WebIfcClrWrapper
         webifc::manager::ModelManager* manager
             = new webifc::manager::ModelManager(MT_ENABLED);
 
+        // Mapped files that loaders read from. The loaders may request chunks again after loading,
+        // so these are kept until the manager is disposed.
+        std::vector<MappedFile*>* sources
+            = new std::vector<MappedFile*>();
+
+        /// <summary>
+        /// Loads a model by memory mapping the file. The file is read in binary mode,
+        /// and the path is passed to the OS as UTF-16 so it may contain any characters.
+        /// </summary>
         Model^ Load(String^ fileName) {
-            manager->SetLogLevel(6);
-            auto modelId = manager->CreateModel(*settings);
-            auto loader = manager->GetIfcLoader(modelId);
-            std::ifstream ifs;
-            // NOTE: may fail if the file has unicode characters. This needs to be tested  
-            std::string unmanaged = marshal_as<std::string>(fileName);
-            ifs.open(unmanaged, std::ifstream::in);
-            loader->LoadFile(ifs);
-            return CreateModel(this, manager, modelId, loader);
+            return Load(fileName, nullptr);
+        }
+
+        /// <summary>
+        /// Loads a model from a file, keeping only the elements selected by the filter.
+        /// </summary>
+        Model^ Load(String^ fileName, ElementFilterSpec^ filter) {
+            auto file = new MappedFile();
+            std::wstring path = marshal_as<std::wstring>(fileName);
+            if (!file->Open(path.c_str())) {
+                delete file;
+                throw gcnew System::IO::FileNotFoundException("Could not open the IFC file", fileName);
+            }
+            {
+                msclr::lock l(ManagerLock);
+                sources->push_back(file);
+            }
+            auto model = Load(IntPtr((void*)file->Data()), (Int64)file->Size(), filter);
+            SetModelSource(model, file);
+            return model;
+        }
+
+        /// <summary>
+        /// Unmaps a file once the model reading from it has been unloaded.
+        /// </summary>
+        void ReleaseSource(MappedFile* file) {
+            msclr::lock l(ManagerLock);
+            auto it = std::find(sources->begin(), sources->end(), file);
+            if (it == sources->end())
+                return;
+            sources->erase(it);
+            delete file;
+        }
+
+        /// <summary>
+        /// Loads a model from IFC data already in memory, without copying it first.
+        /// The memory must remain valid and unmoved for as long as the model is used.
+        /// </summary>
+        Model^ Load(IntPtr data, Int64 size) {
+            return Load(data, size, nullptr);
+        }
+
+        /// <summary>
+        /// Loads a model from IFC data already in memory, keeping only the elements selected by the filter.
+        /// </summary>
+        Model^ Load(IntPtr data, Int64 size, ElementFilterSpec^ filter) {
+            int modelId;
+            IfcLoader* loader;
+            {
+                msclr::lock l(ManagerLock);
+                manager->SetLogLevel(6);
+                modelId = manager->CreateModel(*settings);
+                loader = manager->GetIfcLoader(modelId);
+            }
+            LoadFromMemory(loader, static_cast<const char*>(data.ToPointer()), (size_t)size);
+            Model^ model;
+            {
+                msclr::lock l(ManagerLock);
+                model = CreateModel(this, manager, modelId, loader);
+            }
+            SetModelFilter(model, filter);
+            return model;
         }
 
         static String^ GetNameFromTypeCode(uint32_t type) {
@@ -314,6 +852,38 @@ namespace  WebIfcClrWrapper
         Buffer^ GetIndexData() {
             return ToBuffer(geometry->indexData);
         }
+
+        /// <summary>
+        /// Returns a copy of the vertex data converted to one of the formats in VertexFormats.h.
+        /// The transform (16 values, column-major) may be null for local space.
+        /// The origin is subtracted from positions after transformation. 
+        /// If not null, bounds receives the min xyz and max xyz of the encoded positions,
+        /// which are required to decode quantized positions.
+        /// </summary>
+        array<Byte>^ GetEncodedVertexData(int format, array<double>^ transform, double originX, double originY, double originZ, array<double>^ bounds) {
+            if (transform != nullptr && transform->Length != 16)
+                throw gcnew ArgumentException("Expected a transform with 16 values");
+            if (bounds != nullptr && bounds->Length != 6)
+                throw gcnew ArgumentException("Expected bounds with 6 values");
+
+            double m[16];
+            if (transform != nullptr)
+                for (int i = 0; i < 16; i++)
+                    m[i] = transform[i];
+
+            auto numVertices = geometry->vertexData.size() / 6;
+            auto r = gcnew array<Byte>((int)(numVertices * VertexStride(format)));
+            double box[6] = {};
+            if (numVertices > 0) {
+                VertexEncoder encoder(transform != nullptr ? m : nullptr, originX, originY, originZ);
+                pin_ptr<Byte> dst = &r[0];
+                encoder.Encode(geometry->vertexData.data(), numVertices, format, dst, box);
+            }
+            if (bounds != nullptr)
+                for (int i = 0; i < 6; i++)
+                    bounds[i] = box[i];
+            return r;
+        }
     };
 
     /// <summary>
@@ -337,6 +907,17 @@ namespace  WebIfcClrWrapper
         Mesh^ Mesh;
         Color^ Color;
         array<double>^ Transform;
+
+        // World-space min xyz and max xyz of the transformed vertices, or null if there are none
+        array<double>^ Bounds;
+
+        /// <summary>
+        /// Returns the vertex data in a compact format, optionally baked into world space.
+        /// See Mesh::GetEncodedVertexData.
+        /// </summary>
+        array<Byte>^ GetEncodedVertexData(int format, bool worldSpace, double originX, double originY, double originZ, array<double>^ bounds) {
+            return Mesh->GetEncodedVertexData(format, worldSpace ? Transform : nullptr, originX, originY, originZ, bounds);
+        }
     };
 
     /// <summary>
@@ -361,6 +942,9 @@ namespace  WebIfcClrWrapper
         }
 
         List<TransformedMesh^>^ Meshes;
+
+        // World-space min xyz and max xyz of all the meshes, or null if there are none
+        array<double>^ Bounds;
     };
 
     /// <summary>
@@ -383,7 +967,14 @@ namespace  WebIfcClrWrapper
 
         int Id;
 
+        // The mapped file the model was loaded from, if any
+        MappedFile* Source = nullptr;
+
+        // Selects the elements returned by GetElementIds, or null for the default selection
+        ElementFilterSpec^ Filter = nullptr;
+
         Model(DotNetApi^ api, ModelManager* mm, int Id, IfcLoader* loader) {
+            this->Api = api;
             this->manager = mm;
             this->Id = Id;
             this->geometryProcessor = manager->GetGeometryProcessor(Id);
@@ -394,6 +985,26 @@ namespace  WebIfcClrWrapper
             return loader->GetTotalSize();
         }
 
+        /// <summary>
+        /// Closes the engine model, which releases its token stream, line index and geometry cache,
+        /// and unmaps the file it was loaded from. The model, its geometries and its meshes 
+        /// must not be used afterwards.
+        /// </summary>
+        void Unload() {
+            if (loader == nullptr)
+                return;
+            {
+                msclr::lock l(Api->ManagerLock);
+                manager->CloseModel(Id);
+            }
+            loader = nullptr;
+            geometryProcessor = nullptr;
+            geometries = nullptr;
+            if (Source != nullptr)
+                Api->ReleaseSource(Source);
+            Source = nullptr;
+        }
+
         List<Geometry^>^ GetGeometries() {
             if (geometries == nullptr) {
                 geometries = LoadGeometries();
@@ -403,33 +1014,67 @@ namespace  WebIfcClrWrapper
 
         List<Geometry^>^ LoadGeometries() {   
             auto r = gcnew List<Geometry^>(2);
+            for each (auto e in GetElementIds())
+                r->Add(LoadGeometry(e));
+            return r;
+        }
 
-            for (auto type : DotNetApi::schemaManager->GetIfcElementList())
+        /// <summary>
+        /// Tessellates the elements one at a time, passing each geometry to the consumer as soon as it is ready
+        /// instead of building the full list first. The consumer returns false to stop. 
+        /// Returns the number of geometries delivered.
+        /// </summary>
+        int StreamGeometries(Func<Geometry^, bool>^ consumer) {
+            int n = 0;
+            for each (auto e in GetElementIds())
             {
-                // TODO: maybe some of these elments are desired. In fact, I think there may be explicit requests for IFCSPACE?
-                if (type == IFCOPENINGELEMENT 
-                    || type == IFCSPACE 
-                    || type == IFCOPENINGSTANDARDCASE)
-                {
-                    continue;
-                }
-                
-                for (auto e : loader->GetExpressIDsWithType(type))
-                {
-                    auto flatMesh = geometryProcessor->GetFlatMesh(e);
-                    auto meshList = gcnew Geometry(&flatMesh, e);
-                    for (auto& placedGeom : flatMesh.geometries)
-                    {
-                        auto mesh = Convert(placedGeom);
-                        meshList->Meshes->Add(mesh);
-                    }                  
-                    r->Add(meshList);
-                }
+                n++;
+                if (!consumer(LoadGeometry(e)))
+                    break;
             }
+            return n;
+        }
 
+        /// <summary>
+        /// Returns the express IDs of the elements selected by the filter, in the order they are tessellated.
+        /// </summary>
+        List<uint32_t>^ GetElementIds() {
+            auto filter = Filter != nullptr ? Filter->ToNative() : ::ElementFilter();
+            ::RelationIndex relations;
+            if (filter.NeedsRelations())
+                relations.Build(loader, SpatialRelationKinds());
+            std::vector<uint32_t> ids;
+            filter.ForEachElement(loader, DotNetApi::schemaManager->GetIfcElementList(), &relations,
+                [&](uint32_t e, uint32_t) { ids.push_back(e); });
+            auto r = gcnew List<uint32_t>((int)ids.size());
+            for (auto e : ids)
+                r->Add(e);
             return r;
         }
 
+        Geometry^ LoadGeometry(uint32_t e) {
+            auto flatMesh = geometryProcessor->GetFlatMesh(e);
+            auto meshList = gcnew Geometry(&flatMesh, e);
+            for (auto& placedGeom : flatMesh.geometries)
+            {
+                auto mesh = Convert(placedGeom);
+                meshList->Meshes->Add(mesh);
+            }                  
+            Aabb bounds;
+            for each (auto mesh in meshList->Meshes) {
+                if (mesh->Bounds == nullptr)
+                    continue;
+                pin_ptr<double> p = &mesh->Bounds[0];
+                bounds.Add(Aabb::FromArray(p));
+            }
+            if (!bounds.IsEmpty()) {
+                meshList->Bounds = gcnew array<double>(6);
+                pin_ptr<double> p = &meshList->Bounds[0];
+                bounds.ToArray(p);
+            }
+            return meshList;
+        }
+
         TransformedMesh^ Convert(IfcPlacedGeometry& pg) {
             auto r = gcnew TransformedMesh();
             r->Mesh = GetMesh(pg.geometryExpressID);
@@ -439,6 +1084,12 @@ namespace  WebIfcClrWrapper
             for (int i = 0; i < 16; i++) {
                 r->Transform[i] = pg.flatTransformation[i];
             }
+            auto& vd = geometryProcessor->GetGeometry(pg.geometryExpressID).vertexData;
+            if (!vd.empty()) {
+                r->Bounds = gcnew array<double>(6);
+                pin_ptr<double> p = &r->Bounds[0];
+                VertexEncoder(pg.flatTransformation.data(), 0, 0, 0).ComputeBounds(vd.data(), vd.size() / 6, p);
+            }
             return r;
         }
 
@@ -471,6 +1122,73 @@ namespace  WebIfcClrWrapper
             lineData->Arguments = DotNetApi::GetArgs(loader);
             return lineData;
         }
+
+        /// <summary>
+        /// Decodes all lines of the given type natively, in one call.
+        /// </summary>
+        LineTable^ GetLineTable(uint32_t type) {
+            ::LineTable table;
+            table.Decode(loader, loader->GetExpressIDsWithType(type));
+            return gcnew LineTable(table);
+        }
+
+        /// <summary>
+        /// Decodes the given lines natively, in one call.
+        /// </summary>
+        LineTable^ GetLineTable(IEnumerable<uint32_t>^ expressIds) {
+            std::vector<uint32_t> ids;
+            for each (auto id in expressIds)
+                ids.push_back(id);
+            ::LineTable table;
+            table.Decode(loader, ids);
+            return gcnew LineTable(table);
+        }
+
+        /// <summary>
+        /// Builds the relation index of the model natively. 
+        /// </summary>
+        RelationIndex^ GetRelationIndex() {
+            ::RelationIndex index;
+            index.Build(loader, DefaultRelationKinds());
+            return gcnew RelationIndex(index);
+        }
+
+        /// <summary>
+        /// Builds a spatial index natively over the bounds of the elements returned by GetGeometries,
+        /// which tessellates them if that was not done yet.
+        /// </summary>
+        SpatialIndex^ GetSpatialIndex() {
+            std::vector<uint32_t> ids;
+            std::vector<Aabb> boxes;
+            for each (auto g in GetGeometries()) {
+                if (g->Bounds == nullptr)
+                    continue;
+                pin_ptr<double> p = &g->Bounds[0];
+                ids.push_back(g->ExpressId);
+                boxes.push_back(Aabb::FromArray(p));
+            }
+            return gcnew SpatialIndex(ids, boxes);
+        }
+
+        /// <summary>
+        /// Flattens the property sets of all elements natively, in one call.
+        /// </summary>
+        PropertyTable^ GetPropertyTable() {
+            ::RelationIndex relations;
+            relations.Build(loader, DefaultRelationKinds());
+            ::PropertyTable table;
+            table.Build(loader, relations, SerialForEach());
+            return gcnew PropertyTable(table);
+        }
+
+        /// <summary>
+        /// Decodes the GlobalIds of all IfcRoot entities natively, in one call.
+        /// </summary>
+        GlobalIdIndex^ GetGlobalIdIndex() {
+            ::GlobalIdTable table;
+            table.Build(loader);
+            return gcnew GlobalIdIndex(table);
+        }
     };      
 
     // Static function implementations 
@@ -479,6 +1197,16 @@ namespace  WebIfcClrWrapper
         return gcnew Model(api, manager, modelId, loader);
     }
 
+    void SetModelSource(Model^ model, MappedFile* source)
+    {
+        model->Source = source;
+    }
+
+    void SetModelFilter(Model^ model, ElementFilterSpec^ filter)
+    {
+        model->Filter = filter;
+    }
+
     String^ MarshalString(const std::string& s)
     {
         // Convert UTF - 8 std::string to std::wstring
@@ -12,6 +12,9 @@
 
 #include <string>
 #include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <functional>
 #include <vector>
 #include <stack>
 #include <cstdint>
@@ -20,6 +23,32 @@
 #include "../engine_web-ifc/src/cpp/version.h"
 #include <iostream>
 #include <fstream>
+#include <unordered_set>
+#include <map>
+#include "ThreadPool.h"
+#include "BoundedQueue.h"
+#include "Arena.h"
+#include "LruCache.h"
+#include "VertexFormats.h"
+#include "Hashing.h"
+#include "MappedFile.h"
+#include "LineDecoder.h"
+#include "RelationIndex.h"
+#include "PropertyTable.h"
+#include "GlobalIdTable.h"
+#include "ElementFingerprints.h"
+#include "Instrumentation.h"
+#include "SkipReport.h"
+#include "ElementFilter.h"
+#include "JobQueue.h"
+#include "MeshSimplifier.h"
+#include "MeshOptimizer.h"
+#include "SpatialIndex.h"
+#include "GlbWriter.h"
+#include "SpeckleWriter.h"
+#include <filesystem>
+#include <atomic>
+#include <thread>
 
 using namespace webifc::manager;
 using namespace webifc::parsing;
@@ -32,24 +61,417 @@ class Api;
 class Mesh;
 class Geometry;
 class Vertex;
+struct ApiOptions;
+struct LoadOptions;
+struct LoadJob;
+struct ElementFilterSpec;
+struct MeshCounts;
+struct MeshBuffers;
+struct InstanceCounts;
+struct InstanceBuffers;
+struct BatchCounts;
+struct BatchBuffers;
+struct LineTableCounts;
+struct LineTableArrays;
+struct RelationIndexCounts;
+struct RelationIndexArrays;
+struct PropertyTableCounts;
+struct PropertyTableArrays;
+struct GlobalIdTableCounts;
+struct GlobalIdTableArrays;
+struct ChangeSetCounts;
+struct ChangeSetArrays;
+struct StreamOptions;
+struct LodOptions;
+struct OptimizeOptions;
+struct OptimizeStats;
+struct GlbOptions;
+struct SpeckleOptions;
+struct GeometryStream;
+struct ModelMemoryStats;
+struct ModelStats;
+
+// Exported functions. On platforms other than Windows they are given default visibility,
+// so that the same source builds as a shared library or straight into a native executable (e.g. WebIfcBench).
+#ifdef _WIN32
+#define WEBIFC_API __declspec(dllexport)
+#else
+#define WEBIFC_API __attribute__((visibility("default")))
+#endif
 
 // Exposed C functions 
 extern "C"
 {
-    __declspec(dllexport) Api* InitializeApi();
-    __declspec(dllexport) void FinalizeApi(Api* api);
-    __declspec(dllexport) Model* LoadModel(Api* api, const char* fileName);
-    __declspec(dllexport) ::Geometry* GetGeometry(Api* api, Model* model, uint32_t id);
-    __declspec(dllexport) int GetNumMeshes(Api* api, ::Geometry* geom);
-    __declspec(dllexport) Mesh* GetMesh(Api* api, ::Geometry* geom, int index);
-    __declspec(dllexport) double* GetTransform(Api* api, Mesh* mesh);
-    __declspec(dllexport) double* GetColor(Api* api, Mesh* mesh);
-    __declspec(dllexport) int GetNumVertices(Api* api, Mesh* mesh);
-    __declspec(dllexport) Vertex* GetVertices(Api* api, Mesh* mesh);
-    __declspec(dllexport) int GetNumIndices(Api* api, Mesh* mesh);
-    __declspec(dllexport) uint32_t* GetIndices(Api* api, Mesh* mesh);
+    WEBIFC_API Api* InitializeApi();
+    WEBIFC_API Api* InitializeApiWithOptions(const ApiOptions* options);
+    WEBIFC_API void FinalizeApi(Api* api);
+    WEBIFC_API Model* LoadModel(Api* api, const char* fileName);
+    WEBIFC_API Model* LoadModelWithOptions(Api* api, const char* fileName, const LoadOptions* options);
+    WEBIFC_API Model* LoadModelFromBuffer(Api* api, const char* data, size_t size);
+    WEBIFC_API Model* LoadModelFromBufferWithOptions(Api* api, const char* data, size_t size, const LoadOptions* options);
+    WEBIFC_API LoadJob* BeginLoadModel(Api* api, const char* fileName, const LoadOptions* options);
+    WEBIFC_API LoadJob* BeginLoadModelFromBuffer(Api* api, const char* data, size_t size, const LoadOptions* options);
+    WEBIFC_API int32_t IsLoadJobDone(Api* api, LoadJob* job);
+    WEBIFC_API Model* EndLoadModel(Api* api, LoadJob* job);
+    WEBIFC_API Model* ReloadModel(Api* api, Model* previous, const char* fileName, const LoadOptions* options);
+    WEBIFC_API Model* ReloadModelFromBuffer(Api* api, Model* previous, const char* data, size_t size, const LoadOptions* options);
+    WEBIFC_API void GetChangeSetCounts(Api* api, Model* model, ChangeSetCounts* counts);
+    WEBIFC_API void GetChangeSetArrays(Api* api, Model* model, ChangeSetArrays* arrays);
+    WEBIFC_API void UnloadModel(Api* api, Model* model);
+    WEBIFC_API void GetModelMemoryStats(Api* api, Model* model, ModelMemoryStats* stats);
+    WEBIFC_API void GetStats(Api* api, Model* model, ModelStats* stats);
+    WEBIFC_API int32_t WriteTrace(Api* api, Model* model, const char* fileName);
+    WEBIFC_API int64_t GetNumSkippedElements(Api* api, Model* model);
+    WEBIFC_API int64_t GetSkippedElements(Api* api, Model* model, SkippedElement* elements, int64_t capacity);
+    WEBIFC_API ::Geometry* GetGeometry(Api* api, Model* model, uint32_t id);
+    WEBIFC_API uint32_t GetGeometryId(Api* api, ::Geometry* geom);
+    WEBIFC_API int GetNumMeshes(Api* api, ::Geometry* geom);
+    WEBIFC_API Mesh* GetMesh(Api* api, ::Geometry* geom, int index);
+    WEBIFC_API double* GetTransform(Api* api, Mesh* mesh);
+    WEBIFC_API double* GetColor(Api* api, Mesh* mesh);
+    WEBIFC_API int GetNumVertices(Api* api, Mesh* mesh);
+    WEBIFC_API Vertex* GetVertices(Api* api, Mesh* mesh);
+    WEBIFC_API int GetNumIndices(Api* api, Mesh* mesh);
+    WEBIFC_API uint32_t* GetIndices(Api* api, Mesh* mesh);
+    WEBIFC_API void GetMeshBounds(Api* api, Mesh* mesh, double* bounds);
+    WEBIFC_API int32_t GetElementBounds(Api* api, Model* model, uint32_t id, double* bounds);
+    WEBIFC_API int64_t BuildSpatialIndex(Api* api, Model* model);
+    WEBIFC_API int64_t QueryBox(Api* api, Model* model, const double* box, uint32_t* ids, int64_t capacity);
+    WEBIFC_API int64_t QueryFrustum(Api* api, Model* model, const double* planes, int32_t numPlanes, uint32_t* ids, int64_t capacity);
+    WEBIFC_API int64_t QueryRay(Api* api, Model* model, const double* origin, const double* direction, double maxDistance, uint32_t* ids, double* distances, int64_t capacity);
+    WEBIFC_API int64_t QueryNearest(Api* api, Model* model, const double* point, uint32_t* ids, double* distances, int64_t count);
+    WEBIFC_API int32_t BuildLods(Api* api, Model* model, const LodOptions* options);
+    WEBIFC_API int GetNumLods(Api* api, Mesh* mesh);
+    WEBIFC_API int GetLodNumVertices(Api* api, Mesh* mesh, int level);
+    WEBIFC_API Vertex* GetLodVertices(Api* api, Mesh* mesh, int level);
+    WEBIFC_API int GetLodNumIndices(Api* api, Mesh* mesh, int level);
+    WEBIFC_API uint32_t* GetLodIndices(Api* api, Mesh* mesh, int level);
+    WEBIFC_API int64_t OptimizeGeometries(Api* api, Model* model, const OptimizeOptions* options, OptimizeStats* stats);
+    WEBIFC_API void GetMeshCounts(Api* api, Model* model, MeshCounts* counts);
+    WEBIFC_API int64_t ExportMeshes(Api* api, Model* model, MeshBuffers* buffers);
+    WEBIFC_API int32_t GetVertexStride(int32_t format);
+    WEBIFC_API void EncodeVertices(Api* api, Mesh* mesh, const VertexEncoding* encoding, void* vertices, double* bounds);
+    WEBIFC_API int64_t ExportEncodedMeshes(Api* api, Model* model, const VertexEncoding* encoding, MeshBuffers* buffers);
+    WEBIFC_API void GetInstanceCounts(Api* api, Model* model, int32_t dedupByContent, InstanceCounts* counts);
+    WEBIFC_API int64_t ExportInstances(Api* api, Model* model, int32_t dedupByContent, const VertexEncoding* encoding, InstanceBuffers* buffers);
+    WEBIFC_API void GetBatchCounts(Api* api, Model* model, int32_t maxVerticesPerBatch, BatchCounts* counts);
+    WEBIFC_API int64_t ExportBatches(Api* api, Model* model, int32_t maxVerticesPerBatch, const VertexEncoding* encoding, BatchBuffers* buffers);
+    WEBIFC_API int64_t ExportGlb(Api* api, Model* model, const char* fileName, const GlbOptions* options);
+    WEBIFC_API int64_t ExportGlbToSink(Api* api, Model* model, const GlbOptions* options, int32_t (*write)(void* userData, const void* data, int64_t size), void* userData);
+    // rootId may be null, otherwise it receives the 32 hex digits of the root object ID and a terminating zero,
+    // so rootIdCapacity must be at least SpeckleRootIdCapacity (33) bytes, or -1 is returned without exporting.
+    WEBIFC_API int64_t ExportSpeckle(Api* api, Model* model, const char* fileName, const SpeckleOptions* options, char* rootId, int64_t rootIdCapacity);
+    WEBIFC_API int64_t ExportSpeckleToSink(Api* api, Model* model, const SpeckleOptions* options, int32_t (*write)(void* userData, const void* data, int64_t size), void* userData, char* rootId, int64_t rootIdCapacity);
+    WEBIFC_API uint32_t GetTypeCode(Api* api, const char* typeName);
+    WEBIFC_API LineTable* DecodeLines(Api* api, Model* model, const uint32_t* expressIds, int64_t count);
+    WEBIFC_API LineTable* DecodeLinesOfType(Api* api, Model* model, uint32_t type);
+    WEBIFC_API void GetLineTableCounts(Api* api, LineTable* table, LineTableCounts* counts);
+    WEBIFC_API void GetLineTableArrays(Api* api, LineTable* table, LineTableArrays* arrays);
+    WEBIFC_API void FreeLineTable(Api* api, LineTable* table);
+    WEBIFC_API void GetRelationIndexCounts(Api* api, Model* model, RelationIndexCounts* counts);
+    WEBIFC_API void GetRelationIndexArrays(Api* api, Model* model, RelationIndexArrays* arrays);
+    WEBIFC_API void GetPropertyTableCounts(Api* api, Model* model, PropertyTableCounts* counts);
+    WEBIFC_API void GetPropertyTableArrays(Api* api, Model* model, PropertyTableArrays* arrays);
+    WEBIFC_API void GetGlobalIdTableCounts(Api* api, Model* model, GlobalIdTableCounts* counts);
+    WEBIFC_API void GetGlobalIdTableArrays(Api* api, Model* model, GlobalIdTableArrays* arrays);
+    WEBIFC_API int64_t GetGlobalIds(Api* api, Model* model, const uint32_t* expressIds, int64_t count, uint8_t* guids);
+    WEBIFC_API int64_t GetExpressIdsOfGlobalIds(Api* api, Model* model, const uint8_t* guids, int64_t count, uint32_t* expressIds);
+    WEBIFC_API int32_t DecodeGlobalId(const char* globalId, uint8_t* guid);
+    WEBIFC_API void EncodeGlobalId(const uint8_t* guid, char* globalId);
+    WEBIFC_API GeometryStream* BeginGeometryStream(Api* api, Model* model, const StreamOptions* options);
+    WEBIFC_API ::Geometry* NextStreamedGeometry(Api* api, GeometryStream* stream);
+    WEBIFC_API int32_t EndGeometryStream(Api* api, GeometryStream* stream);
+    WEBIFC_API int64_t StreamGeometry(Api* api, Model* model, const StreamOptions* options, int32_t (*callback)(void* userData, ::Geometry* geometry), void* userData);
 }
 
+// Options controlling an Api instance
+struct ApiOptions
+{
+    // Number of threads running the jobs started with BeginLoadModel. 
+    // 0 or less uses one thread per hardware core. The threads are only started by the first job.
+    int32_t numWorkers;
+
+    ApiOptions() : numWorkers(0) {}
+};
+
+// Selects the elements to tessellate (see ElementFilter.h). Every array may be null when its count is zero.
+struct ElementFilterSpec
+{
+    const uint32_t* includeTypes;       // element types to keep, or none to keep every type
+    int64_t numIncludeTypes;
+    const uint32_t* excludeTypes;       // element types to drop
+    int64_t numExcludeTypes;
+    const uint32_t* containers;         // express IDs of spatial structure elements whose contents are kept
+    int64_t numContainers;
+    const uint32_t* expressIds;         // express IDs of the elements to keep, or none to keep every element
+    int64_t numExpressIds;
+
+    // When non-zero, opening elements and spaces are not dropped by default
+    int32_t noDefaultExclusions;
+    int32_t reserved;
+
+    ElementFilter ToFilter() const
+    {
+        auto list = [](const uint32_t* p, int64_t n) { return p && n > 0 ? std::vector<uint32_t>(p, p + n) : std::vector<uint32_t>(); };
+        ElementFilter r;
+        r.includeTypes = list(includeTypes, numIncludeTypes);
+        r.excludeTypes = list(excludeTypes, numExcludeTypes);
+        r.containers = list(containers, numContainers);
+        r.expressIds = list(expressIds, numExpressIds);
+        r.noDefaultExclusions = noDefaultExclusions != 0;
+        return r;
+    }
+
+    // A spec pointing into the lists of a filter, which must outlive it
+    static ElementFilterSpec FromFilter(const ElementFilter& f)
+    {
+        ElementFilterSpec r = {};
+        r.includeTypes = f.includeTypes.data();
+        r.numIncludeTypes = (int64_t)f.includeTypes.size();
+        r.excludeTypes = f.excludeTypes.data();
+        r.numExcludeTypes = (int64_t)f.excludeTypes.size();
+        r.containers = f.containers.data();
+        r.numContainers = (int64_t)f.containers.size();
+        r.expressIds = f.expressIds.data();
+        r.numExpressIds = (int64_t)f.expressIds.size();
+        r.noDefaultExclusions = f.noDefaultExclusions ? 1 : 0;
+        return r;
+    }
+};
+
+// Options controlling how a model is loaded
+struct LoadOptions
+{
+    // Number of threads used for geometry extraction. 
+    // 1 uses the serial path, 0 or less uses one thread per hardware core. 
+    // Each thread after the first parses its own copy of the file, and holds about as much memory as the
+    // model's token stream and line index (see GetModelMemoryStats) until extraction is done.
+    int32_t numThreads;
+
+    // When non-zero, loading stops after parsing, and elements are tessellated on first access.
+    int32_t lazy;
+
+    // Approximate number of bytes of tessellated geometry kept in memory in lazy mode. 
+    // Zero means no limit.
+    uint64_t cacheBudgetBytes;
+
+    // UTF-8 path of a directory holding the persistent geometry cache, or null to disable it.
+    // Not used in lazy mode.
+    const char* cacheDirectory;
+
+    // When non-zero, loading phases and the tessellation of every element are recorded for WriteTrace
+    int32_t trace;
+
+    // Elements taking longer than this to tessellate are discarded and reported by GetSkippedElements.
+    // The time is only checked once an element is done. Zero means no limit.
+    double elementTimeBudgetSeconds;
+
+    // Elements producing more triangles than this are discarded and reported. Zero means no limit.
+    int64_t elementTriangleBudget;
+
+    // Once tessellation during load has run this long, the remaining elements are skipped and reported.
+    // Each thread may overrun by the element it is working on. Zero means no limit. Not used in lazy mode.
+    double extractTimeBudgetSeconds;
+
+    // Selects the elements to tessellate, or null to keep every element except opening elements and spaces
+    const ElementFilterSpec* filter;
+
+    // Limits the number of threads so that the copies of the file parsed for them fit in this many bytes. 
+    // Zero means no limit.
+    uint64_t workerMemoryBudgetBytes;
+
+    LoadOptions() 
+        : numThreads(1), lazy(0), cacheBudgetBytes(0), cacheDirectory(nullptr), trace(0), 
+          elementTimeBudgetSeconds(0), elementTriangleBudget(0), extractTimeBudgetSeconds(0), filter(nullptr),
+          workerMemoryBudgetBytes(0)
+    {}
+};
+
+// A copy of LoadOptions that owns the strings and arrays it points to, 
+// so that a load job can start after the caller has released them
+struct OwnedLoadOptions
+{
+    LoadOptions options;
+    std::string cacheDirectory;
+    ElementFilter filter;
+    ElementFilterSpec filterSpec = {};
+
+    explicit OwnedLoadOptions(const LoadOptions& o)
+        : options(o)
+    {
+        if (o.cacheDirectory)
+        {
+            cacheDirectory = o.cacheDirectory;
+            options.cacheDirectory = cacheDirectory.c_str();
+        }
+        if (o.filter)
+        {
+            filter = o.filter->ToFilter();
+            filterSpec = ElementFilterSpec::FromFilter(filter);
+            options.filter = &filterSpec;
+        }
+    }
+
+    OwnedLoadOptions(const OwnedLoadOptions&) = delete;
+    OwnedLoadOptions& operator=(const OwnedLoadOptions&) = delete;
+};
+
+// A model being loaded on the job queue of an Api
+struct LoadJob
+{
+    std::future<::Model*> result;
+};
+
+// Options controlling how the geometry of a model is streamed
+struct StreamOptions
+{
+    // Number of threads tessellating elements in the background. 
+    // 0 or less uses one thread per hardware core. Only used in lazy mode.
+    int32_t numThreads;
+
+    // Maximum number of finished elements waiting for the consumer. Tessellation pauses while it is full.
+    int32_t queueCapacity;
+
+    // Approximate number of bytes of tessellated geometry after which a worker clears its geometry processor cache.
+    // Zero means no limit.
+    uint64_t processorBudgetBytes;
+
+    StreamOptions() : numThreads(1), queueCapacity(64), processorBudgetBytes(0) {}
+};
+
+// Levels of detail built by BuildLods, from the most to the least detailed. 
+// Each level is simplified from the previous one, and stops at whichever target it reaches first.
+// At least one of triangleRatios and maxErrors must be given.
+struct LodOptions
+{
+    int32_t numLevels;
+
+    // Number of threads simplifying geometries. 0 or less uses one thread per hardware core.
+    int32_t numThreads;
+
+    // numLevels fractions of the full triangle count to keep, or null to only use maxErrors
+    const double* triangleRatios;
+
+    // numLevels largest errors allowed, as fractions of the bounding box diagonal of each geometry, 
+    // or null to only use triangleRatios
+    const double* maxErrors;
+};
+
+// Post-processing applied by OptimizeGeometries to every unique geometry, in this order
+struct OptimizeOptions
+{
+    // Vertices closer than this on every axis, in model units, are merged if their normals also match.
+    // 0 only merges vertices with identical positions.
+    double positionTolerance;
+
+    // Largest angle between the normals of merged vertices, in radians
+    double normalTolerance;
+
+    // Number of threads optimizing geometries. 0 or less uses one thread per hardware core.
+    int32_t numThreads;
+
+    int32_t weld;                   // merge duplicate vertices
+    int32_t removeDegenerates;      // drop triangles that use a vertex twice, e.g. after welding
+    int32_t optimizeVertexCache;    // order triangles for the post-transform vertex cache
+    int32_t optimizeVertexFetch;    // order vertices by first use in the index buffer
+
+    OptimizeOptions() 
+        : positionTolerance(1e-6), normalTolerance(0.01), numThreads(0), 
+          weld(1), removeDegenerates(1), optimizeVertexCache(1), optimizeVertexFetch(1) 
+    {}
+};
+
+// Totals over the unique geometries, before and after OptimizeGeometries.
+// The miss ratios are the vertices transformed per triangle with a 16 entry FIFO cache, weighted by triangles.
+struct OptimizeStats
+{
+    int64_t geometries;
+    int64_t verticesBefore;
+    int64_t verticesAfter;
+    int64_t indicesBefore;
+    int64_t indicesAfter;
+    double cacheMissRatioBefore;
+    double cacheMissRatioAfter;
+};
+
+// Options of ExportGlb
+struct GlbOptions
+{
+    // Also shares geometries with different IDs but identical buffers (see GetInstanceCounts)
+    int32_t dedupByContent;
+
+    // Draws geometries placed more than once with a single EXT_mesh_gpu_instancing node, 
+    // instead of a node per placement. Placements with shear or mirroring keep their own nodes.
+    int32_t gpuInstancing;
+
+    // Subtracted from every placement, to keep large site coordinates precise in float renderers
+    double originX;
+    double originY;
+    double originZ;
+
+    // Number of threads encoding geometries. 0 or less uses one thread per hardware core.
+    int32_t numThreads;
+
+    GlbOptions() 
+        : dedupByContent(1), gpuInstancing(0), originX(0), originY(0), originZ(0), numThreads(0) 
+    {}
+};
+
+// Bytes of the buffer receiving the root object ID of ExportSpeckle: 32 hex digits and a terminating zero
+constexpr int64_t SpeckleRootIdCapacity = 33;
+
+// Options of ExportSpeckle
+struct SpeckleOptions
+{
+    // Largest chunk of lines passed to the sink at once, unless a single object is larger. 
+    // The default matches the batches of the Speckle server transport.
+    int64_t chunkBytes;
+
+    int32_t includeGeometry;        // placed meshes as displayValue
+    int32_t includeProperties;      // property sets as dictionaries
+
+    // Number of threads building objects. 0 or less uses one thread per hardware core.
+    int32_t numThreads;
+
+    SpeckleOptions() 
+        : chunkBytes(10 << 20), includeGeometry(1), includeProperties(1), numThreads(0) 
+    {}
+};
+
+// Approximate memory held by a model, in bytes
+struct ModelMemoryStats
+{
+    int64_t sourceBytes;        // the IFC data the model reads from (memory mapped, or owned by the caller)
+    int64_t tokenStreamBytes;   // engine token streams, including those of worker models
+    int64_t lineIndexBytes;     // engine line indices, estimated from the number of lines
+    int64_t geometryBytes;      // tessellated vertex and index buffers referenced by the model
+    int64_t wrapperBytes;       // Geometry and Mesh objects
+    int64_t tableBytes;         // instance table, relation index and property table
+};
+
+// Instrumentation counters of a model. Tessellation counters include elements tessellated again 
+// after being evicted from the lazy cache, and times are summed over all threads.
+// The arrays are owned by the model, and remain valid until the next call to GetStats.
+struct ModelStats
+{
+    int64_t elements;
+    int64_t meshes;
+    int64_t vertices;
+    int64_t triangles;
+    double tessellationSeconds;
+    double parseSeconds;                // tokenizing and indexing the source, and collecting elements
+    double extractSeconds;              // wall clock time of tessellation during load
+    int64_t cacheHits;                  // lazy cache lookups that found the geometry
+    int64_t cacheMisses;                // lazy cache lookups that tessellated the element
+    int64_t bytesAllocated;             // wrappers and geometry buffers copied out of the geometry processor
+    int32_t fromPersistentCache;        // non-zero when the geometry was read from the persistent cache
+    int32_t numTypes;
+    int32_t numSlowest;
+    int32_t numSkipped;                 // elements reported by GetSkippedElements
+    const TypeStats* types;             // numTypes, ordered by type code
+    const ElementTiming* slowest;       // numSlowest, slowest first
+};
+
 // Vertex data structure as used by the web-IFC engine
 struct Vertex 
 {
@@ -57,112 +479,2743 @@ struct Vertex
     double Nx, Ny, Nz;
 };
 
-// Color data
-struct Color 
-{
-    double R, G, B, A;
-    Color() : R(0), G(0), B(0), A(0) {}
-    Color(double r, double g, double b, double a)
-        : R(r), G(g), B(b), A(a) {}
-};
+// Color data
+struct Color 
+{
+    double R, G, B, A;
+    Color() : R(0), G(0), B(0), A(0) {}
+    Color(double r, double g, double b, double a)
+        : R(r), G(g), B(b), A(a) {}
+};
+
+// Totals for a whole model, used to size the buffers passed to ExportMeshes.
+// In lazy mode both calls tessellate every element that is not cached, so with a cache budget 
+// smaller than the model's geometry, most elements are tessellated twice.
+struct MeshCounts
+{
+    int64_t numElements;        // elements with at least one mesh
+    int64_t numMeshes;
+    int64_t numVertices;
+    int64_t numIndices;
+};
+
+// Caller-allocated arrays filled by ExportMeshes, in element order then mesh order.
+// Any pointer may be null, in which case that array is skipped.
+// Indices are relative to the start of their mesh's vertices, as in GetIndices.
+// Export stops before the first mesh that does not fit in the capacities, and returns the number of meshes written.
+struct MeshBuffers
+{
+    void* vertices;             // numVertices * GetVertexStride(format) bytes
+    uint32_t* indices;          // numIndices
+    uint32_t* elementIds;       // numMeshes: express ID of the owning element
+    uint32_t* geometryIds;      // numMeshes: express ID of the geometry
+    int64_t* vertexOffsets;     // numMeshes
+    int32_t* vertexCounts;      // numMeshes
+    int64_t* indexOffsets;      // numMeshes
+    int32_t* indexCounts;       // numMeshes
+    double* transforms;         // numMeshes * 16
+    double* colors;             // numMeshes * 4
+    double* bounds;             // numMeshes * 6: min xyz, max xyz of the encoded positions
+    int64_t meshCapacity;       // meshes the per-mesh arrays can hold
+    int64_t vertexCapacity;     // vertices the vertex array can hold
+    int64_t indexCapacity;      // indices the index array can hold
+};
+
+// Totals for the instance table of a model, used to size the buffers passed to ExportInstances
+struct InstanceCounts
+{
+    int64_t numGeometries;
+    int64_t numInstances;
+    int64_t numVertices;        // over unique geometries only
+    int64_t numIndices;         // over unique geometries only
+};
+
+// Caller-allocated arrays filled by ExportInstances. Any pointer may be null.
+// Each unique geometry is written once, in local space. 
+// Every placed mesh of every element becomes an instance referring to a unique geometry.
+struct InstanceBuffers
+{
+    void* vertices;             // numVertices * GetVertexStride(format) bytes
+    uint32_t* indices;          // numIndices
+    uint32_t* geometryIds;      // numGeometries: express ID of the first geometry with this content
+    uint64_t* geometryHashes;   // numGeometries: hash of the vertex and index buffers
+    int64_t* vertexOffsets;     // numGeometries
+    int32_t* vertexCounts;      // numGeometries
+    int64_t* indexOffsets;      // numGeometries
+    int32_t* indexCounts;       // numGeometries
+    double* bounds;             // numGeometries * 6: min xyz, max xyz of the encoded positions
+    uint32_t* elementIds;       // numInstances: express ID of the owning element
+    int32_t* geometryIndices;   // numInstances: index of the unique geometry
+    double* transforms;         // numInstances * 16
+    double* colors;             // numInstances * 4
+};
+
+// Totals for the draw batches of a model, used to size the buffers passed to ExportBatches
+struct BatchCounts
+{
+    int64_t numBatches;
+    int64_t numRanges;
+    int64_t numVertices;
+    int64_t numIndices;
+};
+
+// Caller-allocated arrays filled by ExportBatches. Any pointer may be null.
+// Placed meshes with the same color are merged into one batch, so that each batch is a single draw.
+// Vertices are always in world space, whatever encoding.worldSpace is. Opaque batches come first, then transparent ones.
+// The ranges of a batch map its triangles back to elements for picking: index i of a batch belongs to 
+// the range r with rangeFirstIndices[r] <= i < rangeFirstIndices[r] + rangeIndexCounts[r].
+struct BatchBuffers
+{
+    void* vertices;             // numVertices * GetVertexStride(format) bytes
+    uint32_t* indices;          // numIndices, relative to the first vertex of their batch
+    int64_t* vertexOffsets;     // numBatches
+    int32_t* vertexCounts;      // numBatches
+    int64_t* indexOffsets;      // numBatches
+    int32_t* indexCounts;       // numBatches
+    double* colors;             // numBatches * 4
+    double* bounds;             // numBatches * 6: min xyz, max xyz of the encoded positions
+    int64_t* rangeOffsets;      // numBatches: index of the first range of the batch
+    int32_t* rangeCounts;       // numBatches
+    uint32_t* rangeElementIds;  // numRanges: express ID of the element
+    int32_t* rangeFirstIndices; // numRanges: relative to the index offset of the batch, in sorted order
+    int32_t* rangeIndexCounts;  // numRanges
+};
+
+// Sizes of the arrays of a LineTable
+struct LineTableCounts
+{
+    int64_t numLines;
+    int64_t numValues;
+    int64_t numReals;
+    int64_t numStrings;
+    int64_t numStringBytes;
+};
+
+// Pointers to the arrays of a LineTable (see LineDecoder.h for the layout). 
+// They remain valid until FreeLineTable is called.
+struct LineTableArrays
+{
+    const uint32_t* lineIds;        // numLines
+    const uint32_t* lineTypes;      // numLines
+    const uint32_t* lineOffsets;    // numLines + 1
+    const uint8_t* tags;            // numValues
+    const int64_t* values;          // numValues
+    const double* reals;            // numReals
+    const uint32_t* stringOffsets;  // numStrings + 1
+    const char* stringData;         // numStringBytes, UTF-8, not null terminated
+};
+
+// Sizes of the arrays of the relation index of a model
+struct RelationIndexCounts
+{
+    int64_t numRelations;
+    int64_t numEdges;
+    int64_t numOffsets;             // max express ID + 2
+};
+
+// Pointers to the arrays of the relation index of a model (see RelationIndex.h).
+// The neighbors of an express ID are at [offsets[id], offsets[id + 1]) in the ids and relations arrays.
+// They remain valid for the lifetime of the model.
+struct RelationIndexArrays
+{
+    const uint32_t* relationIds;        // numRelations
+    const uint32_t* relationTypes;      // numRelations
+    const uint32_t* forwardOffsets;     // numOffsets
+    const uint32_t* forwardIds;         // numEdges: related objects
+    const uint32_t* forwardRelations;   // numEdges: index of the relation
+    const uint32_t* reverseOffsets;     // numOffsets
+    const uint32_t* reverseIds;         // numEdges: relating objects
+    const uint32_t* reverseRelations;   // numEdges: index of the relation
+};
+
+// Sizes of the arrays of the property table of a model
+struct PropertyTableCounts
+{
+    int64_t numRows;
+    int64_t numStrings;
+    int64_t numStringBytes;
+};
+
+// Pointers to the columns of the property table of a model (see PropertyTable.h), one value per row.
+// Name and string value columns are indices into the string pool, or 0xFFFFFFFF when absent.
+// They remain valid for the lifetime of the model.
+struct PropertyTableArrays
+{
+    const uint32_t* elementIds;
+    const uint32_t* propertySetIds;
+    const uint32_t* propertySetNameIds;
+    const uint32_t* propertyIds;
+    const uint32_t* propertyNameIds;
+    const uint32_t* complexNameIds;
+    const uint32_t* valueTypeIds;
+    const int32_t* valueIndices;
+    const uint8_t* valueKinds;
+    const int64_t* intValues;
+    const double* realValues;
+    const uint32_t* stringOffsets;      // numStrings + 1
+    const char* stringData;             // numStringBytes, UTF-8, not null terminated
+};
+
+// Sizes of the arrays of the GlobalId table of a model
+struct GlobalIdTableCounts
+{
+    int64_t numIds;
+    int64_t numDuplicates;          // lines sharing the GlobalId of a line with a lower express ID
+};
+
+// Pointers to the arrays of the GlobalId table of a model (see GlobalIdTable.h).
+// GUIDs are 16 bytes each, in the byte order of their canonical text form.
+// They remain valid for the lifetime of the model.
+struct GlobalIdTableArrays
+{
+    const uint32_t* expressIds;     // numIds, ascending
+    const uint8_t* guids;           // numIds * 16: the GlobalId of each express ID
+    const uint32_t* guidOrder;      // numIds: positions in the arrays above, sorted by GlobalId
+};
+
+// Sizes of the change set of a model created by ReloadModel, relative to the previous revision.
+// All zero for a model that was not reloaded.
+struct ChangeSetCounts
+{
+    int64_t numAdded;               // elements whose GlobalId is not in the previous revision
+    int64_t numRemoved;             // elements of the previous revision whose GlobalId is gone
+    int64_t numModified;            // elements whose content hash changed
+    int64_t numUnchanged;
+    int64_t numReused;              // elements whose geometry was taken from the previous revision
+    int64_t numTessellated;         // elements tessellated by the reload
+    double hashSeconds;             // wall clock time of hashing and matching both revisions
+};
+
+// Pointers to the arrays of the change set of a model, valid for the lifetime of the model
+struct ChangeSetArrays
+{
+    const uint32_t* addedIds;               // numAdded express IDs of the new revision
+    const uint32_t* removedIds;             // numRemoved express IDs of the previous revision
+    const uint32_t* modifiedIds;            // numModified express IDs of the new revision
+    const uint32_t* modifiedPreviousIds;    // numModified: the express ID of each in the previous revision
+};
+
+struct Mesh 
+{
+    IfcGeometry* geometry;
+    // Set when the mesh holds its own copy of the geometry buffers (lazy mode, or tessellated by a worker model), 
+    // rather than pointing into the geometry processor's cache.
+    std::shared_ptr<IfcGeometry> ownedGeometry;
+    Color color;
+    uint32_t id;
+    std::array<double, 16> transform;
+
+    // Simplified versions of the geometry, from the most to the least detailed, shared by meshes with the same geometry
+    std::vector<std::shared_ptr<IfcGeometry>> lods;
+
+    // World-space bounds of the transformed vertices, empty if there are none
+    Aabb bounds;
+
+    Mesh(uint32_t id) 
+        : geometry(nullptr), id(id), transform({}), color() 
+    { }
+
+    void UpdateBounds()
+    {
+        bounds = Aabb();
+        auto& vd = geometry->vertexData;
+        if (vd.empty())
+            return;
+        double box[6];
+        VertexEncoder(transform.data(), 0, 0, 0).ComputeBounds(vd.data(), vd.size() / 6, box);
+        bounds = Aabb::FromArray(box);
+    }
+};
+
+struct Geometry 
+{
+    uint32_t id;
+    IfcFlatMesh* flatMesh;
+    std::vector<Mesh*> meshes;    
+
+    // Set when the geometry and its meshes were allocated from the model's arena, which releases them
+    bool inArena;
+
+    // World-space bounds of all the meshes
+    Aabb bounds;
+
+    Geometry(uint32_t id, bool inArena = false)
+        : id(id), flatMesh(nullptr), inArena(inArena)
+    {}
+
+    ~Geometry()
+    {
+        if (inArena)
+            return;
+        for (auto m : meshes)
+            delete m;
+    }
+
+    void UpdateBounds()
+    {
+        bounds = Aabb();
+        for (auto m : meshes)
+            bounds.Add(m->bounds);
+    }
+
+    // Approximate number of bytes held by this geometry, counting shared buffers once 
+    size_t OwnedBytes() const
+    {
+        size_t r = sizeof(Geometry) + meshes.size() * sizeof(Mesh);
+        std::unordered_set<IfcGeometry*> counted;
+        for (auto m : meshes)
+        {
+            if (m->ownedGeometry && counted.insert(m->ownedGeometry.get()).second)
+                r += m->ownedGeometry->vertexData.size() * sizeof(double)
+                    + m->ownedGeometry->indexData.size() * sizeof(uint32_t);
+        }
+        return r;
+    }
+};
+
+// A geometry shared by one or more placed meshes.
+// The owner keeps the buffers alive when they were copied out of the geometry processor (lazy mode).
+struct UniqueGeometry
+{
+    uint32_t id;
+    IfcGeometry* geometry;
+    std::shared_ptr<IfcGeometry> owner;
+    uint64_t hash;
+};
+
+struct MeshInstance
+{
+    uint32_t elementId;
+    int32_t geometryIndex;
+    std::array<double, 16> transform;
+    Color color;
+};
+
+// Unique geometries and the placements that refer to them.
+// Geometries are first shared by geometry express ID. With content deduplication, geometries 
+// with different IDs but byte-identical vertex and index buffers are merged as well.
+struct InstanceTable
+{
+    bool dedupByContent;
+    std::vector<UniqueGeometry> geometries;
+    std::vector<MeshInstance> instances;
+    int64_t numVertices = 0;
+    int64_t numIndices = 0;
+
+    static uint64_t Hash(const IfcGeometry& g)
+    {
+        return Hasher64().Add(g.vertexData).Add(g.indexData).Digest();
+    }
+
+    static bool SameContent(const IfcGeometry& a, const IfcGeometry& b)
+    {
+        return a.vertexData == b.vertexData && a.indexData == b.indexData;
+    }
+
+    size_t Bytes() const
+    {
+        return geometries.capacity() * sizeof(UniqueGeometry) + instances.capacity() * sizeof(MeshInstance);
+    }
+
+    void MergeIdenticalGeometries()
+    {
+        std::vector<UniqueGeometry> merged;
+        std::vector<int32_t> remap(geometries.size());
+        std::unordered_map<uint64_t, std::vector<int32_t>> byHash;
+        for (size_t i = 0; i < geometries.size(); ++i)
+        {
+            auto& g = geometries[i];
+            auto& candidates = byHash[g.hash];
+            auto found = -1;
+            for (auto c : candidates)
+            {
+                if (SameContent(*merged[c].geometry, *g.geometry))
+                {
+                    found = c;
+                    break;
+                }
+            }
+            if (found < 0)
+            {
+                found = (int32_t)merged.size();
+                candidates.push_back(found);
+                merged.push_back(g);
+            }
+            remap[i] = found;
+        }
+        for (auto& inst : instances)
+            inst.geometryIndex = remap[inst.geometryIndex];
+        geometries = std::move(merged);
+    }
+};
+
+// A placed mesh copied into a draw batch.
+// The owner keeps the buffers alive when they were copied out of the geometry processor (lazy mode).
+struct BatchedMesh
+{
+    uint32_t elementId;
+    IfcGeometry* geometry;
+    std::shared_ptr<IfcGeometry> owner;
+    std::array<double, 16> transform;
+    Aabb bounds;
+    int64_t vertexOffset;
+    int64_t indexOffset;
+};
+
+struct DrawBatch
+{
+    Color color;
+    int64_t vertexOffset;
+    int64_t indexOffset;
+    int64_t rangeOffset;
+    int64_t meshOffset;
+    int32_t vertexCount;
+    int32_t indexCount;
+    int32_t rangeCount;
+    int32_t meshCount;
+    Aabb bounds;
+};
+
+// Consecutive indices of a batch that belong to the same element
+struct PickRange
+{
+    uint32_t elementId;
+    int32_t firstIndex;
+    int32_t indexCount;
+};
+
+// Placed meshes grouped by color into batches of at most maxVerticesPerBatch vertices (0 for no limit).
+// A mesh larger than the limit gets a batch of its own. Batches are also split before their vertex or index count
+// would pass INT32_MAX, so that the 32-bit counts of batches and pick ranges cannot wrap.
+// The meshes of each batch are stored together, in element order.
+struct BatchTable
+{
+    int32_t maxVerticesPerBatch;
+    std::vector<DrawBatch> batches;
+    std::vector<BatchedMesh> meshes;
+    std::vector<PickRange> ranges;
+    int64_t numVertices = 0;
+    int64_t numIndices = 0;
+
+    size_t Bytes() const
+    {
+        return batches.capacity() * sizeof(DrawBatch) + meshes.capacity() * sizeof(BatchedMesh) 
+            + ranges.capacity() * sizeof(PickRange);
+    }
+};
+
+// The differences between a reloaded model and the revision it was reloaded from, by GlobalId
+struct ChangeSet
+{
+    std::vector<uint32_t> added;
+    std::vector<uint32_t> removed;
+    std::vector<uint32_t> modified;
+    std::vector<uint32_t> modifiedPrevious;
+    int64_t numUnchanged = 0;
+    int64_t numReused = 0;
+    int64_t numTessellated = 0;
+    double hashSeconds = 0;
+
+    size_t Bytes() const
+    {
+        return (added.capacity() + removed.capacity() + modified.capacity() + modifiedPrevious.capacity()) * sizeof(uint32_t);
+    }
+};
+
+// Model class, abstraction over the web-IFC engine concept of Model ID
+struct Model
+{
+    uint32_t id;
+    IfcLoader* loader;
+    IfcGeometryProcessor* geometryProcessor;
+    std::vector<uint32_t> elementIds;
+    std::unordered_map<uint32_t, ::Geometry*> geometries;
+
+    // Owns the Geometry and Mesh objects of geometry extracted during load or read from the cache,
+    // which are released together with the model
+    Arena arena;
+
+    // Additional engine models used by the parallel extraction workers, each with its own loader and geometry processor.
+    // They are closed once extraction during load is done, and kept by lazy models for their geometry streams.
+    std::vector<uint32_t> workerModelIds;
+
+    // Lazy mode state. Geometries are tessellated on first access and kept in an LRU cache.
+    // The geometry processor caches everything it tessellates, so it is cleared whenever
+    // the geometry pulled through it since the last clear exceeds the cache budget.
+    bool lazy = false;
+    std::unordered_set<uint32_t> elementIdSet;
+    LruCache<uint32_t, ::Geometry> cache;
+    size_t bytesSinceProcessorClear = 0;
+
+    std::unique_ptr<InstanceTable> instanceTable;
+    std::unique_ptr<BatchTable> batchTable;
+    std::unique_ptr<RelationIndex> relationIndex;
+    std::unique_ptr<PropertyTable> propertyTable;
+    std::unique_ptr<GlobalIdTable> globalIdTable;
+    std::unique_ptr<ElementFingerprints> fingerprints;
+    std::unique_ptr<SpatialIndex> spatialIndex;
+
+    // Set by ReloadModel
+    ChangeSet changes;
+
+    // The mapped file the loaders read from, when loaded from a file. 
+    // The loaders may request chunks of it again after loading, so it lives as long as the model.
+    std::shared_ptr<MappedFile> source;
+
+    // The memory the loaders read from, used to parse additional loaders for worker threads
+    const char* sourceData = nullptr;
+    size_t sourceSize = 0;
+
+    // When the geometry came from the persistent cache, parsing is deferred until the loader is needed
+    std::function<void()> deferredLoad;
+
+    // Selects the elements collected from the loader
+    ElementFilter filter;
+
+    // Threads used by the model's own parallel work that has no thread count option, such as exports.
+    // Resolved from LoadOptions.numThreads at load, so the default of 1 keeps that work serial.
+    size_t numThreads = 1;
+
+    // The IFC type of every collected element, used to attribute tessellation time
+    std::unordered_map<uint32_t, uint32_t> elementTypes;
+
+    Instrumentation stats;
+
+    // Limits on the tessellation of each element, and the elements that failed or exceeded them.
+    // Skipped elements have no geometry, and are not tessellated again in lazy mode.
+    ElementBudget budget;
+    SkipReport skipped;
+
+    double parseSeconds = 0;
+    double extractSeconds = 0;
+    bool fromPersistentCache = false;
+
+    // Storage for the arrays returned by GetStats
+    std::vector<TypeStats> statsTypes;
+    std::vector<ElementTiming> statsSlowest;
+
+    Model(IfcLoader* loader, IfcGeometryProcessor* processor, uint32_t id)
+        : loader(loader), geometryProcessor(processor), id(id)
+    { }
+
+    // Fills in the memory held by the model itself: the source, geometry buffers, wrappers and tables
+    void AddMemoryStats(ModelMemoryStats& stats) const
+    {
+        stats.sourceBytes += sourceSize;
+        std::unordered_set<const IfcGeometry*> counted;
+        for (auto& kv : geometries)
+        {
+            for (auto m : kv.second->meshes)
+            {
+                if (counted.insert(m->geometry).second)
+                    stats.geometryBytes += m->geometry->vertexData.capacity() * sizeof(double)
+                        + m->geometry->indexData.capacity() * sizeof(uint32_t);
+                for (auto& lod : m->lods)
+                    if (counted.insert(lod.get()).second)
+                        stats.geometryBytes += lod->vertexData.capacity() * sizeof(double)
+                            + lod->indexData.capacity() * sizeof(uint32_t);
+            }
+        }
+
+        // In lazy mode the cache accounts for the wrappers and buffers together, and the geometry processor 
+        // holds its own copy of what was tessellated since it was last cleared
+        stats.geometryBytes += cache.Bytes() + bytesSinceProcessorClear;
+        stats.wrapperBytes += arena.Bytes();
+
+        if (instanceTable)
+            stats.tableBytes += instanceTable->Bytes();
+        if (batchTable)
+            stats.tableBytes += batchTable->Bytes();
+        if (relationIndex)
+            stats.tableBytes += relationIndex->Bytes();
+        if (propertyTable)
+            stats.tableBytes += propertyTable->Bytes();
+        if (globalIdTable)
+            stats.tableBytes += globalIdTable->Bytes();
+        if (fingerprints)
+            stats.tableBytes += fingerprints->Bytes();
+        stats.tableBytes += changes.Bytes();
+        if (spatialIndex)
+            stats.tableBytes += spatialIndex->Bytes();
+    }
+
+    // Returns the loader, parsing the source first if that was deferred
+    IfcLoader* GetLoader()
+    {
+        if (deferredLoad)
+        {
+            auto load = std::move(deferredLoad);
+            deferredLoad = nullptr;
+            load();
+        }
+        return loader;
+    }
+
+    void CollectElements(IfcSchemaManager* schemas)
+    {
+        auto relations = filter.NeedsRelations() ? &GetRelationIndex() : nullptr;
+        filter.ForEachElement(loader, schemas->GetIfcElementList(), relations, [&](uint32_t eId, uint32_t type)
+        {
+            elementIds.push_back(eId);
+            elementTypes[eId] = type;
+        });
+    }
+
+    uint32_t ElementType(uint32_t eId) const
+    {
+        auto it = elementTypes.find(eId);
+        return it == elementTypes.end() ? 0 : it->second;
+    }
+
+    ModelStats GetStats()
+    {
+        ModelStats r = {};
+        statsTypes = stats.Types();
+        statsSlowest = stats.Slowest();
+        for (auto& t : statsTypes)
+        {
+            r.elements += t.elements;
+            r.meshes += t.meshes;
+            r.vertices += t.vertices;
+            r.triangles += t.triangles;
+            r.tessellationSeconds += t.seconds;
+        }
+        r.parseSeconds = parseSeconds;
+        r.extractSeconds = extractSeconds;
+        r.cacheHits = stats.cacheHits;
+        r.cacheMisses = stats.cacheMisses;
+        r.bytesAllocated = stats.bytesAllocated + (int64_t)arena.Bytes();
+        r.fromPersistentCache = fromPersistentCache ? 1 : 0;
+        r.numTypes = (int32_t)statsTypes.size();
+        r.numSlowest = (int32_t)statsSlowest.size();
+        r.numSkipped = (int32_t)skipped.Size();
+        r.types = statsTypes.data();
+        r.slowest = statsSlowest.data();
+        return r;
+    }
+
+    void EnableLazyExtraction(size_t budget)
+    {
+        lazy = true;
+        elementIdSet.insert(elementIds.begin(), elementIds.end());
+        cache.SetBudget(budget);
+    }
+
+    // Tessellates the given elements one after another on the calling thread. 
+    void ExtractGeometry(const std::vector<uint32_t>& ids)
+    {
+        for (auto eId : ids)
+            if (auto g = ExtractElement(geometryProcessor, eId, &arena))
+                geometries[eId] = g;
+    }
+
+    // Tessellates the given elements on a work-stealing pool, with one geometry processor per worker. 
+    // Results are gathered by element index and keyed by element ID, and the order of the model's elements
+    // comes from elementIds rather than from the map, so the result does not depend on which worker ran which element.
+    void ExtractGeometry(const std::vector<uint32_t>& ids, WorkStealingPool& pool, const std::vector<IfcGeometryProcessor*>& processors)
+    {
+        std::vector<::Geometry*> results(ids.size());
+        std::vector<uint8_t> fromWorker(ids.size(), 0);
+        pool.ForEach(ids.size(), [&](size_t worker, size_t i)
+        {
+            results[i] = ExtractElement(processors[worker], ids[i], &arena);
+            fromWorker[i] = worker != 0;
+        });
+        OwnWorkerGeometries(results, fromWorker, pool);
+        for (size_t i = 0; i < ids.size(); ++i)
+            if (results[i])
+                geometries[ids[i]] = results[i];
+    }
+
+    // Points the meshes tessellated by worker processors at buffers that outlive the worker models, 
+    // so that those can be closed: the model's own processor's geometry with the same ID when it has one, 
+    // otherwise a copy made once per geometry ID.
+    void OwnWorkerGeometries(const std::vector<::Geometry*>& results, const std::vector<uint8_t>& fromWorker, WorkStealingPool& pool)
+    {
+        std::unordered_map<uint32_t, IfcGeometry*> own;
+        for (size_t i = 0; i < results.size(); ++i)
+            if (results[i] && !fromWorker[i])
+                for (auto m : results[i]->meshes)
+                    own.emplace(m->id, m->geometry);
+
+        std::unordered_map<uint32_t, std::pair<const IfcGeometry*, std::shared_ptr<IfcGeometry>>> copies;
+        for (size_t i = 0; i < results.size(); ++i)
+            if (results[i] && fromWorker[i])
+                for (auto m : results[i]->meshes)
+                    if (own.find(m->id) == own.end())
+                        copies.emplace(m->id, std::make_pair(m->geometry, nullptr));
+
+        std::vector<std::pair<const IfcGeometry*, std::shared_ptr<IfcGeometry>>*> pending;
+        for (auto& c : copies)
+            pending.push_back(&c.second);
+        pool.ForEach(pending.size(), [&](size_t, size_t i)
+        {
+            auto copy = std::make_shared<IfcGeometry>();
+            copy->vertexData = pending[i]->first->vertexData;
+            copy->indexData = pending[i]->first->indexData;
+            pending[i]->second = std::move(copy);
+        });
+
+        for (size_t i = 0; i < results.size(); ++i)
+        {
+            if (!results[i] || !fromWorker[i])
+                continue;
+            for (auto m : results[i]->meshes)
+            {
+                auto it = own.find(m->id);
+                if (it != own.end())
+                {
+                    m->geometry = it->second;
+                    continue;
+                }
+                m->ownedGeometry = copies[m->id].second;
+                m->geometry = m->ownedGeometry.get();
+            }
+        }
+        for (auto& c : copies)
+            stats.bytesAllocated += (int64_t)(c.second.second->vertexData.size() * sizeof(double) 
+                + c.second.second->indexData.size() * sizeof(uint32_t));
+    }
+
+    // Allocates the wrappers from the arena if one is given, otherwise from the heap.
+    // Returns null, and adds the element to the skip report, if tessellation failed or exceeded the budget.
+    ::Geometry* ExtractElement(IfcGeometryProcessor* processor, uint32_t eId, Arena* arena = nullptr)
+    {
+        auto type = ElementType(eId);
+        auto start = stats.Now();
+        if (budget.PastDeadline(start))
+        {
+            skipped.Add({ eId, type, SkipReasonDeadline });
+            return nullptr;
+        }
+
+        IfcFlatMesh flatMesh;
+        try
+        {
+            flatMesh = processor->GetFlatMesh(eId);
+        }
+        catch (...)
+        {
+            auto end = stats.Now();
+            stats.RecordElement(eId, type, start, end, 0, 0, 0);
+            skipped.Add({ eId, type, SkipReasonException, 0, 0, std::chrono::duration<double>(end - start).count() });
+            return nullptr;
+        }
+        auto end = stats.Now();
+
+        int64_t vertices = 0;
+        int64_t indices = 0;
+        for (auto& placedGeom : flatMesh.geometries)
+        {
+            auto& geom = processor->GetGeometry(placedGeom.geometryExpressID);
+            vertices += geom.vertexData.size() / 6;
+            indices += geom.indexData.size();
+        }
+
+        auto seconds = std::chrono::duration<double>(end - start).count();
+        if (auto reason = budget.Check(seconds, indices / 3))
+        {
+            stats.RecordElement(eId, type, start, end, 0, 0, 0);
+            SkippedElement e = { eId, type, reason, 1, indices / 3, seconds };
+            ComputeBounds(processor, flatMesh, e.bounds);
+            skipped.Add(e);
+            return nullptr;
+        }
+
+        auto g = ToGeometry(processor, eId, flatMesh, arena);
+        stats.RecordElement(eId, type, start, end, (int64_t)g->meshes.size(), vertices, indices / 3);
+        return g;
+    }
+
+    // World-space bounds of all the placed geometries of an element
+    static void ComputeBounds(IfcGeometryProcessor* processor, IfcFlatMesh& flatMesh, double* bounds)
+    {
+        std::fill(bounds, bounds + 6, 0.0);
+        auto first = true;
+        for (auto& placedGeom : flatMesh.geometries)
+        {
+            auto& vd = processor->GetGeometry(placedGeom.geometryExpressID).vertexData;
+            if (vd.empty())
+                continue;
+            double box[6];
+            VertexEncoder(placedGeom.flatTransformation.data(), 0, 0, 0).ComputeBounds(vd.data(), vd.size() / 6, box);
+            for (int r = 0; r < 3; ++r)
+            {
+                bounds[r] = first ? box[r] : std::min(bounds[r], box[r]);
+                bounds[r + 3] = first ? box[r + 3] : std::max(bounds[r + 3], box[r + 3]);
+            }
+            first = false;
+        }
+    }
+
+    // Builds the wrappers of an element that was already tessellated by the processor
+    ::Geometry* ToGeometry(IfcGeometryProcessor* processor, uint32_t eId, IfcFlatMesh& flatMesh, Arena* arena = nullptr)
+    {
+        auto g = arena ? arena->New<::Geometry>(eId, true) : new ::Geometry(eId);
+        for (auto& placedGeom : flatMesh.geometries)
+        {
+            auto mesh = ToMesh(processor, placedGeom, arena);
+            g->meshes.push_back(mesh);
+        }
+        g->UpdateBounds();
+        return g;
+    }
+
+    // Tessellates an element and copies the buffers out of the geometry processor,
+    // so that the result can outlive a clear of the processor's cache.
+    ::Geometry* ExtractOwnedElement(uint32_t eId)
+    {
+        return ExtractOwnedElement(geometryProcessor, eId);
+    }
+
+    ::Geometry* ExtractOwnedElement(IfcGeometryProcessor* processor, uint32_t eId)
+    {
+        auto g = ExtractElement(processor, eId);
+        if (!g)
+            return nullptr;
+        std::unordered_map<IfcGeometry*, std::shared_ptr<IfcGeometry>> copies;
+        for (auto m : g->meshes)
+        {
+            auto& copy = copies[m->geometry];
+            if (!copy)
+            {
+                copy = std::make_shared<IfcGeometry>();
+                copy->vertexData = m->geometry->vertexData;
+                copy->indexData = m->geometry->indexData;
+            }
+            m->ownedGeometry = copy;
+            m->geometry = copy.get();
+        }
+        stats.bytesAllocated += (int64_t)g->OwnedBytes();
+        return g;
+    }
+
+    ::Geometry* GetGeometry(uint32_t id)
+    {
+        if (lazy)
+            return GetOrExtractGeometry(id);
+        auto it = geometries.find(id);
+        if (it == geometries.end())
+            return nullptr;
+        return it->second;
+    }
+
+    // In lazy mode, a returned geometry remains valid until it is evicted from the cache, 
+    // which cannot happen before the next call to GetGeometry.
+    ::Geometry* GetOrExtractGeometry(uint32_t id)
+    {
+        if (auto cached = cache.Find(id))
+        {
+            stats.cacheHits++;
+            return cached;
+        }
+        if (elementIdSet.find(id) == elementIdSet.end() || skipped.Contains(id))
+            return nullptr;
+        stats.cacheMisses++;
+
+        auto g = std::unique_ptr<::Geometry>(ExtractOwnedElement(id));
+        if (!g)
+            return nullptr;
+        auto bytes = g->OwnedBytes();
+        bytesSinceProcessorClear += bytes;
+        if (cache.Budget() != 0 && bytesSinceProcessorClear > cache.Budget())
+        {
+            geometryProcessor->Clear();
+            bytesSinceProcessorClear = 0;
+        }
+        return cache.Insert(id, std::move(g), bytes);
+    }
+
+    // Calls f(elementId, mesh) for every mesh of every element, in element order.
+    // In lazy mode this tessellates every element that is not already cached.
+    template<typename F>
+    void ForEachMesh(F f)
+    {
+        for (auto eId : elementIds)
+        {
+            auto g = GetGeometry(eId);
+            if (!g)
+                continue;
+            for (auto m : g->meshes)
+                f(eId, m);
+        }
+    }
+
+    // In lazy mode this tessellates every element that is not cached, and ExportMeshes does so again 
+    // for the elements evicted in between.
+    MeshCounts GetMeshCounts()
+    {
+        MeshCounts r = {};
+        uint32_t lastElement = 0;
+        ForEachMesh([&](uint32_t eId, Mesh* m)
+        {
+            if (r.numMeshes == 0 || eId != lastElement)
+                r.numElements++;
+            lastElement = eId;
+            r.numMeshes++;
+            r.numVertices += m->geometry->vertexData.size() / 6;
+            r.numIndices += m->geometry->indexData.size();
+        });
+        return r;
+    }
+
+    // Fills the export buffers, up to their capacities. Meshes are encoded in parallel, except in lazy mode where
+    // the cache may evict a geometry before it is written, so meshes are written as they are extracted.
+    int64_t ExportMeshes(MeshBuffers& b, const VertexEncoding& encoding)
+    {
+        int64_t meshIndex = 0;
+        int64_t vertexOffset = 0;
+        int64_t indexOffset = 0;
+
+        if (lazy)
+        {
+            for (auto eId : elementIds)
+            {
+                auto g = GetGeometry(eId);
+                if (!g)
+                    continue;
+                for (auto m : g->meshes)
+                {
+                    if (!Fits(b, meshIndex, vertexOffset, indexOffset, m))
+                        return meshIndex;
+                    ExportMesh(b, encoding, meshIndex++, eId, m, vertexOffset, indexOffset);
+                    vertexOffset += m->geometry->vertexData.size() / 6;
+                    indexOffset += m->geometry->indexData.size();
+                }
+            }
+            return meshIndex;
+        }
+
+        struct Entry { uint32_t eId; Mesh* mesh; int64_t vertexOffset; int64_t indexOffset; };
+        std::vector<Entry> entries;
+        auto full = false;
+        ForEachMesh([&](uint32_t eId, Mesh* m)
+        {
+            full = full || !Fits(b, (int64_t)entries.size(), vertexOffset, indexOffset, m);
+            if (full)
+                return;
+            entries.push_back({ eId, m, vertexOffset, indexOffset });
+            vertexOffset += m->geometry->vertexData.size() / 6;
+            indexOffset += m->geometry->indexData.size();
+        });
+
+        WorkStealingPool pool(numThreads);
+        pool.ForEach(entries.size(), [&](size_t, size_t i)
+        {
+            auto& e = entries[i];
+            ExportMesh(b, encoding, i, e.eId, e.mesh, e.vertexOffset, e.indexOffset);
+        });
+        return (int64_t)entries.size();
+    }
+
+    static bool Fits(const MeshBuffers& b, int64_t meshIndex, int64_t vertexOffset, int64_t indexOffset, Mesh* m)
+    {
+        return meshIndex < b.meshCapacity
+            && (int64_t)(m->geometry->vertexData.size() / 6) <= b.vertexCapacity - vertexOffset
+            && (int64_t)m->geometry->indexData.size() <= b.indexCapacity - indexOffset;
+    }
+
+    static void ExportMesh(MeshBuffers& b, const VertexEncoding& encoding, int64_t meshIndex, uint32_t eId, Mesh* m, int64_t vertexOffset, int64_t indexOffset)
+    {
+        auto& vd = m->geometry->vertexData;
+        auto& id = m->geometry->indexData;
+        auto numVertices = vd.size() / 6;
+        if (b.vertices || b.bounds)
+        {
+            auto dst = b.vertices 
+                ? static_cast<uint8_t*>(b.vertices) + vertexOffset * VertexStride(encoding.format)
+                : nullptr;
+            auto bounds = b.bounds ? b.bounds + meshIndex * 6 : nullptr;
+            EncodeVertices(m, encoding, dst, bounds);
+        }
+        if (b.indices)
+            std::copy(id.begin(), id.end(), b.indices + indexOffset);
+        if (b.elementIds)
+            b.elementIds[meshIndex] = eId;
+        if (b.geometryIds)
+            b.geometryIds[meshIndex] = m->id;
+        if (b.vertexOffsets)
+            b.vertexOffsets[meshIndex] = vertexOffset;
+        if (b.vertexCounts)
+            b.vertexCounts[meshIndex] = (int32_t)numVertices;
+        if (b.indexOffsets)
+            b.indexOffsets[meshIndex] = indexOffset;
+        if (b.indexCounts)
+            b.indexCounts[meshIndex] = (int32_t)id.size();
+        if (b.transforms)
+            std::copy(m->transform.begin(), m->transform.end(), b.transforms + meshIndex * 16);
+        if (b.colors)
+            std::copy(&m->color.R, &m->color.R + 4, b.colors + meshIndex * 4);
+    }
+
+    // Writes the vertices of a mesh in the requested format. Either output may be null.
+    static void EncodeVertices(Mesh* m, const VertexEncoding& encoding, void* dst, double* bounds)
+    {
+        EncodeVertices(*m->geometry, encoding.worldSpace ? m->transform.data() : nullptr, encoding, dst, bounds);
+    }
+
+    // The transform is only applied if not null, regardless of encoding.worldSpace 
+    static void EncodeVertices(const IfcGeometry& g, const double* transform, const VertexEncoding& encoding, void* dst, double* bounds)
+    {
+        auto& vd = g.vertexData;
+        auto numVertices = vd.size() / 6;
+        auto isIdentity = encoding.format == VertexFormatDouble && !transform
+            && encoding.originX == 0 && encoding.originY == 0 && encoding.originZ == 0;
+        if (isIdentity && !bounds)
+        {
+            if (dst)
+                std::copy(vd.begin(), vd.end(), static_cast<double*>(dst));
+            return;
+        }
+
+        VertexEncoder encoder(transform, encoding.originX, encoding.originY, encoding.originZ);
+        if (dst)
+            encoder.Encode(vd.data(), numVertices, encoding.format, dst, bounds);
+        else
+            encoder.ComputeBounds(vd.data(), numVertices, bounds);
+    }
+
+    // Simplifies every unique geometry in parallel, and attaches the levels to the meshes that use it.
+    // Not available in lazy mode, where the meshes may be evicted before the levels are used, nor without
+    // any target, where every level would be simplified to nothing.
+    int32_t BuildLods(const LodOptions& options)
+    {
+        if (lazy || (!options.triangleRatios && !options.maxErrors))
+            return -1;
+        // Keyed by geometry ID, as the instance table is, since meshes with the same ID may point to different copies
+        std::vector<uint32_t> unique;
+        std::unordered_map<uint32_t, std::vector<Mesh*>> users;
+        ForEachMesh([&](uint32_t, Mesh* m)
+        {
+            auto& u = users[m->id];
+            if (u.empty())
+                unique.push_back(m->id);
+            u.push_back(m);
+        });
+
+        std::vector<std::vector<std::shared_ptr<IfcGeometry>>> lods(unique.size());
+        WorkStealingPool pool(ResolveNumThreads(options.numThreads));
+        pool.ForEach(unique.size(), [&](size_t, size_t i)
+        {
+            lods[i] = SimplifyGeometry(*users.at(unique[i]).front()->geometry, options);
+        });
+        for (size_t i = 0; i < unique.size(); ++i)
+            for (auto m : users[unique[i]])
+                m->lods = lods[i];
+        return options.numLevels;
+    }
+
+    static std::vector<std::shared_ptr<IfcGeometry>> SimplifyGeometry(const IfcGeometry& g, const LodOptions& options)
+    {
+        auto& vd = g.vertexData;
+        auto& id = g.indexData;
+        double bounds[6];
+        VertexEncoder(nullptr, 0, 0, 0).ComputeBounds(vd.data(), vd.size() / 6, bounds);
+        auto diagonal = std::sqrt(std::pow(bounds[3] - bounds[0], 2) + std::pow(bounds[4] - bounds[1], 2) + std::pow(bounds[5] - bounds[2], 2));
+
+        std::vector<std::shared_ptr<IfcGeometry>> r;
+        MeshSimplifier simplifier(vd.data(), vd.size() / 6, id.data(), id.size());
+        for (int32_t level = 0; level < options.numLevels; ++level)
+        {
+            auto ratio = options.triangleRatios ? std::clamp(options.triangleRatios[level], 0.0, 1.0) : 0.0;
+            auto maxError = options.maxErrors ? options.maxErrors[level] * diagonal : std::numeric_limits<double>::max();
+            simplifier.Simplify((size_t)(id.size() / 3 * ratio) * 3, maxError);
+            auto lod = std::make_shared<IfcGeometry>();
+            MeshSimplifier::Compact(vd.data(), simplifier.Indices(), lod->vertexData, lod->indexData);
+            r.push_back(lod);
+        }
+        return r;
+    }
+
+    // Replaces the buffers of every unique geometry with optimized copies, in parallel.
+    // Meshes keep sharing geometry, and the instance table is rebuilt on next use.
+    // Not available in lazy mode, where evicted geometries would be tessellated again without the optimization.
+    int64_t OptimizeGeometries(const OptimizeOptions& options, OptimizeStats& stats)
+    {
+        stats = {};
+        if (lazy)
+            return -1;
+        // Keyed by geometry ID, as the instance table is, since meshes with the same ID may point to different copies
+        std::vector<uint32_t> unique;
+        std::unordered_map<uint32_t, std::vector<Mesh*>> users;
+        ForEachMesh([&](uint32_t, Mesh* m)
+        {
+            auto& u = users[m->id];
+            if (u.empty())
+                unique.push_back(m->id);
+            u.push_back(m);
+        });
+
+        std::vector<std::shared_ptr<IfcGeometry>> optimized(unique.size());
+        std::vector<OptimizeStats> geometryStats(unique.size());
+        WorkStealingPool pool(ResolveNumThreads(options.numThreads));
+        pool.ForEach(unique.size(), [&](size_t, size_t i)
+        {
+            optimized[i] = OptimizeGeometry(*users.at(unique[i]).front()->geometry, options, geometryStats[i]);
+        });
+
+        for (size_t i = 0; i < unique.size(); ++i)
+        {
+            for (auto m : users[unique[i]])
+            {
+                m->ownedGeometry = optimized[i];
+                m->geometry = optimized[i].get();
+                m->UpdateBounds();
+            }
+            auto& g = geometryStats[i];
+            stats.verticesBefore += g.verticesBefore;
+            stats.verticesAfter += g.verticesAfter;
+            stats.indicesBefore += g.indicesBefore;
+            stats.indicesAfter += g.indicesAfter;
+            stats.cacheMissRatioBefore += g.cacheMissRatioBefore * g.indicesBefore;
+            stats.cacheMissRatioAfter += g.cacheMissRatioAfter * g.indicesAfter;
+        }
+        stats.geometries = (int64_t)unique.size();
+        stats.cacheMissRatioBefore = stats.indicesBefore ? stats.cacheMissRatioBefore / stats.indicesBefore : 0;
+        stats.cacheMissRatioAfter = stats.indicesAfter ? stats.cacheMissRatioAfter / stats.indicesAfter : 0;
+        for (auto eId : elementIds)
+            if (auto g = GetGeometry(eId))
+                g->UpdateBounds();
+        instanceTable.reset();
+        batchTable.reset();
+        spatialIndex.reset();
+        return stats.geometries;
+    }
+
+    static std::shared_ptr<IfcGeometry> OptimizeGeometry(const IfcGeometry& g, const OptimizeOptions& options, OptimizeStats& stats)
+    {
+        auto r = std::make_shared<IfcGeometry>();
+        r->vertexData = g.vertexData;
+        r->indexData = g.indexData;
+        auto& vd = r->vertexData;
+        auto& id = r->indexData;
+        stats.verticesBefore = vd.size() / 6;
+        stats.indicesBefore = id.size();
+        stats.cacheMissRatioBefore = MeshOptimizer::AverageCacheMissRatio(id, vd.size() / 6);
+
+        if (options.weld)
+            vd = MeshOptimizer::WeldVertices(vd, id, options.positionTolerance, options.normalTolerance);
+        if (options.removeDegenerates)
+            MeshOptimizer::RemoveDegenerateTriangles(id);
+        if (options.optimizeVertexCache)
+            MeshOptimizer::OptimizeVertexCache(id, vd.size() / 6);
+        if (options.optimizeVertexFetch)
+            vd = MeshOptimizer::OptimizeVertexFetch(vd, id);
+        vd.shrink_to_fit();
+        id.shrink_to_fit();
+
+        stats.verticesAfter = vd.size() / 6;
+        stats.indicesAfter = id.size();
+        stats.cacheMissRatioAfter = MeshOptimizer::AverageCacheMissRatio(id, vd.size() / 6);
+        return r;
+    }
+
+    // Builds the instance table, or returns the existing one if it was built with the same option
+    InstanceTable& GetInstanceTable(bool dedupByContent)
+    {
+        if (instanceTable && instanceTable->dedupByContent == dedupByContent)
+            return *instanceTable;
+
+        auto t = std::make_unique<InstanceTable>();
+        t->dedupByContent = dedupByContent;
+        std::unordered_map<uint32_t, int32_t> byId;
+        ForEachMesh([&](uint32_t eId, Mesh* m)
+        {
+            auto it = byId.find(m->id);
+            int32_t index;
+            if (it == byId.end())
+            {
+                index = (int32_t)t->geometries.size();
+                byId[m->id] = index;
+                t->geometries.push_back({ m->id, m->geometry, m->ownedGeometry, 0 });
+            }
+            else
+            {
+                index = it->second;
+            }
+            t->instances.push_back({ eId, index, m->transform, m->color });
+        });
+
+        WorkStealingPool pool(numThreads);
+        pool.ForEach(t->geometries.size(), [&](size_t, size_t i)
+        {
+            t->geometries[i].hash = InstanceTable::Hash(*t->geometries[i].geometry);
+        });
+
+        if (dedupByContent)
+            t->MergeIdenticalGeometries();
+
+        for (auto& g : t->geometries)
+        {
+            t->numVertices += g.geometry->vertexData.size() / 6;
+            t->numIndices += g.geometry->indexData.size();
+        }
+        instanceTable = std::move(t);
+        return *instanceTable;
+    }
+
+    // Builds the batch table, or returns the existing one if it was built with the same limit
+    BatchTable& GetBatchTable(int32_t maxVerticesPerBatch)
+    {
+        maxVerticesPerBatch = std::max(maxVerticesPerBatch, 0);
+        if (batchTable && batchTable->maxVerticesPerBatch == maxVerticesPerBatch)
+            return *batchTable;
+
+        auto t = std::make_unique<BatchTable>();
+        t->maxVerticesPerBatch = maxVerticesPerBatch;
+
+        // Assigns each mesh to the open batch of its color, starting a new one when it would exceed the limit
+        const int64_t maxCount = std::numeric_limits<int32_t>::max();
+        std::vector<std::vector<BatchedMesh>> members;
+        std::vector<int64_t> vertexCounts;
+        std::vector<int64_t> indexCounts;
+        std::map<std::array<double, 4>, size_t> open;
+        ForEachMesh([&](uint32_t eId, Mesh* m)
+        {
+            auto numVertices = (int64_t)(m->geometry->vertexData.size() / 6);
+            auto numIndices = (int64_t)m->geometry->indexData.size();
+            if (numVertices == 0 || numIndices == 0)
+                return;
+            std::array<double, 4> key = { m->color.R, m->color.G, m->color.B, m->color.A };
+            auto it = open.find(key);
+            if (it == open.end() 
+                || (maxVerticesPerBatch > 0 && vertexCounts[it->second] + numVertices > maxVerticesPerBatch)
+                || vertexCounts[it->second] + numVertices > maxCount
+                || indexCounts[it->second] + numIndices > maxCount)
+            {
+                DrawBatch b = {};
+                b.color = m->color;
+                t->batches.push_back(b);
+                members.emplace_back();
+                vertexCounts.push_back(0);
+                indexCounts.push_back(0);
+                it = open.insert_or_assign(key, t->batches.size() - 1).first;
+            }
+            members[it->second].push_back({ eId, m->geometry, m->ownedGeometry, m->transform, m->bounds, 0, 0 });
+            vertexCounts[it->second] += numVertices;
+            indexCounts[it->second] += numIndices;
+        });
+
+        // Opaque batches are drawn first, so that transparent ones blend over them
+        std::vector<size_t> order(t->batches.size());
+        for (size_t i = 0; i < order.size(); ++i)
+            order[i] = i;
+        std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b)
+        {
+            return (t->batches[a].color.A < 1) < (t->batches[b].color.A < 1);
+        });
+
+        std::vector<DrawBatch> batches;
+        for (auto i : order)
+        {
+            auto b = t->batches[i];
+            b.vertexOffset = t->numVertices;
+            b.indexOffset = t->numIndices;
+            b.rangeOffset = (int64_t)t->ranges.size();
+            b.meshOffset = (int64_t)t->meshes.size();
+            for (auto& bm : members[i])
+            {
+                auto numIndices = (int32_t)bm.geometry->indexData.size();
+                bm.vertexOffset = t->numVertices;
+                bm.indexOffset = t->numIndices;
+                auto firstIndex = (int32_t)(t->numIndices - b.indexOffset);
+                if (b.rangeCount > 0 && t->ranges.back().elementId == bm.elementId)
+                    t->ranges.back().indexCount += numIndices;
+                else
+                {
+                    t->ranges.push_back({ bm.elementId, firstIndex, numIndices });
+                    b.rangeCount++;
+                }
+                b.bounds.Add(bm.bounds);
+                t->numVertices += bm.geometry->vertexData.size() / 6;
+                t->numIndices += numIndices;
+                t->meshes.push_back(std::move(bm));
+            }
+            b.vertexCount = (int32_t)(t->numVertices - b.vertexOffset);
+            b.indexCount = (int32_t)(t->numIndices - b.indexOffset);
+            b.meshCount = (int32_t)members[i].size();
+            batches.push_back(b);
+        }
+        t->batches = std::move(batches);
+        batchTable = std::move(t);
+        return *batchTable;
+    }
+
+    BatchCounts GetBatchCounts(int32_t maxVerticesPerBatch)
+    {
+        auto& t = GetBatchTable(maxVerticesPerBatch);
+        return { (int64_t)t.batches.size(), (int64_t)t.ranges.size(), t.numVertices, t.numIndices };
+    }
+
+    // Writes the batches, baking every mesh into world space. Meshes are encoded in parallel.
+    int64_t ExportBatches(int32_t maxVerticesPerBatch, const VertexEncoding& encoding, BatchBuffers& b)
+    {
+        auto& t = GetBatchTable(maxVerticesPerBatch);
+
+        // The encoded bounds of a batch are its world bounds relative to the origin
+        double origin[3] = { encoding.originX, encoding.originY, encoding.originZ };
+        std::vector<std::array<double, 6>> boxes(t.batches.size());
+        for (size_t i = 0; i < t.batches.size(); ++i)
+        {
+            auto& box = t.batches[i].bounds;
+            for (int r = 0; r < 3; ++r)
+            {
+                boxes[i][r] = box.min[r] - origin[r];
+                boxes[i][r + 3] = box.max[r] - origin[r];
+            }
+        }
+
+        std::vector<int32_t> batchOfMesh(t.meshes.size());
+        for (size_t i = 0; i < t.batches.size(); ++i)
+            std::fill_n(batchOfMesh.begin() + t.batches[i].meshOffset, t.batches[i].meshCount, (int32_t)i);
+
+        auto stride = VertexStride(encoding.format);
+        WorkStealingPool pool(numThreads);
+        pool.ForEach(t.meshes.size(), [&](size_t, size_t i)
+        {
+            auto& m = t.meshes[i];
+            auto& batch = t.batches[batchOfMesh[i]];
+            auto& vd = m.geometry->vertexData;
+            if (b.vertices)
+            {
+                VertexEncoder encoder(m.transform.data(), origin[0], origin[1], origin[2]);
+                auto dst = static_cast<uint8_t*>(b.vertices) + m.vertexOffset * stride;
+                encoder.EncodeWithBounds(vd.data(), vd.size() / 6, encoding.format, dst, boxes[batchOfMesh[i]].data());
+            }
+            if (b.indices)
+            {
+                auto base = (uint32_t)(m.vertexOffset - batch.vertexOffset);
+                auto dst = b.indices + m.indexOffset;
+                for (auto index : m.geometry->indexData)
+                    *dst++ = index + base;
+            }
+        });
+
+        for (size_t i = 0; i < t.batches.size(); ++i)
+        {
+            auto& batch = t.batches[i];
+            if (b.vertexOffsets)
+                b.vertexOffsets[i] = batch.vertexOffset;
+            if (b.vertexCounts)
+                b.vertexCounts[i] = batch.vertexCount;
+            if (b.indexOffsets)
+                b.indexOffsets[i] = batch.indexOffset;
+            if (b.indexCounts)
+                b.indexCounts[i] = batch.indexCount;
+            if (b.colors)
+                std::copy(&batch.color.R, &batch.color.R + 4, b.colors + i * 4);
+            if (b.bounds)
+                std::copy(boxes[i].begin(), boxes[i].end(), b.bounds + i * 6);
+            if (b.rangeOffsets)
+                b.rangeOffsets[i] = batch.rangeOffset;
+            if (b.rangeCounts)
+                b.rangeCounts[i] = batch.rangeCount;
+        }
+        for (size_t i = 0; i < t.ranges.size(); ++i)
+        {
+            auto& r = t.ranges[i];
+            if (b.rangeElementIds)
+                b.rangeElementIds[i] = r.elementId;
+            if (b.rangeFirstIndices)
+                b.rangeFirstIndices[i] = r.firstIndex;
+            if (b.rangeIndexCounts)
+                b.rangeIndexCounts[i] = r.indexCount;
+        }
+        return (int64_t)t.batches.size();
+    }
+
+    // Writes the model as binary glTF. Each unique geometry of the instance table becomes one set of buffers, 
+    // each color a material, and each placement a node with the express ID of its element in its extras.
+    // Geometries are encoded to floats in parallel, a slice at a time, as they are written to the sink.
+    template<typename Sink>
+    int64_t ExportGlb(const GlbOptions& options, Sink sink)
+    {
+        auto& t = GetInstanceTable(options.dedupByContent != 0);
+
+        GlbWriter w;
+        w.gpuInstancing = options.gpuInstancing != 0;
+        WorkStealingPool pool(ResolveNumThreads(options.numThreads));
+        w.geometries.resize(t.geometries.size());
+        pool.ForEach(t.geometries.size(), [&](size_t, size_t i)
+        {
+            auto& g = *t.geometries[i].geometry;
+            auto& out = w.geometries[i];
+            out.numVertices = (int64_t)(g.vertexData.size() / 6);
+            out.numIndices = (int64_t)g.indexData.size();
+            double box[6];
+            VertexEncoder(nullptr, 0, 0, 0).ComputeBounds(g.vertexData.data(), out.numVertices, box);
+            std::copy(box, box + 3, out.min);
+            std::copy(box + 3, box + 6, out.max);
+        });
+
+        std::map<std::array<double, 4>, int32_t> materials;
+        for (auto& inst : t.instances)
+        {
+            std::array<double, 4> color = { inst.color.R, inst.color.G, inst.color.B, inst.color.A };
+            auto it = materials.find(color);
+            if (it == materials.end())
+            {
+                it = materials.insert({ color, (int32_t)w.materials.size() }).first;
+                w.materials.push_back(color);
+            }
+            auto matrix = inst.transform;
+            matrix[12] -= options.originX;
+            matrix[13] -= options.originY;
+            matrix[14] -= options.originZ;
+            w.instances.push_back({ inst.geometryIndex, it->second, inst.elementId, matrix });
+        }
+
+        const double unused[6] = {};
+        return w.Write(sink, [&](int32_t i, float* vertices, uint32_t* indices)
+            {
+                auto& g = *t.geometries[i].geometry;
+                VertexEncoder(nullptr, 0, 0, 0).EncodeWithBounds(g.vertexData.data(), g.vertexData.size() / 6, 
+                    VertexFormatFloat, vertices, unused);
+                std::copy(g.indexData.begin(), g.indexData.end(), indices);
+            }, 
+            [&](size_t n, auto body) { pool.ForEach(n, body); });
+    }
+
+    // A placed mesh to convert, holding its geometry so that the lazy cache cannot release it meanwhile
+    struct SpeckleMeshSource
+    {
+        int32_t node;
+        IfcGeometry* geometry;
+        std::shared_ptr<IfcGeometry> owner;
+        std::array<double, 16> transform;
+        Color color;
+    };
+
+    // Writes the model as Speckle objects, as newline-delimited JSON: a root object whose elements are the
+    // projects, followed by their spatial tree through aggregation and containment. Elements with geometry 
+    // that are not in the tree are added to the root. Each element has its placed meshes as detached 
+    // displayValue meshes, and its property sets as dictionaries.
+    // An object's ID depends on those of its children, so meshes are built first, in parallel a slice at a time,
+    // then elements one tree level at a time, deepest first. Returns the number of objects written, or -1.
+    int64_t ExportSpeckle(const SpeckleOptions& options, const std::function<std::string(uint32_t)>& typeName,
+        std::function<bool(const void*, size_t)> sink, std::string& rootId)
+    {
+        auto loader = GetLoader();
+        auto& relations = GetRelationIndex();
+        auto properties = options.includeProperties ? &GetPropertyTable() : nullptr;
+        WorkStealingPool pool(ResolveNumThreads(options.numThreads));
+        SpeckleChunkWriter out(std::move(sink), (size_t)std::max<int64_t>(options.chunkBytes, 1));
+
+        // The tree in breadth-first order, with the parent of each node, or -1 for children of the root
+        auto maxId = loader->GetMaxExpressId();
+        std::vector<uint8_t> visited((size_t)maxId + 1, 0);
+        std::vector<uint32_t> nodes;
+        std::vector<int32_t> parents;
+        std::vector<int32_t> depths;
+        auto addNode = [&](uint32_t id, int32_t parent)
+        {
+            if (id > maxId || visited[id])
+                return;
+            visited[id] = 1;
+            nodes.push_back(id);
+            parents.push_back(parent);
+            depths.push_back(parent < 0 ? 1 : depths[parent] + 1);
+        };
+        size_t next = 0;
+        auto expand = [&]()
+        {
+            for (; next < nodes.size(); ++next)
+            {
+                auto id = nodes[next];
+                auto ids = relations.forward.Ids(id);
+                auto rels = relations.forward.Relations(id);
+                for (uint32_t k = 0; k < relations.forward.Count(id); ++k)
+                {
+                    auto type = relations.relationTypes[rels[k]];
+                    if (type == IFCRELAGGREGATES || type == IFCRELCONTAINEDINSPATIALSTRUCTURE)
+                        addNode(ids[k], (int32_t)next);
+                }
+            }
+        };
+        for (auto id : loader->GetExpressIDsWithType(IFCPROJECT))
+            addNode(id, -1);
+        expand();
+        for (auto eId : elementIds)
+            addNode(eId, -1);
+        expand();
+
+        std::vector<std::vector<int32_t>> children(nodes.size());
+        std::vector<int32_t> rootChildren;
+        for (size_t n = 0; n < nodes.size(); ++n)
+            (parents[n] < 0 ? rootChildren : children[parents[n]]).push_back((int32_t)n);
+
+        // The loader and the schema are not thread-safe, so lines and type names are read up front
+        LineTable lines;
+        lines.Decode(loader, nodes);
+        std::unordered_map<uint32_t, std::string> typeNames;
+        std::vector<const std::string*> nodeTypes(nodes.size());
+        for (size_t n = 0; n < nodes.size(); ++n)
+        {
+            auto type = lines.lineTypes[n];
+            auto it = typeNames.find(type);
+            if (it == typeNames.end())
+                it = typeNames.insert({ type, typeName(type) }).first;
+            nodeTypes[n] = &it->second;
+        }
+
+        // Property rows of each express ID, in CSR form
+        std::vector<uint32_t> rowOffsets;
+        std::vector<uint32_t> rows;
+        if (properties)
+        {
+            rowOffsets.assign((size_t)maxId + 2, 0);
+            for (auto e : properties->elementIds)
+                rowOffsets[(size_t)e + 1]++;
+            for (size_t i = 1; i < rowOffsets.size(); ++i)
+                rowOffsets[i] += rowOffsets[i - 1];
+            rows.resize(properties->NumRows());
+            std::vector<uint32_t> fill(rowOffsets.begin(), rowOffsets.end() - 1);
+            for (size_t r = 0; r < properties->NumRows(); ++r)
+                rows[fill[properties->elementIds[r]]++] = (uint32_t)r;
+        }
+
+        std::vector<std::vector<SpeckleRef>> displayValues(nodes.size());
+        if (options.includeGeometry)
+        {
+            const size_t SliceVertices = 1 << 20;
+            std::vector<SpeckleMeshSource> slice;
+            size_t sliceVertices = 0;
+            auto writeSlice = [&]()
+            {
+                std::vector<std::vector<SpeckleObject>> built(slice.size());
+                pool.ForEach(slice.size(), [&](size_t, size_t i)
+                {
+                    BuildSpeckleMesh(slice[i], built[i]);
+                });
+                for (size_t i = 0; i < slice.size(); ++i)
+                {
+                    for (auto& o : built[i])
+                        out.Write(o);
+                    displayValues[slice[i].node].push_back(std::move(built[i].back().ref));
+                }
+                slice.clear();
+                sliceVertices = 0;
+            };
+            for (size_t n = 0; n < nodes.size(); ++n)
+            {
+                auto g = GetGeometry(nodes[n]);
+                if (!g)
+                    continue;
+                for (auto m : g->meshes)
+                {
+                    if (m->geometry->vertexData.empty() || m->geometry->indexData.empty())
+                        continue;
+                    slice.push_back({ (int32_t)n, m->geometry, m->ownedGeometry, m->transform, m->color });
+                    sliceVertices += m->geometry->vertexData.size() / 6;
+                }
+                if (sliceVertices >= SliceVertices)
+                    writeSlice();
+            }
+            writeSlice();
+        }
+
+        std::vector<SpeckleRef> refs(nodes.size());
+        auto maxDepth = depths.empty() ? 0 : *std::max_element(depths.begin(), depths.end());
+        std::vector<std::vector<int32_t>> levels((size_t)maxDepth + 1);
+        for (size_t n = 0; n < nodes.size(); ++n)
+            levels[depths[n]].push_back((int32_t)n);
+        for (auto d = maxDepth; d >= 1; --d)
+        {
+            auto& level = levels[d];
+            std::vector<SpeckleObject> built(level.size());
+            pool.ForEach(level.size(), [&](size_t, size_t i)
+            {
+                auto n = level[i];
+                auto& o = built[i];
+                o.String("speckle_type", *nodeTypes[n]);
+                o.String("ifc_type", *nodeTypes[n]);
+                o.Integer("expressID", nodes[n]);
+                for (auto arg : { 0, 2 })
+                {
+                    auto v = lines.ArgumentIndex(n, arg);
+                    if (v < lines.lineOffsets[n + 1] && lines.tags[v] == LineValueString)
+                        o.String(arg == 0 ? "GlobalId" : "Name", lines.GetString(lines.values[v]));
+                }
+                std::vector<const SpeckleRef*> items;
+                for (auto& m : displayValues[n])
+                    items.push_back(&m);
+                if (!items.empty())
+                    o.References("displayValue", items);
+                items.clear();
+                for (auto c : children[n])
+                    items.push_back(&refs[c]);
+                o.References("elements", items);
+                if (properties)
+                    AddSpeckleProperties(o, *properties, rows.data() + rowOffsets[nodes[n]], 
+                        rowOffsets[nodes[n] + 1] - rowOffsets[nodes[n]]);
+                o.Finish();
+            });
+            for (size_t i = 0; i < level.size(); ++i)
+            {
+                out.Write(built[i]);
+                refs[level[i]] = std::move(built[i].ref);
+                displayValues[level[i]] = {};
+            }
+
+            // The closures of the level below were only needed by this one
+            if (d < maxDepth)
+                for (auto n : levels[d + 1])
+                    refs[n].closure = {};
+        }
+
+        SpeckleObject root;
+        root.String("speckle_type", "Base");
+        root.String("Name", "Root");
+        std::vector<const SpeckleRef*> items;
+        for (auto c : rootChildren)
+            items.push_back(&refs[c]);
+        root.References("elements", items);
+        root.Finish();
+        out.Write(root);
+        out.Flush();
+        rootId = root.ref.id;
+        return out.ok ? out.numObjects : -1;
+    }
+
+    // Builds the DataChunks of a mesh followed by the mesh, as in Objects.Geometry.Mesh.
+    // Vertices are in world space, converted to the Z up axes of Speckle from the Y up axes of the engine.
+    static void BuildSpeckleMesh(const SpeckleMeshSource& s, std::vector<SpeckleObject>& objects)
+    {
+        VertexEncoder encoder(s.transform.data(), 0, 0, 0);
+        auto& vd = s.geometry->vertexData;
+        auto& id = s.geometry->indexData;
+        std::vector<double> vertices(vd.size() / 2);
+        double p[3], nrm[3];
+        for (size_t v = 0; v < vd.size() / 6; ++v)
+        {
+            encoder.Transform(vd.data() + v * 6, p, nrm);
+            vertices[v * 3] = p[0];
+            vertices[v * 3 + 1] = -p[2];
+            vertices[v * 3 + 2] = p[1];
+        }
+        std::vector<uint32_t> faces;
+        faces.reserve(id.size() / 3 * 4);
+        for (size_t i = 0; i + 2 < id.size(); i += 3)
+            faces.insert(faces.end(), { 3, id[i], id[i + 1], id[i + 2] });
+
+        auto channel = [](double c) { return (uint32_t)std::clamp(c * 255, 0.0, 255.0); };
+        SpeckleObject material;
+        material.String("speckle_type", "Objects.Other.RenderMaterial");
+        material.Integer("diffuse", (int32_t)(channel(s.color.A) << 24 | channel(s.color.R) << 16 
+            | channel(s.color.G) << 8 | channel(s.color.B)));
+        material.Number("opacity", s.color.A);
+        material.Integer("emissive", (int32_t)0xFF000000);
+        material.Number("metalness", 0);
+        material.Number("roughness", 1);
+        material.Finish();
+
+        SpeckleObject mesh;
+        mesh.String("speckle_type", "Objects.Geometry.Mesh");
+        mesh.String("units", "m");
+        mesh.Chunks("vertices", vertices.data(), vertices.size(), 31250, objects);
+        mesh.Chunks("faces", faces.data(), faces.size(), 62500, objects);
+        mesh.Inline("renderMaterial", material);
+        mesh.Finish();
+        objects.push_back(std::move(mesh));
+    }
+
+    // Adds each property set of an element as a dictionary of property values. The rows of a property set
+    // are consecutive, and so are the values of a list property. Properties of complex properties are named
+    // "Complex_Property". Names that repeat, or clash with the members of the element, are skipped.
+    static void AddSpeckleProperties(SpeckleObject& o, const PropertyTable& t, const uint32_t* rows, size_t numRows)
+    {
+        static const std::unordered_set<std::string> reserved = { "id", "speckle_type", "ifc_type", "expressID", 
+            "GlobalId", "Name", "displayValue", "elements", "applicationId", "totalChildrenCount", "__closure" };
+        auto stringOf = [&](uint32_t s) { return s == PropertyTable::NoString ? std::string_view() : t.lines.GetString(s); };
+
+        std::vector<std::string> setNames;
+        for (size_t i = 0; i < numRows;)
+        {
+            auto end = i + 1;
+            while (end < numRows && t.propertySetIds[rows[end]] == t.propertySetIds[rows[i]])
+                ++end;
+            auto setName = SpeckleJson::Key(stringOf(t.propertySetNameIds[rows[i]]));
+            if (reserved.count(setName) || std::find(setNames.begin(), setNames.end(), setName) != setNames.end())
+            {
+                i = end;
+                continue;
+            }
+            setNames.push_back(setName);
+
+            o.Key(setName);
+            o.json += '{';
+            std::vector<std::string> keys;
+            for (auto j = i; j < end;)
+            {
+                auto r = rows[j];
+                auto last = j + 1;
+                while (last < end && t.propertyIds[rows[last]] == t.propertyIds[r] && t.valueIndices[rows[last]] > 0)
+                    ++last;
+                auto name = std::string(stringOf(t.propertyNameIds[r]));
+                if (t.complexNameIds[r] != PropertyTable::NoString)
+                    name = std::string(stringOf(t.complexNameIds[r])) + "." + name;
+                auto key = SpeckleJson::Key(name);
+                if (std::find(keys.begin(), keys.end(), key) == keys.end())
+                {
+                    if (!keys.empty())
+                        o.json += ',';
+                    keys.push_back(key);
+                    SpeckleJson::String(o.json, key);
+                    o.json += ':';
+                    if (last - j > 1)
+                        o.json += '[';
+                    for (auto k = j; k < last; ++k)
+                    {
+                        if (k > j)
+                            o.json += ',';
+                        WriteSpecklePropertyValue(o.json, t, rows[k]);
+                    }
+                    if (last - j > 1)
+                        o.json += ']';
+                }
+                j = last;
+            }
+            o.json += '}';
+            i = end;
+        }
+    }
+
+    static void WriteSpecklePropertyValue(std::string& json, const PropertyTable& t, uint32_t r)
+    {
+        switch (t.valueKinds[r])
+        {
+        case PropertyValueInteger:
+        case PropertyValueRef:
+            SpeckleJson::Integer(json, t.intValues[r]);
+            break;
+        case PropertyValueReal:
+            SpeckleJson::Number(json, t.realValues[r]);
+            break;
+        case PropertyValueString:
+        case PropertyValueEnum:
+            SpeckleJson::String(json, t.lines.GetString((size_t)t.intValues[r]));
+            break;
+        default:
+            json += "null";
+            break;
+        }
+    }
+
+    GlobalIdTable& GetGlobalIdTable()
+    {
+        if (!globalIdTable)
+        {
+            auto table = std::make_unique<GlobalIdTable>();
+            table->Build(GetLoader());
+            globalIdTable = std::move(table);
+        }
+        return *globalIdTable;
+    }
+
+    ElementFingerprints& GetFingerprints()
+    {
+        if (!fingerprints)
+        {
+            auto table = std::make_unique<ElementFingerprints>();
+            table->Build(GetLoader(), elementIds, GeometryAttachmentKinds());
+            fingerprints = std::move(table);
+        }
+        return *fingerprints;
+    }
+
+    // Matches the elements with those of a previous revision by GlobalId, and fills in the change set.
+    // A change of units or representation contexts modifies every element, since it changes their tessellation.
+    // When reuse is true, unchanged elements that were not skipped in the previous revision are added to reused,
+    // as pairs of express IDs in this revision and the previous one. Every other element is added to extract.
+    void CompareWith(::Model& previous, bool reuse, std::vector<std::pair<uint32_t, uint32_t>>& reused, std::vector<uint32_t>& extract)
+    {
+        auto& prints = GetFingerprints();
+        auto& previousPrints = previous.GetFingerprints();
+        auto& guids = GetGlobalIdTable();
+        auto& previousGuids = previous.GetGlobalIdTable();
+        auto sameContext = prints.contextHash == previousPrints.contextHash;
+
+        std::vector<bool> matched(previousPrints.Size());
+        for (auto eId : elementIds)
+        {
+            auto guid = guids.FindGuid(eId);
+            auto index = guid ? previousPrints.IndexOf(previousGuids.FindExpressId(*guid)) : -1;
+            if (index < 0)
+            {
+                changes.added.push_back(eId);
+                extract.push_back(eId);
+                continue;
+            }
+            matched[index] = true;
+            auto previousId = previousPrints.elementIds[index];
+            if (!sameContext || prints.elementHashes[prints.IndexOf(eId)] != previousPrints.elementHashes[index])
+            {
+                changes.modified.push_back(eId);
+                changes.modifiedPrevious.push_back(previousId);
+                extract.push_back(eId);
+                continue;
+            }
+            changes.numUnchanged++;
+            if (reuse && !previous.skipped.Contains(previousId))
+                reused.push_back({ eId, previousId });
+            else
+                extract.push_back(eId);
+        }
+        for (size_t i = 0; i < matched.size(); ++i)
+            if (!matched[i])
+                changes.removed.push_back(previousPrints.elementIds[i]);
+    }
+
+    // Gives each element the geometry of its counterpart in the previous revision, whose geometry IDs
+    // are mapped to the lines of this revision with the same content hash. Buffers owned by the previous 
+    // model are shared, and those held by its geometry processors are copied in parallel, so the previous 
+    // model can be unloaded. Elements with a geometry ID that cannot be mapped are added to extract instead.
+    // Returns the number of elements reused.
+    int64_t ReuseGeometries(::Model& previous, const std::vector<std::pair<uint32_t, uint32_t>>& reused, 
+        std::vector<uint32_t>& extract, WorkStealingPool& pool)
+    {
+        auto& prints = GetFingerprints();
+        auto& previousPrints = previous.GetFingerprints();
+
+        // The lowest express ID of this revision with the content hash of each geometry line of the previous one
+        std::unordered_map<uint64_t, uint32_t> idOfHash;
+        for (auto& r : reused)
+            if (auto g = previous.GetGeometry(r.second))
+                for (auto m : g->meshes)
+                    idOfHash.emplace(previousPrints.LineHash(m->id), 0);
+        idOfHash.erase(0);
+        for (size_t id = 0; id < prints.lineHashes.size() && !idOfHash.empty(); ++id)
+        {
+            if (prints.lineHashes[id] == 0)
+                continue;
+            auto it = idOfHash.find(prints.lineHashes[id]);
+            if (it != idOfHash.end() && it->second == 0)
+                it->second = (uint32_t)id;
+        }
+        auto mapId = [&](uint32_t previousId)
+        {
+            auto it = idOfHash.find(previousPrints.LineHash(previousId));
+            return it == idOfHash.end() ? 0 : it->second;
+        };
+
+        int64_t numReused = 0;
+        std::vector<std::pair<uint32_t, ::Geometry*>> sources;
+        std::unordered_map<const IfcGeometry*, std::shared_ptr<IfcGeometry>> copies;
+        for (auto& r : reused)
+        {
+            auto g = previous.GetGeometry(r.second);
+            if (!g)
+            {
+                // The element has no geometry in either revision
+                numReused++;
+                continue;
+            }
+            if (!std::all_of(g->meshes.begin(), g->meshes.end(), [&](Mesh* m) { return mapId(m->id) != 0; }))
+            {
+                extract.push_back(r.first);
+                continue;
+            }
+            numReused++;
+            sources.push_back({ r.first, g });
+            for (auto m : g->meshes)
+                if (!m->ownedGeometry)
+                    copies.emplace(m->geometry, nullptr);
+        }
+
+        std::vector<std::pair<const IfcGeometry* const, std::shared_ptr<IfcGeometry>>*> pending;
+        for (auto& c : copies)
+            pending.push_back(&c);
+        pool.ForEach(pending.size(), [&](size_t, size_t i)
+        {
+            auto copy = std::make_shared<IfcGeometry>();
+            copy->vertexData = pending[i]->first->vertexData;
+            copy->indexData = pending[i]->first->indexData;
+            pending[i]->second = std::move(copy);
+        });
+
+        for (auto& [eId, source] : sources)
+        {
+            auto g = arena.New<::Geometry>(eId, true);
+            for (auto m : source->meshes)
+            {
+                auto mesh = arena.New<Mesh>(mapId(m->id));
+                mesh->ownedGeometry = m->ownedGeometry ? m->ownedGeometry : copies[m->geometry];
+                mesh->geometry = mesh->ownedGeometry.get();
+                mesh->color = m->color;
+                mesh->transform = m->transform;
+                mesh->lods = m->lods;
+                mesh->bounds = m->bounds;
+                g->meshes.push_back(mesh);
+            }
+            g->bounds = source->bounds;
+            geometries[eId] = g;
+        }
+        for (auto& c : copies)
+            stats.bytesAllocated += (int64_t)(c.second->vertexData.size() * sizeof(double) + c.second->indexData.size() * sizeof(uint32_t));
+        return numReused;
+    }
+
+    RelationIndex& GetRelationIndex()
+    {
+        if (!relationIndex)
+        {
+            auto index = std::make_unique<RelationIndex>();
+            index->Build(GetLoader(), DefaultRelationKinds());
+            relationIndex = std::move(index);
+        }
+        return *relationIndex;
+    }
+
+    // Builds the hierarchy over the world-space bounds of every element with geometry.
+    // In lazy mode this tessellates every element that is not already cached.
+    SpatialIndex& GetSpatialIndex()
+    {
+        if (!spatialIndex)
+        {
+            std::vector<uint32_t> ids;
+            std::vector<Aabb> boxes;
+            for (auto eId : elementIds)
+            {
+                auto g = GetGeometry(eId);
+                if (!g)
+                    continue;
+                ids.push_back(eId);
+                boxes.push_back(g->bounds);
+            }
+            auto index = std::make_unique<SpatialIndex>();
+            index->Build(ids, boxes);
+            spatialIndex = std::move(index);
+        }
+        return *spatialIndex;
+    }
+
+    PropertyTable& GetPropertyTable()
+    {
+        if (!propertyTable)
+        {
+            auto& relations = GetRelationIndex();
+            auto table = std::make_unique<PropertyTable>();
+            WorkStealingPool pool(numThreads);
+            table->Build(GetLoader(), relations, [&](size_t n, auto body) { pool.ForEach(n, body); });
+            propertyTable = std::move(table);
+        }
+        return *propertyTable;
+    }
+
+    InstanceCounts GetInstanceCounts(bool dedupByContent)
+    {
+        auto& t = GetInstanceTable(dedupByContent);
+        return { (int64_t)t.geometries.size(), (int64_t)t.instances.size(), t.numVertices, t.numIndices };
+    }
+
+    int64_t ExportInstances(bool dedupByContent, const VertexEncoding& encoding, InstanceBuffers& b)
+    {
+        auto& t = GetInstanceTable(dedupByContent);
+
+        std::vector<int64_t> vertexOffsets(t.geometries.size());
+        std::vector<int64_t> indexOffsets(t.geometries.size());
+        int64_t vertexOffset = 0;
+        int64_t indexOffset = 0;
+        for (size_t i = 0; i < t.geometries.size(); ++i)
+        {
+            vertexOffsets[i] = vertexOffset;
+            indexOffsets[i] = indexOffset;
+            vertexOffset += t.geometries[i].geometry->vertexData.size() / 6;
+            indexOffset += t.geometries[i].geometry->indexData.size();
+        }
+
+        auto stride = VertexStride(encoding.format);
+        WorkStealingPool pool(numThreads);
+        pool.ForEach(t.geometries.size(), [&](size_t, size_t i)
+        {
+            auto& g = t.geometries[i];
+            auto& id = g.geometry->indexData;
+            if (b.vertices || b.bounds)
+            {
+                auto dst = b.vertices ? static_cast<uint8_t*>(b.vertices) + vertexOffsets[i] * stride : nullptr;
+                EncodeVertices(*g.geometry, nullptr, encoding, dst, b.bounds ? b.bounds + i * 6 : nullptr);
+            }
+            if (b.indices)
+                std::copy(id.begin(), id.end(), b.indices + indexOffsets[i]);
+            if (b.geometryIds)
+                b.geometryIds[i] = g.id;
+            if (b.geometryHashes)
+                b.geometryHashes[i] = g.hash;
+            if (b.vertexOffsets)
+                b.vertexOffsets[i] = vertexOffsets[i];
+            if (b.vertexCounts)
+                b.vertexCounts[i] = (int32_t)(g.geometry->vertexData.size() / 6);
+            if (b.indexOffsets)
+                b.indexOffsets[i] = indexOffsets[i];
+            if (b.indexCounts)
+                b.indexCounts[i] = (int32_t)id.size();
+        });
+
+        for (size_t i = 0; i < t.instances.size(); ++i)
+        {
+            auto& inst = t.instances[i];
+            if (b.elementIds)
+                b.elementIds[i] = inst.elementId;
+            if (b.geometryIndices)
+                b.geometryIndices[i] = inst.geometryIndex;
+            if (b.transforms)
+                std::copy(inst.transform.begin(), inst.transform.end(), b.transforms + i * 16);
+            if (b.colors)
+                std::copy(&inst.color.R, &inst.color.R + 4, b.colors + i * 4);
+        }
+        return (int64_t)t.instances.size();
+    }
+
+    Mesh* ToMesh(IfcGeometryProcessor* processor, IfcPlacedGeometry& pg, Arena* arena = nullptr) 
+    {
+        auto r = arena ? arena->New<Mesh>(pg.geometryExpressID) : new Mesh(pg.geometryExpressID);
+        r->color = Color(pg.color.r, pg.color.g, pg.color.b, pg.color.a);
+        r->geometry = &(processor->GetGeometry(pg.geometryExpressID));
+        r->transform = pg.flatTransformation;
+        r->UpdateBounds();
+        return r;
+    }
+};
+
+// Persistent on-disk cache of the tessellated geometry of a model.
+// A cache file is keyed by the content hash of the source, the engine version, and the loader 
+// settings that affect tessellation. It holds a header followed by fixed-size records and flat arrays, 
+// all 8-byte aligned, so the records are read in place from a memory mapping. The vertex and index arrays
+// are copied into the meshes' buffers, because IfcGeometry owns its vectors, so the mapping is not kept open.
+// The engine's token stream is private to the loader, so it is not cached. Instead a warm load 
+// defers parsing until something other than geometry is requested.
+struct GeometryCacheFile
+{
+    static constexpr uint32_t FormatVersion = 1;
+
+    struct Header
+    {
+        char magic[8];
+        uint32_t formatVersion;
+        uint32_t reserved;
+        char engineVersion[32];
+        uint64_t key;
+        uint64_t sourceSize;
+        uint64_t numElements;
+        uint64_t numMeshes;
+        uint64_t numGeometries;
+        uint64_t numVertexValues;
+        uint64_t numIndices;
+    };
+
+    struct ElementRecord
+    {
+        uint32_t expressId;
+        uint32_t numMeshes;
+        uint64_t firstMesh;
+    };
+
+    struct MeshRecord
+    {
+        uint32_t geometryIndex;
+        uint32_t geometryId;
+        double transform[16];
+        double color[4];
+    };
+
+    struct GeometryRecord
+    {
+        uint64_t vertexOffset;
+        uint64_t vertexCount;
+        uint64_t indexOffset;
+        uint64_t indexCount;
+    };
+
+    static void InitHeader(Header& h)
+    {
+        h = {};
+        std::memcpy(h.magic, "WIFCGEO", 8);
+        h.formatVersion = FormatVersion;
+        std::strncpy(h.engineVersion, WEB_IFC_VERSION_NUMBER.c_str(), sizeof(h.engineVersion) - 1);
+    }
+
+    // Hashes the source in parallel chunks, together with everything else that affects the output.
+    // Files are only written when no element was skipped, so of the element budgets only the triangle budget,
+    // which is deterministic, is part of the key.
+    static uint64_t ComputeKey(const char* data, size_t size, const LoaderSettings& settings, const ElementBudget& budget, 
+        const ElementFilter& filter, size_t numThreads)
+    {
+        const size_t chunkSize = 16 * 1024 * 1024;
+        std::vector<uint64_t> chunkHashes((size + chunkSize - 1) / chunkSize);
+        WorkStealingPool pool(numThreads);
+        pool.ForEach(chunkHashes.size(), [&](size_t, size_t i)
+        {
+            auto begin = i * chunkSize;
+            chunkHashes[i] = Hasher64().Add(data + begin, std::min(chunkSize, size - begin)).Digest();
+        });
+        return Hasher64()
+            .Add(chunkHashes)
+            .Add((uint64_t)size)
+            .Add(WEB_IFC_VERSION_NUMBER)
+            .Add((uint64_t)FormatVersion)
+            .Add((uint64_t)settings.CIRCLE_SEGMENTS)
+            .Add((uint64_t)settings.COORDINATE_TO_ORIGIN)
+            .Add((uint64_t)budget.triangles)
+            .Add(filter.Hash())
+            .Digest();
+    }
+
+    static std::filesystem::path PathFor(const char* directory, uint64_t key)
+    {
+        char name[32];
+        std::snprintf(name, sizeof(name), "%016llx.wgc", (unsigned long long)key);
+        return std::filesystem::path(reinterpret_cast<const char8_t*>(directory)) / name;
+    }
+
+    // Writes the cache to a temporary file, then renames it, so readers never see a partial file.
+    // Failures are ignored: the cache is only an optimization.
+    static void Write(Model& model, const std::filesystem::path& path, uint64_t key, uint64_t sourceSize)
+    {
+        Header h;
+        InitHeader(h);
+        h.key = key;
+        h.sourceSize = sourceSize;
+
+        std::vector<ElementRecord> elements;
+        std::vector<MeshRecord> meshes;
+        std::vector<GeometryRecord> geometryRecords;
+        std::vector<const IfcGeometry*> geometries;
+        std::unordered_map<const IfcGeometry*, uint32_t> geometryIndices;
+
+        for (auto eId : model.elementIds)
+        {
+            auto g = model.GetGeometry(eId);
+            elements.push_back({ eId, g ? (uint32_t)g->meshes.size() : 0, meshes.size() });
+            if (!g)
+                continue;
+            for (auto m : g->meshes)
+            {
+                auto it = geometryIndices.find(m->geometry);
+                if (it == geometryIndices.end())
+                {
+                    it = geometryIndices.emplace(m->geometry, (uint32_t)geometries.size()).first;
+                    geometryRecords.push_back({ h.numVertexValues, m->geometry->vertexData.size(), h.numIndices, m->geometry->indexData.size() });
+                    h.numVertexValues += m->geometry->vertexData.size();
+                    h.numIndices += m->geometry->indexData.size();
+                    geometries.push_back(m->geometry);
+                }
+                MeshRecord r = { it->second, m->id };
+                std::copy(m->transform.begin(), m->transform.end(), r.transform);
+                std::copy(&m->color.R, &m->color.R + 4, r.color);
+                meshes.push_back(r);
+            }
+        }
+        h.numElements = elements.size();
+        h.numMeshes = meshes.size();
+        h.numGeometries = geometries.size();
+
+        std::error_code ec;
+        std::filesystem::create_directories(path.parent_path(), ec);
+        // Concurrent loads of the same file may write the same cache file, so each writes its own temporary file
+        auto tmpPath = path;
+        tmpPath += "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+        {
+            std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+            if (!out)
+                return;
+            out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+            out.write(reinterpret_cast<const char*>(elements.data()), elements.size() * sizeof(ElementRecord));
+            out.write(reinterpret_cast<const char*>(meshes.data()), meshes.size() * sizeof(MeshRecord));
+            out.write(reinterpret_cast<const char*>(geometryRecords.data()), geometryRecords.size() * sizeof(GeometryRecord));
+            for (auto g : geometries)
+                out.write(reinterpret_cast<const char*>(g->vertexData.data()), g->vertexData.size() * sizeof(double));
+            for (auto g : geometries)
+                out.write(reinterpret_cast<const char*>(g->indexData.data()), g->indexData.size() * sizeof(uint32_t));
+            if (!out)
+            {
+                out.close();
+                std::filesystem::remove(tmpPath, ec);
+                return;
+            }
+        }
+        std::filesystem::rename(tmpPath, path, ec);
+        if (ec)
+            std::filesystem::remove(tmpPath, ec);
+    }
+
+    // Fills the model's elements and geometries from a cache file, copying the vertex and index arrays out of it. 
+    // Returns false, leaving the model untouched, if the file is invalid or does not match the key.
+    static bool Read(Model& model, const MappedFile& file, uint64_t key, uint64_t sourceSize)
+    {
+        Header expected;
+        InitHeader(expected);
+        if (file.Size() < sizeof(Header))
+            return false;
+        Header h;
+        std::memcpy(&h, file.Data(), sizeof(h));
+        if (std::memcmp(h.magic, expected.magic, sizeof(h.magic)) != 0
+            || h.formatVersion != FormatVersion
+            || std::memcmp(h.engineVersion, expected.engineVersion, sizeof(h.engineVersion)) != 0
+            || h.key != key
+            || h.sourceSize != sourceSize)
+            return false;
+
+        // Counts are checked against the file size first, so that the expected size cannot overflow
+        auto available = file.Size() - sizeof(Header);
+        if (h.numElements > available / sizeof(ElementRecord)
+            || h.numMeshes > available / sizeof(MeshRecord)
+            || h.numGeometries > available / sizeof(GeometryRecord)
+            || h.numVertexValues > available / sizeof(double)
+            || h.numIndices > available / sizeof(uint32_t))
+            return false;
+        auto expectedSize = sizeof(Header)
+            + h.numElements * sizeof(ElementRecord)
+            + h.numMeshes * sizeof(MeshRecord)
+            + h.numGeometries * sizeof(GeometryRecord)
+            + h.numVertexValues * sizeof(double)
+            + h.numIndices * sizeof(uint32_t);
+        if (file.Size() != expectedSize)
+            return false;
+
+        auto p = file.Data() + sizeof(Header);
+        auto elements = reinterpret_cast<const ElementRecord*>(p);
+        p += h.numElements * sizeof(ElementRecord);
+        auto meshes = reinterpret_cast<const MeshRecord*>(p);
+        p += h.numMeshes * sizeof(MeshRecord);
+        auto geometryRecords = reinterpret_cast<const GeometryRecord*>(p);
+        p += h.numGeometries * sizeof(GeometryRecord);
+        auto vertices = reinterpret_cast<const double*>(p);
+        p += h.numVertexValues * sizeof(double);
+        auto indices = reinterpret_cast<const uint32_t*>(p);
+
+        std::vector<std::shared_ptr<IfcGeometry>> geometries(h.numGeometries);
+        for (size_t i = 0; i < h.numGeometries; ++i)
+        {
+            auto& r = geometryRecords[i];
+            if (r.vertexOffset > h.numVertexValues || r.vertexCount > h.numVertexValues - r.vertexOffset
+                || r.indexOffset > h.numIndices || r.indexCount > h.numIndices - r.indexOffset)
+                return false;
+            geometries[i] = std::make_shared<IfcGeometry>();
+            geometries[i]->vertexData.assign(vertices + r.vertexOffset, vertices + r.vertexOffset + r.vertexCount);
+            geometries[i]->indexData.assign(indices + r.indexOffset, indices + r.indexOffset + r.indexCount);
+        }
+
+        for (size_t i = 0; i < h.numElements; ++i)
+        {
+            auto& e = elements[i];
+            if (e.firstMesh > h.numMeshes || e.numMeshes > h.numMeshes - e.firstMesh)
+                return false;
+            for (size_t j = 0; j < e.numMeshes; ++j)
+                if (meshes[e.firstMesh + j].geometryIndex >= h.numGeometries)
+                    return false;
+        }
+
+        std::vector<uint32_t> elementIds;
+        for (size_t i = 0; i < h.numElements; ++i)
+        {
+            auto& e = elements[i];
+            auto g = model.arena.New<::Geometry>(e.expressId, true);
+            for (size_t j = 0; j < e.numMeshes; ++j)
+            {
+                auto& r = meshes[e.firstMesh + j];
+                auto m = model.arena.New<Mesh>(r.geometryId);
+                m->ownedGeometry = geometries[r.geometryIndex];
+                m->geometry = m->ownedGeometry.get();
+                std::copy(r.transform, r.transform + 16, m->transform.begin());
+                m->color = Color(r.color[0], r.color[1], r.color[2], r.color[3]);
+                m->UpdateBounds();
+                g->meshes.push_back(m);
+            }
+            g->UpdateBounds();
+            elementIds.push_back(e.expressId);
+            model.geometries[e.expressId] = g;
+        }
+
+        model.elementIds = std::move(elementIds);
+        return true;
+    }
+};
+
+// Delivers the geometry of each element of a model to a consumer as soon as it is ready.
+// Elements are tessellated on background threads and handed over through a bounded queue, 
+// so tessellation overlaps with whatever the consumer does, and at most the queue capacity 
+// plus one element per thread is held in memory. 
+// For a lazy model the stream tessellates every element itself, and frees each geometry when the 
+// consumer asks for the next one. Otherwise it hands out the geometries extracted during load. 
+// The model must not be otherwise used while a stream is open.
+// With StreamGeometry, the callback runs on the calling thread and returns 0 to stop early.
+// EndGeometryStream and StreamGeometry return -1 if tessellation failed.
+struct GeometryStream
+{
+    ::Model* model;
+    bool owned;
+    BoundedQueue<::Geometry*> queue;
+    std::atomic<bool> cancelled;
+    std::thread producer;
+    std::exception_ptr error;
+    ::Geometry* current = nullptr;
+
+    GeometryStream(::Model* model, size_t capacity)
+        : model(model), owned(model->lazy), queue(capacity), cancelled(false)
+    { }
+
+    ~GeometryStream()
+    {
+        Stop();
+        ReleaseCurrent();
+        ::Geometry* g;
+        while (queue.Pop(g))
+            if (owned)
+                delete g;
+    }
+
+    void Start(std::vector<IfcGeometryProcessor*> processors, size_t processorBudget)
+    {
+        producer = std::thread([this, processors, processorBudget]()
+        {
+            try
+            {
+                if (owned)
+                    Produce(processors, processorBudget);
+                else
+                    for (auto eId : model->elementIds)
+                        if (auto g = model->GetGeometry(eId))
+                            if (!queue.Push(g))
+                                break;
+            }
+            catch (...)
+            {
+                error = std::current_exception();
+            }
+            queue.Close();
+        });
+    }
+
+    // Returns the next geometry, or null once all elements have been delivered. 
+    // The geometry remains valid until the next call.
+    ::Geometry* Next()
+    {
+        ReleaseCurrent();
+        ::Geometry* g = nullptr;
+        if (queue.Pop(g))
+            current = g;
+        return current;
+    }
+
+    // Stops the background threads, and returns true if they did not fail
+    bool Stop()
+    {
+        cancelled = true;
+        queue.Close();
+        if (producer.joinable())
+            producer.join();
+        return !error;
+    }
+
+private:
+
+    void Produce(const std::vector<IfcGeometryProcessor*>& processors, size_t processorBudget)
+    {
+        std::vector<size_t> bytesSinceClear(processors.size(), 0);
+        WorkStealingPool pool(processors.size());
+        pool.ForEach(model->elementIds.size(), [&](size_t worker, size_t i)
+        {
+            if (cancelled || model->skipped.Contains(model->elementIds[i]))
+                return;
+            auto g = std::unique_ptr<::Geometry>(model->ExtractOwnedElement(processors[worker], model->elementIds[i]));
+            if (!g)
+                return;
+            bytesSinceClear[worker] += g->OwnedBytes();
+            if (processorBudget != 0 && bytesSinceClear[worker] > processorBudget)
+            {
+                processors[worker]->Clear();
+                bytesSinceClear[worker] = 0;
+            }
+            if (queue.Push(g.get()))
+                g.release();
+            else
+                cancelled = true;
+        });
+    }
+
+    void ReleaseCurrent()
+    {
+        if (owned)
+            delete current;
+        current = nullptr;
+    }
+};
+
+// The schema tables are immutable once built, so one instance is shared by every Api in the process
+inline IfcSchemaManager* SharedSchemaManager()
+{
+    static IfcSchemaManager schemaManager;
+    return &schemaManager;
+}
+
+// Different models may be loaded, queried and unloaded from any number of threads at once, 
+// as long as each model is used by one thread at a time. 
+// The engine's model manager is not thread-safe, so every call to it is made while holding the mutex. 
+// The loaders and geometry processors it hands out belong to a single model, and are used without the lock.
+// Loads started with BeginLoadModel run on a job queue, and each must be ended before FinalizeApi.
+struct Api 
+{
+    ModelManager* manager;
+    IfcSchemaManager* schemaManager;
+    LoaderSettings* settings;
+    std::unordered_set<::Model*> models;
+
+    // Guards the model manager, the set of models and the creation of the job queue
+    std::mutex mutex;
+    size_t numWorkers;
+    std::unique_ptr<JobQueue> jobs;
+
+    // Approximate bytes per line of the engine's line index: the line record and its slot in the express ID table
+    static constexpr size_t LineIndexBytesPerLine = 16;
+
+    Api(const ApiOptions& options = ApiOptions()) 
+        : numWorkers(ResolveNumThreads(options.numWorkers))
+    {
+        schemaManager = SharedSchemaManager();
+        manager = new ModelManager(false);
+        manager->SetLogLevel(6); // Turns off logging
+        settings = new webifc::manager::LoaderSettings();
+    }   
+
+    // Waits for the queued load jobs, then unloads the remaining models
+    ~Api()
+    {
+        jobs.reset();
+        while (!models.empty())
+            UnloadModel(*models.begin());
+        delete manager;
+        delete settings;
+    }
+
+    JobQueue& Jobs()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!jobs)
+            jobs = std::make_unique<JobQueue>(numWorkers);
+        return *jobs;
+    }
+
+    // Queues the load of a model. The options, including the strings and arrays they point to, are copied.
+    // The file name is copied, but buffer data must remain valid until the model is no longer used.
+    LoadJob* BeginLoadModel(std::string fileName, const char* data, size_t size, const LoadOptions& options)
+    {
+        auto owned = std::make_shared<OwnedLoadOptions>(options);
+        auto job = new LoadJob();
+        job->result = Jobs().Submit([this, fileName, data, size, owned]()
+        {
+            return data ? LoadModel(data, size, owned->options) : LoadModel(fileName.c_str(), owned->options);
+        });
+        return job;
+    }
+
+    // Waits for the job to finish and releases it. Returns null if loading failed.
+    ::Model* EndLoadModel(LoadJob* job)
+    {
+        ::Model* model = nullptr;
+        try
+        {
+            model = job->result.get();
+        }
+        catch (...)
+        {
+        }
+        delete job;
+        return model;
+    }
+
+    // Creates an engine model, returning its loader and geometry processor
+    uint32_t CreateEngineModel(IfcLoader*& loader, IfcGeometryProcessor*& processor)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto modelId = manager->CreateModel(*settings);
+        loader = manager->GetIfcLoader(modelId);
+        processor = manager->GetGeometryProcessor(modelId);
+        return modelId;
+    }
+
+    // Maps the file into memory and loads from the mapped pages. 
+    // Returns null if the file cannot be opened.
+    Model* LoadModel(const char* fileName, const LoadOptions& options)
+    {
+        auto file = std::make_shared<MappedFile>();
+        if (!file->Open(fileName))
+            return nullptr;
+        auto model = LoadModel(file->Data(), file->Size(), options);
+        model->source = file;
+        return model;
+    }
+
+    // Creates an empty model over the given memory, with the budgets, filter and tracing of the options.
+    // It is not one of the open models until AddModel.
+    ::Model* NewModel(const char* data, size_t size, const LoadOptions& options)
+    {
+        IfcLoader* loader;
+        IfcGeometryProcessor* processor;
+        auto modelId = CreateEngineModel(loader, processor);
+        auto model = new ::Model(loader, processor, modelId);
+        model->sourceData = data;
+        model->sourceSize = size;
+        model->stats.EnableTracing(options.trace != 0);
+        model->budget.seconds = options.elementTimeBudgetSeconds;
+        model->budget.triangles = options.elementTriangleBudget;
+        model->numThreads = ResolveNumThreads(options.numThreads);
+        if (options.filter)
+            model->filter = options.filter->ToFilter();
+        return model;
+    }
 
-struct Mesh 
-{
-    IfcGeometry* geometry;
-    Color color;
-    uint32_t id;
-    std::array<double, 16> transform;
-    Mesh(uint32_t id) 
-        : geometry(nullptr), id(id), transform({}), color() 
-    { }
-};
+    // Runs the loading steps of a new model, then adds it to the open models.
+    // If a step throws, the model and its engine models are released before the exception propagates.
+    template<typename F>
+    ::Model* AddModel(::Model* model, F steps)
+    {
+        try
+        {
+            steps();
+        }
+        catch (...)
+        {
+            ReleaseModel(model);
+            throw;
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        models.insert(model);
+        return model;
+    }
 
-struct Geometry 
-{
-    uint32_t id;
-    IfcFlatMesh* flatMesh;
-    std::vector<Mesh*> meshes;    
-    Geometry(uint32_t id)
-        : id(id), flatMesh(nullptr) 
-    {}
-};
+    void ParseModel(::Model* model)
+    {
+        auto parseStart = model->stats.Now();
+        LoadFromMemory(model->loader, model->sourceData, model->sourceSize);
+        model->CollectElements(schemaManager);
+        model->parseSeconds = std::chrono::duration<double>(model->stats.Now() - parseStart).count();
+        model->stats.RecordPhase("parse", parseStart);
+    }
 
-// Model class, abstraction over the web-IFC engine concept of Model ID
-struct Model
-{
-    uint32_t id;
-    IfcLoader* loader;
-    IfcGeometryProcessor* geometryProcessor;
-    std::unordered_map<uint32_t, ::Geometry*> geometries;
+    // Loads a model from memory. The memory must remain valid until the model is no longer used.
+    Model* LoadModel(const char* data, size_t size, const LoadOptions& options)
+    {
+        auto model = NewModel(data, size, options);
+        return AddModel(model, [&]() { Load(model, data, size, options); });
+    }
 
-    Model(IfcSchemaManager* schemas, IfcLoader* loader, IfcGeometryProcessor* processor, uint32_t id)
-        : loader(loader), geometryProcessor(processor), id(id)
+    // The steps of LoadModel, on a model created by NewModel
+    void Load(::Model* model, const char* data, size_t size, const LoadOptions& options)
     {
-        for (auto type : schemas->GetIfcElementList())
+        auto loader = model->loader;
+
+        std::filesystem::path cachePath;
+        uint64_t cacheKey = 0;
+        if (options.cacheDirectory && !options.lazy)
         {
-            // TODO: maybe some of these elments are desired. In fact, I think there may be explicit requests for IFCSPACE?
-            if (type == IFCOPENINGELEMENT
-                || type == IFCSPACE
-                || type == IFCOPENINGSTANDARDCASE)
+            cacheKey = GeometryCacheFile::ComputeKey(data, size, *settings, model->budget, model->filter, model->numThreads);
+            cachePath = GeometryCacheFile::PathFor(options.cacheDirectory, cacheKey);
+            MappedFile cacheFile;
+            if (cacheFile.Open(cachePath.c_str()) && GeometryCacheFile::Read(*model, cacheFile, cacheKey, size))
             {
-                continue;
+                model->fromPersistentCache = true;
+                model->deferredLoad = [model, loader, data, size]() 
+                { 
+                    auto start = model->stats.Now();
+                    LoadFromMemory(loader, data, size); 
+                    model->parseSeconds = std::chrono::duration<double>(model->stats.Now() - start).count();
+                    model->stats.RecordPhase("parse", start);
+                };
+                return;
             }
+        }
+
+        ParseModel(model);
+
+        if (options.lazy)
+        {
+            model->EnableLazyExtraction(options.cacheBudgetBytes);
+            return;
+        }
+
+        ExtractGeometry(model, options, model->elementIds);
+
+        // The skip report is not cached, and time budgets make the result depend on the machine
+        if (!cachePath.empty() && model->skipped.Size() == 0)
+            GeometryCacheFile::Write(*model, cachePath, cacheKey, size);
+    }
+
+    // Loads a new revision of a model from a file, as ReloadModel from memory does.
+    // Returns null if the file cannot be opened.
+    Model* ReloadModel(::Model* previous, const char* fileName, const LoadOptions& options)
+    {
+        auto file = std::make_shared<MappedFile>();
+        if (!file->Open(fileName))
+            return nullptr;
+        auto model = ReloadModel(previous, file->Data(), file->Size(), options);
+        model->source = file;
+        return model;
+    }
+
+    // Loads a new revision of a previously loaded model, tessellating only its new and modified elements.
+    // Elements are matched by GlobalId and compared by content hash (see ElementFingerprints.h), and unchanged
+    // elements get the geometry of the previous revision, which remains independent of the new model.
+    // Both revisions are hashed at the same time. The previous model must not be used meanwhile.
+    // Geometry is not reused from a lazy model, nor when coordinates are moved to the origin, since the offset
+    // depends on the whole model. The new model is never lazy, and does not use the persistent cache.
+    Model* ReloadModel(::Model* previous, const char* data, size_t size, const LoadOptions& options)
+    {
+        auto model = NewModel(data, size, options);
+        return AddModel(model, [&]() { Reload(model, previous, options); });
+    }
+
+    // The steps of ReloadModel, on a model created by NewModel
+    void Reload(::Model* model, ::Model* previous, const LoadOptions& options)
+    {
+        ParseModel(model);
+
+        auto hashStart = model->stats.Now();
+        WorkStealingPool pool(ResolveNumThreads(options.numThreads));
+        std::array<::Model*, 2> revisions = { previous, model };
+        WorkStealingPool(2).ForEach(revisions.size(), [&](size_t, size_t i)
+        {
+            revisions[i]->GetFingerprints();
+            revisions[i]->GetGlobalIdTable();
+        });
+        std::vector<std::pair<uint32_t, uint32_t>> reused;
+        std::vector<uint32_t> extract;
+        model->CompareWith(*previous, !previous->lazy && !settings->COORDINATE_TO_ORIGIN, reused, extract);
+        model->changes.numReused = model->ReuseGeometries(*previous, reused, extract, pool);
+        model->changes.numTessellated = (int64_t)extract.size();
+        model->changes.hashSeconds = std::chrono::duration<double>(model->stats.Now() - hashStart).count();
+        model->stats.RecordPhase("hash", hashStart);
+
+        // Every worker after the first parses the whole file again, 
+        // which only pays off when there are enough elements to tessellate
+        const size_t minElementsPerWorker = 256;
+        auto extractOptions = options;
+        extractOptions.numThreads = (int32_t)std::min(pool.NumWorkers(), 1 + extract.size() / minElementsPerWorker);
+        ExtractGeometry(model, extractOptions, extract);
+    }
+
+    void ExtractGeometry(::Model* model, const LoadOptions& options, const std::vector<uint32_t>& ids)
+    {
+        auto start = model->stats.Now();
+        if (options.extractTimeBudgetSeconds > 0)
+            model->budget.deadline = start + std::chrono::duration_cast<ElementBudget::Clock::duration>(
+                std::chrono::duration<double>(options.extractTimeBudgetSeconds));
+        auto numThreads = ResolveNumThreads(options.numThreads);
+        if (numThreads > 1 && options.workerMemoryBudgetBytes > 0)
+            numThreads = (size_t)std::min<uint64_t>(numThreads, 1 + options.workerMemoryBudgetBytes / std::max<uint64_t>(1, ParsedBytes(model->loader)));
+        if (numThreads <= 1)
+        {
+            model->ExtractGeometry(ids);
+        }
+        else
+        {
+            WorkStealingPool pool(numThreads);
+            model->ExtractGeometry(ids, pool, GetWorkerProcessors(model, pool));
+            CloseWorkerModels(model);
+        }
+        model->budget.deadline = ElementBudget::Clock::time_point::max();
+        model->extractSeconds = std::chrono::duration<double>(model->stats.Now() - start).count();
+        model->stats.RecordPhase("extract", start);
+    }
+
+    // Approximate bytes held by one parsed copy of a file: its token stream and line index
+    static size_t ParsedBytes(IfcLoader* loader)
+    {
+        return loader->GetTotalSize() + ((size_t)loader->GetMaxExpressId() + 1) * LineIndexBytesPerLine;
+    }
 
-            for (auto eId : loader->GetExpressIDsWithType(type))
+    // Returns one geometry processor per worker of the pool, the first being the model's own.
+    // The geometry processor and loader are not thread-safe, so every worker gets its own copy 
+    // of the parsed file. Worker models are kept with the model until CloseWorkerModels, and reused. 
+    // New ones are parsed in parallel from the model's source memory.
+    std::vector<IfcGeometryProcessor*> GetWorkerProcessors(::Model* model, WorkStealingPool& pool)
+    {
+        std::vector<IfcGeometryProcessor*> processors = { model->geometryProcessor };
+        std::vector<IfcLoader*> newLoaders;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (size_t i = 1; i < pool.NumWorkers(); ++i)
             {
-                auto flatMesh = geometryProcessor->GetFlatMesh(eId);
-                auto g = new ::Geometry(eId);
-                for (auto& placedGeom : flatMesh.geometries)
+                if (i > model->workerModelIds.size())
                 {
-                    auto mesh = ToMesh(placedGeom);
-                    g->meshes.push_back(mesh);
+                    auto workerId = manager->CreateModel(*settings);
+                    model->workerModelIds.push_back(workerId);
+                    newLoaders.push_back(manager->GetIfcLoader(workerId));
                 }
-                geometries[eId] = g;
+                processors.push_back(manager->GetGeometryProcessor(model->workerModelIds[i - 1]));
             }
-        }        
+        }
+
+        pool.ForEach(newLoaders.size(), [&](size_t, size_t i)
+        {
+            LoadFromMemory(newLoaders[i], model->sourceData, model->sourceSize);
+        });
+        return processors;
     }
 
-    ::Geometry* GetGeometry(uint32_t id)
+    // Closes the worker models of a model, once the geometry they produced has been given to the model
+    void CloseWorkerModels(::Model* model)
     {
-        auto it = geometries.find(id);
-        if (it == geometries.end())
-            return nullptr;
-        return it->second;
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto id : model->workerModelIds)
+            manager->CloseModel(id);
+        model->workerModelIds.clear();
     }
 
-    Mesh* ToMesh(IfcPlacedGeometry& pg) 
+    // Releases the wrappers and tables of the model, then closes its engine models,
+    // which releases their token streams, line indices and geometry processor caches.
+    // Any stream over the model must be ended first.
+    void UnloadModel(::Model* model)
     {
-        auto r = new Mesh(pg.geometryExpressID);
-        r->color = Color(pg.color.r, pg.color.g, pg.color.b, pg.color.a);
-        r->geometry = &(geometryProcessor->GetGeometry(pg.geometryExpressID));
-        r->transform = pg.flatTransformation;
-        return r;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (models.erase(model) == 0)
+                return;
+        }
+        ReleaseModel(model);
     }
-};
 
-struct Api 
-{
-    ModelManager* manager;
-    IfcSchemaManager* schemaManager;
-    LoaderSettings* settings;
+    // Deletes a model that is not one of the open models, then closes its engine models
+    void ReleaseModel(::Model* model)
+    {
+        std::vector<uint32_t> engineModelIds = { model->id };
+        engineModelIds.insert(engineModelIds.end(), model->workerModelIds.begin(), model->workerModelIds.end());
+        delete model;
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto id : engineModelIds)
+            manager->CloseModel(id);
+    }
 
-    Api() 
+    ModelMemoryStats GetMemoryStats(::Model* model)
     {
-        schemaManager = new IfcSchemaManager();
-        manager = new ModelManager(false);
-        manager->SetLogLevel(6); // Turns off logging
-        settings = new webifc::manager::LoaderSettings();
-    }   
+        ModelMemoryStats stats = {};
+        model->AddMemoryStats(stats);
+
+        // A model read from the geometry cache has not been parsed yet
+        if (model->deferredLoad)
+            return stats;
+        std::vector<uint32_t> engineModelIds = { model->id };
+        engineModelIds.insert(engineModelIds.end(), model->workerModelIds.begin(), model->workerModelIds.end());
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto id : engineModelIds)
+        {
+            auto loader = manager->GetIfcLoader(id);
+            stats.tokenStreamBytes += loader->GetTotalSize();
+            stats.lineIndexBytes += ((size_t)loader->GetMaxExpressId() + 1) * LineIndexBytesPerLine;
+        }
+        return stats;
+    }
 
-    Model* LoadModel(const char* fileName)
+    GeometryStream* BeginGeometryStream(::Model* model, const StreamOptions& options)
     {
-        auto modelId = manager->CreateModel(*settings);
-        auto loader = manager->GetIfcLoader(modelId);
-        std::ifstream ifs;
-        // NOTE: may fail if the file has unicode characters. This needs to be tested  
-        ifs.open(fileName, std::ifstream::in);
-        loader->LoadFile(ifs);
-        return new ::Model(schemaManager, loader, manager->GetGeometryProcessor(modelId), modelId);
+        auto stream = new GeometryStream(model, (size_t)std::max(options.queueCapacity, 1));
+        std::vector<IfcGeometryProcessor*> processors = { model->geometryProcessor };
+        if (model->lazy)
+        {
+            WorkStealingPool pool(ResolveNumThreads(options.numThreads));
+            processors = GetWorkerProcessors(model, pool);
+        }
+        stream->Start(processors, options.processorBudgetBytes);
+        return stream;
     }
 };
 
@@ -172,15 +3225,119 @@ Api* InitializeApi() {
     return new Api();
 }
 
+Api* InitializeApiWithOptions(const ApiOptions* options) {
+    return new Api(options ? *options : ApiOptions());
+}
+
 void FinalizeApi(Api* api) {
-    delete api->manager;
-    delete api->schemaManager;
-    delete api->settings;
     delete api;
 }
 
+// Exceptions must not cross the C boundary, so a load that throws returns null
+template<typename F>
+static Model* NullOnException(F load) {
+    try {
+        return load();
+    }
+    catch (...) {
+        return nullptr;
+    }
+}
+
 Model* LoadModel(Api* api, const char* fileName) {
-    return api->LoadModel(fileName);
+    return NullOnException([&]() { return api->LoadModel(fileName, LoadOptions()); });
+}
+
+Model* LoadModelWithOptions(Api* api, const char* fileName, const LoadOptions* options) {
+    return NullOnException([&]() { return api->LoadModel(fileName, options ? *options : LoadOptions()); });
+}
+
+Model* LoadModelFromBuffer(Api* api, const char* data, size_t size) {
+    return NullOnException([&]() { return api->LoadModel(data, size, LoadOptions()); });
+}
+
+Model* LoadModelFromBufferWithOptions(Api* api, const char* data, size_t size, const LoadOptions* options) {
+    return NullOnException([&]() { return api->LoadModel(data, size, options ? *options : LoadOptions()); });
+}
+
+LoadJob* BeginLoadModel(Api* api, const char* fileName, const LoadOptions* options) {
+    return api->BeginLoadModel(fileName, nullptr, 0, options ? *options : LoadOptions());
+}
+
+LoadJob* BeginLoadModelFromBuffer(Api* api, const char* data, size_t size, const LoadOptions* options) {
+    return api->BeginLoadModel(std::string(), data, size, options ? *options : LoadOptions());
+}
+
+int32_t IsLoadJobDone(Api* api, LoadJob* job) {
+    return job->result.wait_for(std::chrono::seconds(0)) == std::future_status::ready ? 1 : 0;
+}
+
+Model* EndLoadModel(Api* api, LoadJob* job) {
+    return api->EndLoadModel(job);
+}
+
+Model* ReloadModel(Api* api, Model* previous, const char* fileName, const LoadOptions* options) {
+    return NullOnException([&]() {
+        if (!previous)
+            return api->LoadModel(fileName, options ? *options : LoadOptions());
+        return api->ReloadModel(previous, fileName, options ? *options : LoadOptions());
+    });
+}
+
+Model* ReloadModelFromBuffer(Api* api, Model* previous, const char* data, size_t size, const LoadOptions* options) {
+    return NullOnException([&]() {
+        if (!previous)
+            return api->LoadModel(data, size, options ? *options : LoadOptions());
+        return api->ReloadModel(previous, data, size, options ? *options : LoadOptions());
+    });
+}
+
+void GetChangeSetCounts(Api* api, Model* model, ChangeSetCounts* counts) {
+    auto& c = model->changes;
+    counts->numAdded = (int64_t)c.added.size();
+    counts->numRemoved = (int64_t)c.removed.size();
+    counts->numModified = (int64_t)c.modified.size();
+    counts->numUnchanged = c.numUnchanged;
+    counts->numReused = c.numReused;
+    counts->numTessellated = c.numTessellated;
+    counts->hashSeconds = c.hashSeconds;
+}
+
+void GetChangeSetArrays(Api* api, Model* model, ChangeSetArrays* arrays) {
+    auto& c = model->changes;
+    arrays->addedIds = c.added.data();
+    arrays->removedIds = c.removed.data();
+    arrays->modifiedIds = c.modified.data();
+    arrays->modifiedPreviousIds = c.modifiedPrevious.data();
+}
+
+void UnloadModel(Api* api, Model* model) {
+    api->UnloadModel(model);
+}
+
+void GetModelMemoryStats(Api* api, Model* model, ModelMemoryStats* stats) {
+    *stats = api->GetMemoryStats(model);
+}
+
+void GetStats(Api* api, Model* model, ModelStats* stats) {
+    *stats = model->GetStats();
+}
+
+int32_t WriteTrace(Api* api, Model* model, const char* fileName) {
+    std::ofstream out(std::filesystem::path(reinterpret_cast<const char8_t*>(fileName)), std::ios::binary);
+    model->stats.WriteTrace(out, [api](uint32_t type) { return api->schemaManager->IfcTypeCodeToType(type); });
+    return out.good() ? 0 : -1;
+}
+
+int64_t GetNumSkippedElements(Api* api, Model* model) {
+    return (int64_t)model->skipped.Size();
+}
+
+int64_t GetSkippedElements(Api* api, Model* model, SkippedElement* elements, int64_t capacity) {
+    auto skipped = model->skipped.Elements();
+    auto n = std::min((int64_t)skipped.size(), capacity);
+    std::copy(skipped.begin(), skipped.begin() + n, elements);
+    return n;
 }
 
 double* GetTransform(Api* api, Mesh* mesh) {
@@ -191,10 +3348,75 @@ double* GetColor(Api* api, Mesh* mesh) {
     return &mesh->color.R;
 }
 
+void GetMeshBounds(Api* api, Mesh* mesh, double* bounds) {
+    mesh->bounds.ToArray(bounds);
+}
+
+int32_t GetElementBounds(Api* api, Model* model, uint32_t id, double* bounds) {
+    auto g = model->GetGeometry(id);
+    if (!g || g->bounds.IsEmpty())
+        return 0;
+    g->bounds.ToArray(bounds);
+    return 1;
+}
+
+int64_t BuildSpatialIndex(Api* api, Model* model) {
+    return (int64_t)model->GetSpatialIndex().Size();
+}
+
+// The query functions return the number of matches, and write at most capacity of them
+int64_t QueryBox(Api* api, Model* model, const double* box, uint32_t* ids, int64_t capacity) {
+    int64_t n = 0;
+    model->GetSpatialIndex().QueryBox(Aabb::FromArray(box), [&](uint32_t id)
+    {
+        if (n < capacity)
+            ids[n] = id;
+        n++;
+    });
+    return n;
+}
+
+int64_t QueryFrustum(Api* api, Model* model, const double* planes, int32_t numPlanes, uint32_t* ids, int64_t capacity) {
+    int64_t n = 0;
+    model->GetSpatialIndex().QueryFrustum(planes, (size_t)std::max(numPlanes, 0), [&](uint32_t id)
+    {
+        if (n < capacity)
+            ids[n] = id;
+        n++;
+    });
+    return n;
+}
+
+int64_t QueryRay(Api* api, Model* model, const double* origin, const double* direction, double maxDistance, uint32_t* ids, double* distances, int64_t capacity) {
+    auto hits = model->GetSpatialIndex().QueryRay(origin, direction, maxDistance);
+    for (int64_t i = 0; i < std::min((int64_t)hits.size(), capacity); ++i)
+    {
+        ids[i] = hits[i].second;
+        if (distances)
+            distances[i] = hits[i].first;
+    }
+    return (int64_t)hits.size();
+}
+
+int64_t QueryNearest(Api* api, Model* model, const double* point, uint32_t* ids, double* distances, int64_t count) {
+    auto nearest = model->GetSpatialIndex().QueryNearest(point, (size_t)std::max<int64_t>(count, 0));
+    for (size_t i = 0; i < nearest.size(); ++i)
+    {
+        ids[i] = nearest[i].second;
+        if (distances)
+            distances[i] = nearest[i].first;
+    }
+    return (int64_t)nearest.size();
+}
+
 ::Geometry* GetGeometry(Api* api, Model* model, uint32_t id) {
     return model->GetGeometry(id);
 }
 
+uint32_t GetGeometryId(Api* api, ::Geometry* geom) {
+    return geom->id;
+}
+
 int GetNumMeshes(Api* api, ::Geometry* geom) {
     return geom->meshes.size();
 }
@@ -218,3 +3440,291 @@ int GetNumIndices(Api* api, Mesh* mesh) {
 uint32_t* GetIndices(Api* api, Mesh* mesh) {
     return mesh->geometry->indexData.data();
 }
+
+int32_t BuildLods(Api* api, Model* model, const LodOptions* options) {
+    if (!options)
+        return -1;
+    return model->BuildLods(*options);
+}
+
+int GetNumLods(Api* api, Mesh* mesh) {
+    return (int)mesh->lods.size();
+}
+
+int GetLodNumVertices(Api* api, Mesh* mesh, int level) {
+    return mesh->lods[level]->vertexData.size() / 6;
+}
+
+Vertex* GetLodVertices(Api* api, Mesh* mesh, int level) {
+    return reinterpret_cast<Vertex*>(mesh->lods[level]->vertexData.data());
+}
+
+int GetLodNumIndices(Api* api, Mesh* mesh, int level) {
+    return mesh->lods[level]->indexData.size();
+}
+
+uint32_t* GetLodIndices(Api* api, Mesh* mesh, int level) {
+    return mesh->lods[level]->indexData.data();
+}
+
+int64_t OptimizeGeometries(Api* api, Model* model, const OptimizeOptions* options, OptimizeStats* stats) {
+    OptimizeOptions defaults;
+    OptimizeStats unused;
+    return model->OptimizeGeometries(options ? *options : defaults, stats ? *stats : unused);
+}
+
+void GetMeshCounts(Api* api, Model* model, MeshCounts* counts) {
+    *counts = model->GetMeshCounts();
+}
+
+int64_t ExportMeshes(Api* api, Model* model, MeshBuffers* buffers) {
+    return model->ExportMeshes(*buffers, VertexEncoding{ VertexFormatDouble, 0, 0, 0, 0 });
+}
+
+int32_t GetVertexStride(int32_t format) {
+    return VertexStride(format);
+}
+
+void EncodeVertices(Api* api, Mesh* mesh, const VertexEncoding* encoding, void* vertices, double* bounds) {
+    Model::EncodeVertices(mesh, *encoding, vertices, bounds);
+}
+
+int64_t ExportEncodedMeshes(Api* api, Model* model, const VertexEncoding* encoding, MeshBuffers* buffers) {
+    return model->ExportMeshes(*buffers, *encoding);
+}
+
+void GetInstanceCounts(Api* api, Model* model, int32_t dedupByContent, InstanceCounts* counts) {
+    *counts = model->GetInstanceCounts(dedupByContent != 0);
+}
+
+int64_t ExportInstances(Api* api, Model* model, int32_t dedupByContent, const VertexEncoding* encoding, InstanceBuffers* buffers) {
+    return model->ExportInstances(dedupByContent != 0, 
+        encoding ? *encoding : VertexEncoding{ VertexFormatDouble, 0, 0, 0, 0 }, *buffers);
+}
+
+void GetBatchCounts(Api* api, Model* model, int32_t maxVerticesPerBatch, BatchCounts* counts) {
+    *counts = model->GetBatchCounts(maxVerticesPerBatch);
+}
+
+int64_t ExportBatches(Api* api, Model* model, int32_t maxVerticesPerBatch, const VertexEncoding* encoding, BatchBuffers* buffers) {
+    return model->ExportBatches(maxVerticesPerBatch, 
+        encoding ? *encoding : VertexEncoding{ VertexFormatDouble, 1, 0, 0, 0 }, *buffers);
+}
+
+int64_t ExportGlb(Api* api, Model* model, const char* fileName, const GlbOptions* options) {
+    std::ofstream out(std::filesystem::path(reinterpret_cast<const char8_t*>(fileName)), std::ios::binary);
+    if (!out)
+        return -1;
+    auto n = model->ExportGlb(options ? *options : GlbOptions(), [&](const void* data, size_t size)
+    {
+        out.write(static_cast<const char*>(data), (std::streamsize)size);
+        return out.good();
+    });
+    out.close();
+    return out.good() ? n : -1;
+}
+
+int64_t ExportGlbToSink(Api* api, Model* model, const GlbOptions* options, int32_t (*write)(void* userData, const void* data, int64_t size), void* userData) {
+    return model->ExportGlb(options ? *options : GlbOptions(), [&](const void* data, size_t size)
+    {
+        return write(userData, data, (int64_t)size) != 0;
+    });
+}
+
+int64_t ExportSpeckle(Api* api, Model* model, const char* fileName, const SpeckleOptions* options, char* rootId, int64_t rootIdCapacity) {
+    if (rootId && rootIdCapacity < SpeckleRootIdCapacity)
+        return -1;
+    std::ofstream out(std::filesystem::path(reinterpret_cast<const char8_t*>(fileName)), std::ios::binary);
+    if (!out)
+        return -1;
+    auto n = ExportSpeckleToSink(api, model, options, [](void* userData, const void* data, int64_t size)
+    {
+        auto& out = *static_cast<std::ofstream*>(userData);
+        out.write(static_cast<const char*>(data), (std::streamsize)size);
+        return out.good() ? 1 : 0;
+    }, &out, rootId, rootIdCapacity);
+    out.close();
+    return out.good() ? n : -1;
+}
+
+int64_t ExportSpeckleToSink(Api* api, Model* model, const SpeckleOptions* options, int32_t (*write)(void* userData, const void* data, int64_t size), void* userData, char* rootId, int64_t rootIdCapacity) {
+    if (rootId && rootIdCapacity < SpeckleRootIdCapacity)
+        return -1;
+    std::string id;
+    auto n = model->ExportSpeckle(options ? *options : SpeckleOptions(),
+        [api](uint32_t type) { return api->schemaManager->IfcTypeCodeToType(type); },
+        [&](const void* data, size_t size) { return write(userData, data, (int64_t)size) != 0; }, id);
+    if (rootId)
+        std::memcpy(rootId, id.c_str(), id.size() + 1);
+    return n;
+}
+
+uint32_t GetTypeCode(Api* api, const char* typeName) {
+    return api->schemaManager->IfcTypeToTypeCode(typeName);
+}
+
+LineTable* DecodeLines(Api* api, Model* model, const uint32_t* expressIds, int64_t count) {
+    auto table = new LineTable();
+    table->Decode(model->GetLoader(), std::vector<uint32_t>(expressIds, expressIds + count));
+    return table;
+}
+
+LineTable* DecodeLinesOfType(Api* api, Model* model, uint32_t type) {
+    auto loader = model->GetLoader();
+    auto table = new LineTable();
+    table->Decode(loader, loader->GetExpressIDsWithType(type));
+    return table;
+}
+
+void GetLineTableCounts(Api* api, LineTable* table, LineTableCounts* counts) {
+    counts->numLines = table->NumLines();
+    counts->numValues = table->tags.size();
+    counts->numReals = table->reals.size();
+    counts->numStrings = table->NumStrings();
+    counts->numStringBytes = table->stringData.size();
+}
+
+void GetLineTableArrays(Api* api, LineTable* table, LineTableArrays* arrays) {
+    arrays->lineIds = table->lineIds.data();
+    arrays->lineTypes = table->lineTypes.data();
+    arrays->lineOffsets = table->lineOffsets.data();
+    arrays->tags = table->tags.data();
+    arrays->values = table->values.data();
+    arrays->reals = table->reals.data();
+    arrays->stringOffsets = table->stringOffsets.data();
+    arrays->stringData = table->stringData.data();
+}
+
+void FreeLineTable(Api* api, LineTable* table) {
+    delete table;
+}
+
+void GetRelationIndexCounts(Api* api, Model* model, RelationIndexCounts* counts) {
+    auto& index = model->GetRelationIndex();
+    counts->numRelations = index.NumRelations();
+    counts->numEdges = index.NumEdges();
+    counts->numOffsets = index.forward.offsets.size();
+}
+
+void GetRelationIndexArrays(Api* api, Model* model, RelationIndexArrays* arrays) {
+    auto& index = model->GetRelationIndex();
+    arrays->relationIds = index.relationIds.data();
+    arrays->relationTypes = index.relationTypes.data();
+    arrays->forwardOffsets = index.forward.offsets.data();
+    arrays->forwardIds = index.forward.ids.data();
+    arrays->forwardRelations = index.forward.relations.data();
+    arrays->reverseOffsets = index.reverse.offsets.data();
+    arrays->reverseIds = index.reverse.ids.data();
+    arrays->reverseRelations = index.reverse.relations.data();
+}
+
+void GetPropertyTableCounts(Api* api, Model* model, PropertyTableCounts* counts) {
+    auto& table = model->GetPropertyTable();
+    counts->numRows = table.NumRows();
+    counts->numStrings = table.lines.NumStrings();
+    counts->numStringBytes = table.lines.stringData.size();
+}
+
+void GetPropertyTableArrays(Api* api, Model* model, PropertyTableArrays* arrays) {
+    auto& table = model->GetPropertyTable();
+    arrays->elementIds = table.elementIds.data();
+    arrays->propertySetIds = table.propertySetIds.data();
+    arrays->propertySetNameIds = table.propertySetNameIds.data();
+    arrays->propertyIds = table.propertyIds.data();
+    arrays->propertyNameIds = table.propertyNameIds.data();
+    arrays->complexNameIds = table.complexNameIds.data();
+    arrays->valueTypeIds = table.valueTypeIds.data();
+    arrays->valueIndices = table.valueIndices.data();
+    arrays->valueKinds = table.valueKinds.data();
+    arrays->intValues = table.intValues.data();
+    arrays->realValues = table.realValues.data();
+    arrays->stringOffsets = table.lines.stringOffsets.data();
+    arrays->stringData = table.lines.stringData.data();
+}
+
+void GetGlobalIdTableCounts(Api* api, Model* model, GlobalIdTableCounts* counts) {
+    auto& table = model->GetGlobalIdTable();
+    counts->numIds = (int64_t)table.Size();
+    counts->numDuplicates = table.numDuplicates;
+}
+
+void GetGlobalIdTableArrays(Api* api, Model* model, GlobalIdTableArrays* arrays) {
+    static_assert(sizeof(IfcGuid) == 16, "GUIDs are exposed as packed 16 byte arrays");
+    auto& table = model->GetGlobalIdTable();
+    arrays->expressIds = table.expressIds.data();
+    arrays->guids = table.guids.empty() ? nullptr : table.guids[0].bytes;
+    arrays->guidOrder = table.guidOrder.data();
+}
+
+int64_t GetGlobalIds(Api* api, Model* model, const uint32_t* expressIds, int64_t count, uint8_t* guids) {
+    auto& table = model->GetGlobalIdTable();
+    int64_t found = 0;
+    for (int64_t i = 0; i < count; ++i)
+    {
+        if (auto g = table.FindGuid(expressIds[i]))
+        {
+            std::memcpy(guids + i * 16, g->bytes, 16);
+            found++;
+        }
+        else
+            std::memset(guids + i * 16, 0, 16);
+    }
+    return found;
+}
+
+int64_t GetExpressIdsOfGlobalIds(Api* api, Model* model, const uint8_t* guids, int64_t count, uint32_t* expressIds) {
+    auto& table = model->GetGlobalIdTable();
+    int64_t found = 0;
+    for (int64_t i = 0; i < count; ++i)
+    {
+        IfcGuid g;
+        std::memcpy(g.bytes, guids + i * 16, 16);
+        expressIds[i] = table.FindExpressId(g);
+        if (expressIds[i] != 0)
+            found++;
+    }
+    return found;
+}
+
+int32_t DecodeGlobalId(const char* globalId, uint8_t* guid) {
+    IfcGuid g;
+    if (!IfcGuid::Decode(globalId, g))
+        return 0;
+    std::memcpy(guid, g.bytes, 16);
+    return 1;
+}
+
+void EncodeGlobalId(const uint8_t* guid, char* globalId) {
+    IfcGuid g;
+    std::memcpy(g.bytes, guid, 16);
+    auto s = g.Encode();
+    std::memcpy(globalId, s.c_str(), s.size() + 1);
+}
+
+GeometryStream* BeginGeometryStream(Api* api, Model* model, const StreamOptions* options) {
+    return api->BeginGeometryStream(model, options ? *options : StreamOptions());
+}
+
+::Geometry* NextStreamedGeometry(Api* api, GeometryStream* stream) {
+    return stream->Next();
+}
+
+int32_t EndGeometryStream(Api* api, GeometryStream* stream) {
+    auto succeeded = stream->Stop();
+    delete stream;
+    return succeeded ? 0 : -1;
+}
+
+int64_t StreamGeometry(Api* api, Model* model, const StreamOptions* options, int32_t (*callback)(void* userData, ::Geometry* geometry), void* userData) {
+    auto stream = api->BeginGeometryStream(model, options ? *options : StreamOptions());
+    int64_t n = 0;
+    while (auto g = stream->Next())
+    {
+        ++n;
+        if (!callback(userData, g))
+            break;
+    }
+    auto succeeded = stream->Stop();
+    delete stream;
+    return succeeded ? n : -1;
+}
@@ -0,0 +1,96 @@
+// Apache 2.0 License
+// Author: Christopher Diggins of Ara 3D Inc for Speckle Systems Ltd.
+// A monotonic arena for the wrapper objects of a model (geometries and meshes),
+// so that a model is released with a few block frees instead of one free per object.
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Objects are bump-allocated from large blocks and are only released all at once, by Clear or the destructor.
+// Destructors of objects that need them are recorded and run in reverse order of construction.
+// Allocation is serialized by a mutex, so workers extracting geometry in parallel can share an arena.
+class Arena
+{
+    struct Destructor
+    {
+        void (*destroy)(void*);
+        void* object;
+    };
+
+    std::mutex mutex;
+    std::vector<std::unique_ptr<char[]>> blocks;
+    std::vector<Destructor> destructors;
+    char* cursor = nullptr;
+    size_t remaining = 0;
+    size_t blockSize;
+    size_t reserved = 0;
+
+    void* Allocate(size_t size, size_t alignment)
+    {
+        auto padding = (alignment - (reinterpret_cast<uintptr_t>(cursor) & (alignment - 1))) & (alignment - 1);
+        if (cursor == nullptr || padding + size > remaining)
+        {
+            auto n = std::max(blockSize, size + alignment);
+            blocks.emplace_back(new char[n]);
+            cursor = blocks.back().get();
+            remaining = n;
+            reserved += n;
+            padding = (alignment - (reinterpret_cast<uintptr_t>(cursor) & (alignment - 1))) & (alignment - 1);
+        }
+        auto p = cursor + padding;
+        cursor += padding + size;
+        remaining -= padding + size;
+        return p;
+    }
+
+public:
+
+    explicit Arena(size_t blockSize = 64 * 1024)
+        : blockSize(blockSize)
+    { }
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    ~Arena()
+    {
+        Clear();
+    }
+
+    template<typename T, typename... Args>
+    T* New(Args&&... args)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto p = new (Allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+        if (!std::is_trivially_destructible<T>::value)
+            destructors.push_back({ [](void* o) { static_cast<T*>(o)->~T(); }, p });
+        return p;
+    }
+
+    void Clear()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto it = destructors.rbegin(); it != destructors.rend(); ++it)
+            it->destroy(it->object);
+        destructors.clear();
+        blocks.clear();
+        cursor = nullptr;
+        remaining = 0;
+        reserved = 0;
+    }
+
+    // Bytes reserved from the heap, including the unused tail of the current block
+    size_t Bytes() const
+    {
+        return reserved + destructors.capacity() * sizeof(Destructor);
+    }
+};
@@ -0,0 +1,64 @@
+// Apache 2.0 License
+// Author: Christopher Diggins of Ara 3D Inc for Speckle Systems Ltd.
+// A blocking queue with a fixed capacity, used to hand results from producer threads to a consumer
+// while limiting how much work can be in flight.
+
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+// Producers block in Push while the queue is full, which applies backpressure when the consumer is slower.
+// Once closed, Push fails immediately and Pop returns the remaining items before reporting the end.
+template<typename T>
+class BoundedQueue
+{
+    std::mutex mutex;
+    std::condition_variable notFull;
+    std::condition_variable notEmpty;
+    std::deque<T> items;
+    size_t capacity;
+    bool closed = false;
+
+public:
+
+    explicit BoundedQueue(size_t capacity)
+        : capacity(std::max<size_t>(capacity, 1))
+    { }
+
+    // Returns false, without adding the item, if the queue was closed.
+    bool Push(T item)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        notFull.wait(lock, [&] { return closed || items.size() < capacity; });
+        if (closed)
+            return false;
+        items.push_back(std::move(item));
+        notEmpty.notify_one();
+        return true;
+    }
+
+    // Blocks until an item is available. Returns false once the queue is closed and empty.
+    bool Pop(T& item)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        notEmpty.wait(lock, [&] { return closed || !items.empty(); });
+        if (items.empty())
+            return false;
+        item = std::move(items.front());
+        items.pop_front();
+        notFull.notify_one();
+        return true;
+    }
+
+    // Wakes all waiting producers and consumers.
+    void Close()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        notFull.notify_all();
+        notEmpty.notify_all();
+    }
+};
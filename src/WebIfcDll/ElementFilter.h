@@ -0,0 +1,125 @@
+// Apache 2.0 License
+// Author: Christopher Diggins of Ara 3D Inc for Speckle Systems Ltd.
+// Selects the elements of a model to tessellate, by type, by spatial container, and by express ID.
+// Filtered elements are never tessellated, so a selective load costs roughly in proportion to what it keeps.
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <unordered_set>
+#include <vector>
+#include "Hashing.h"
+#include "RelationIndex.h"
+
+struct ElementFilter
+{
+    // Element types to keep. Empty keeps every element type.
+    std::vector<uint32_t> includeTypes;
+
+    // Element types to drop, in addition to the default exclusions
+    std::vector<uint32_t> excludeTypes;
+
+    // Spatial structure elements (e.g. a building or a storey) whose contents are kept, found by following
+    // IfcRelAggregates and IfcRelContainedInSpatialStructure down from them. Empty keeps elements anywhere.
+    std::vector<uint32_t> containers;
+
+    // Express IDs of the elements to keep. Empty keeps every element.
+    std::vector<uint32_t> expressIds;
+
+    // Opening elements and spaces are dropped unless this is set, or their type is in includeTypes
+    bool noDefaultExclusions = false;
+
+    static std::vector<uint32_t> DefaultExclusions()
+    {
+        using namespace webifc::schema;
+        return { IFCOPENINGELEMENT, IFCSPACE, IFCOPENINGSTANDARDCASE };
+    }
+
+    bool NeedsRelations() const
+    {
+        return !containers.empty();
+    }
+
+    bool AcceptsType(uint32_t type) const
+    {
+        auto included = std::find(includeTypes.begin(), includeTypes.end(), type) != includeTypes.end();
+        if (!includeTypes.empty() && !included)
+            return false;
+        if (std::find(excludeTypes.begin(), excludeTypes.end(), type) != excludeTypes.end())
+            return false;
+        if (noDefaultExclusions || included)
+            return true;
+        auto defaults = DefaultExclusions();
+        return std::find(defaults.begin(), defaults.end(), type) == defaults.end();
+    }
+
+    // Calls f(expressId, type) for every element that passes the filter, by type in the order of elementTypes,
+    // then in the order of the loader. The relation index is only used when there are containers.
+    template<typename F>
+    void ForEachElement(webifc::parsing::IfcLoader* loader, const std::vector<uint32_t>& elementTypes,
+        const RelationIndex* relations, F f) const
+    {
+        std::unordered_set<uint32_t> allowed(expressIds.begin(), expressIds.end());
+        std::unordered_set<uint32_t> contained;
+        if (NeedsRelations())
+            contained = ContainedElements(*relations);
+
+        for (auto type : elementTypes)
+        {
+            if (!AcceptsType(type))
+                continue;
+            for (auto eId : loader->GetExpressIDsWithType(type))
+            {
+                if (!allowed.empty() && allowed.find(eId) == allowed.end())
+                    continue;
+                if (NeedsRelations() && contained.find(eId) == contained.end())
+                    continue;
+                f(eId, type);
+            }
+        }
+    }
+
+    // The containers and everything below them: storeys aggregated by a building, elements contained in a storey,
+    // and the parts aggregated by an element such as a stair or a curtain wall
+    std::unordered_set<uint32_t> ContainedElements(const RelationIndex& relations) const
+    {
+        using namespace webifc::schema;
+        std::unordered_set<uint32_t> r(containers.begin(), containers.end());
+        std::vector<uint32_t> stack(containers.begin(), containers.end());
+        while (!stack.empty())
+        {
+            auto id = stack.back();
+            stack.pop_back();
+            auto ids = relations.forward.Ids(id);
+            auto rels = relations.forward.Relations(id);
+            for (uint32_t i = 0; i < relations.forward.Count(id); ++i)
+            {
+                auto type = relations.relationTypes[rels[i]];
+                if (type != IFCRELAGGREGATES && type != IFCRELCONTAINEDINSPATIALSTRUCTURE)
+                    continue;
+                if (r.insert(ids[i]).second)
+                    stack.push_back(ids[i]);
+            }
+        }
+        return r;
+    }
+
+    // Identifies the selection, e.g. as part of a cache key. Lists are compared as sets.
+    uint64_t Hash() const
+    {
+        auto sorted = [](std::vector<uint32_t> v)
+        {
+            std::sort(v.begin(), v.end());
+            v.erase(std::unique(v.begin(), v.end()), v.end());
+            return v;
+        };
+        return Hasher64()
+            .Add(sorted(includeTypes))
+            .Add(sorted(excludeTypes))
+            .Add(sorted(containers))
+            .Add(sorted(expressIds))
+            .Add((uint64_t)noDefaultExclusions)
+            .Digest();
+    }
+};
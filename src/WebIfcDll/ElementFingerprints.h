@@ -0,0 +1,371 @@
+// Apache 2.0 License
+// Author: Christopher Diggins of Ara 3D Inc for Speckle Systems Ltd.
+// Content hashes of the lines and elements of a model that do not depend on express IDs, so that the same
+// content hashes the same in two revisions of a file, even when its lines were renumbered.
+// It does not use threads, so two revisions can be hashed at the same time, each with its own loader.
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "Hashing.h"
+#include "LineDecoder.h"
+
+// Lines that refer to the line they describe, rather than being referred to by it, such as styles.
+// Their hash is part of the hash of every line they refer to through ownerArg, and ownerArg itself is not hashed.
+struct AttachmentKind
+{
+    uint32_t type;
+    uint32_t ownerArg;
+};
+
+// The attachments that change the tessellation of an element: the styles of representation items,
+// the openings and aggregated parts of elements, and the materials of elements with their styles.
+// Argument positions are the same in IFC2x3 and IFC4.
+inline std::vector<AttachmentKind> GeometryAttachmentKinds()
+{
+    using namespace webifc::schema;
+    return {
+        { IFCSTYLEDITEM, 0 },
+        { IFCRELVOIDSELEMENT, 4 },
+        { IFCRELAGGREGATES, 4 },
+        { IFCRELASSOCIATESMATERIAL, 4 },
+        { IFCMATERIALDEFINITIONREPRESENTATION, 3 },
+    };
+}
+
+// Hashes lines as Merkle trees: a line hashes its type and argument values, with the hash of each line
+// it refers to in place of the express ID, followed by the hashes of its attachments in sorted order.
+// References in a cycle are hashed as a constant where they close the cycle.
+// Lines of ignored types hash to a constant, and are not read.
+class LineHasher
+{
+    enum Word : uint64_t
+    {
+        WordEmpty = 1, WordSetBegin, WordSetEnd, WordLabel, WordString, WordEnum, WordReal, WordInteger, WordRef,
+        WordMissing, WordCycle, WordIgnored, WordAttachments,
+    };
+
+    enum State : uint8_t
+    {
+        Missing, Unvisited, InProgress, Done,
+    };
+
+    // A line being hashed. The references are positions in words to be replaced by the hashes of their lines.
+    struct Frame
+    {
+        uint32_t id = 0;
+        bool expanded = false;
+        size_t attachmentsBegin = 0;
+        std::vector<uint64_t> words;
+        std::vector<std::pair<size_t, uint32_t>> refs;
+    };
+
+    webifc::parsing::IfcLoader* loader;
+    std::vector<uint64_t>& hashes;
+    std::vector<uint8_t> states;
+    std::unordered_map<uint32_t, uint32_t> ownerArgs;
+    std::unordered_map<uint32_t, std::vector<uint32_t>> attachments;
+    std::vector<uint32_t> ignoredTypes;
+
+    // Frames are reused, so that their buffers are allocated once per depth rather than once per line
+    std::vector<Frame> stack;
+    size_t depth = 0;
+
+public:
+
+    // Hashes are written to hashes, indexed by express ID, and are never 0 for a hashed line
+    LineHasher(webifc::parsing::IfcLoader* loader, const std::vector<AttachmentKind>& kinds,
+        const std::vector<uint32_t>& ignoredTypes, std::vector<uint64_t>& hashes)
+        : loader(loader), hashes(hashes), ignoredTypes(ignoredTypes)
+    {
+        auto maxId = loader->GetMaxExpressId();
+        hashes.assign((size_t)maxId + 1, 0);
+        states.assign((size_t)maxId + 1, Missing);
+        for (auto id : loader->GetAllLines())
+            if (id <= maxId)
+                states[id] = Unvisited;
+
+        for (auto& kind : kinds)
+        {
+            ownerArgs[kind.type] = kind.ownerArg;
+            LineTable table;
+            table.Decode(loader, loader->GetExpressIDsWithType(kind.type));
+            for (size_t line = 0; line < table.NumLines(); ++line)
+                table.ForEachRef(line, kind.ownerArg, [&](uint32_t owner)
+                {
+                    attachments[owner].push_back(table.lineIds[line]);
+                });
+        }
+    }
+
+    uint64_t Hash(uint32_t id)
+    {
+        if (!Exists(id))
+            return WordMissing;
+        Push(id);
+        while (depth > 0)
+        {
+            auto& f = stack[depth - 1];
+            if (f.expanded)
+            {
+                Finish(f);
+                --depth;
+                continue;
+            }
+            if (states[f.id] != Unvisited)
+            {
+                --depth;
+                continue;
+            }
+
+            auto type = loader->GetLineType(f.id);
+            if (std::find(ignoredTypes.begin(), ignoredTypes.end(), type) != ignoredTypes.end())
+            {
+                hashes[f.id] = Hasher64().Add((uint64_t)WordIgnored).Add((uint64_t)type).Digest() | 1;
+                states[f.id] = Done;
+                --depth;
+                continue;
+            }
+
+            states[f.id] = InProgress;
+            f.expanded = true;
+            Decode(f, type);
+
+            // Growing the stack may move the frames, so it is grown before the references are pushed
+            size_t numChildren = 0;
+            for (auto& r : f.refs)
+                if (Exists(r.second) && states[r.second] == Unvisited)
+                    ++numChildren;
+            while (stack.size() < depth + numChildren)
+                stack.emplace_back();
+            auto parent = depth - 1;
+            for (auto& r : stack[parent].refs)
+                if (Exists(r.second) && states[r.second] == Unvisited)
+                    Push(r.second);
+        }
+        return hashes[id];
+    }
+
+private:
+
+    bool Exists(uint32_t id) const
+    {
+        return id < states.size() && states[id] != Missing;
+    }
+
+    void Push(uint32_t id)
+    {
+        if (depth == stack.size())
+            stack.emplace_back();
+        auto& f = stack[depth++];
+        f.id = id;
+        f.expanded = false;
+        f.words.clear();
+        f.refs.clear();
+    }
+
+    void Finish(Frame& f)
+    {
+        for (auto& r : f.refs)
+        {
+            if (!Exists(r.second))
+                f.words[r.first] = WordMissing;
+            else if (states[r.second] == Done)
+                f.words[r.first] = hashes[r.second];
+            else
+                f.words[r.first] = WordCycle;
+        }
+        std::sort(f.words.begin() + f.attachmentsBegin, f.words.end());
+        hashes[f.id] = Hasher64().Add(f.words).Digest() | 1;
+        states[f.id] = Done;
+    }
+
+    static uint64_t StringWord(std::string_view s)
+    {
+        return Hasher64().Add(s).Digest();
+    }
+
+    // Follows the same token handling as LineTable::DecodeArguments, flattened,
+    // counting the top-level arguments to leave out the owner argument of attachments
+    void Decode(Frame& f, uint32_t type)
+    {
+        using namespace webifc::parsing;
+
+        f.words.push_back(type);
+        auto it = ownerArgs.find(type);
+        int64_t skippedArg = it == ownerArgs.end() ? -1 : (int64_t)it->second;
+        int64_t arg = 0;
+        int32_t level = 0;
+        auto done = false;
+
+        loader->MoveToArgumentOffset(f.id, 0);
+        while (!done && !loader->IsAtEnd())
+        {
+            try
+            {
+                auto token = loader->GetTokenType();
+                auto keep = arg != skippedArg;
+                if (level == 0 && token != IfcTokenType::SET_BEGIN && token != IfcTokenType::SET_END
+                    && token != IfcTokenType::LABEL && token != IfcTokenType::LINE_END)
+                    ++arg;
+
+                switch (token)
+                {
+                case IfcTokenType::LINE_END:
+                    done = true;
+                    break;
+                case IfcTokenType::SET_END:
+                    if (level == 0)
+                    {
+                        done = true;
+                        break;
+                    }
+                    if (keep)
+                        f.words.push_back(WordSetEnd);
+                    if (--level == 0)
+                        ++arg;
+                    break;
+                case IfcTokenType::SET_BEGIN:
+                    ++level;
+                    if (keep)
+                        f.words.push_back(WordSetBegin);
+                    break;
+                case IfcTokenType::EMPTY:
+                    if (keep)
+                        f.words.push_back(WordEmpty);
+                    break;
+                case IfcTokenType::LABEL:
+                case IfcTokenType::STRING:
+                case IfcTokenType::ENUM:
+                {
+                    loader->StepBack();
+                    auto s = loader->GetStringArgument();
+                    if (keep)
+                    {
+                        f.words.push_back(token == IfcTokenType::LABEL ? WordLabel : token == IfcTokenType::STRING ? WordString : WordEnum);
+                        f.words.push_back(StringWord(s));
+                    }
+                    break;
+                }
+                case IfcTokenType::REAL:
+                {
+                    loader->StepBack();
+                    double x = loader->GetDoubleArgument();
+                    uint64_t bits;
+                    std::memcpy(&bits, &x, sizeof(bits));
+                    if (keep)
+                    {
+                        f.words.push_back(WordReal);
+                        f.words.push_back(bits);
+                    }
+                    break;
+                }
+                case IfcTokenType::INTEGER:
+                {
+                    loader->StepBack();
+                    auto x = loader->GetIntArgument();
+                    if (keep)
+                    {
+                        f.words.push_back(WordInteger);
+                        f.words.push_back((uint64_t)(int64_t)x);
+                    }
+                    break;
+                }
+                case IfcTokenType::REF:
+                {
+                    loader->StepBack();
+                    auto ref = loader->GetRefArgument();
+                    if (keep)
+                    {
+                        f.words.push_back(WordRef);
+                        f.refs.push_back({ f.words.size(), ref });
+                        f.words.push_back(0);
+                    }
+                    break;
+                }
+                default:
+                    break;
+                }
+            }
+            catch (const std::exception&)
+            {
+                // Same as LineTable: a token that fails to parse is skipped
+            }
+        }
+
+        f.words.push_back(WordAttachments);
+        f.attachmentsBegin = f.words.size();
+        auto a = attachments.find(f.id);
+        if (a == attachments.end())
+            return;
+        for (auto id : a->second)
+        {
+            f.refs.push_back({ f.words.size(), id });
+            f.words.push_back(0);
+        }
+    }
+};
+
+// The content hash of every element of a model, covering its placement, representation, styles,
+// openings, parts and materials, and of the units and representation contexts of the project,
+// which change the tessellation of every element.
+// Owner histories are ignored, because authoring tools rewrite them on every save.
+struct ElementFingerprints
+{
+    std::vector<uint64_t> lineHashes;       // by express ID, 0 for lines not reached from an element
+    std::vector<uint32_t> elementIds;       // ascending
+    std::vector<uint64_t> elementHashes;    // the hash of each of the express IDs
+    uint64_t contextHash = 0;
+
+    size_t Size() const { return elementIds.size(); }
+
+    size_t Bytes() const
+    {
+        return lineHashes.capacity() * sizeof(uint64_t) + elementIds.capacity() * sizeof(uint32_t)
+            + elementHashes.capacity() * sizeof(uint64_t);
+    }
+
+    void Build(webifc::parsing::IfcLoader* loader, const std::vector<uint32_t>& elements, const std::vector<AttachmentKind>& kinds)
+    {
+        using namespace webifc::schema;
+
+        LineHasher hasher(loader, kinds, { IFCOWNERHISTORY }, lineHashes);
+        elementIds = elements;
+        std::sort(elementIds.begin(), elementIds.end());
+        elementIds.erase(std::unique(elementIds.begin(), elementIds.end()), elementIds.end());
+        elementHashes.resize(elementIds.size());
+        for (size_t i = 0; i < elementIds.size(); ++i)
+            elementHashes[i] = hasher.Hash(elementIds[i]);
+
+        // RepresentationContexts and UnitsInContext of the project.
+        // The project itself is not hashed, since the parts it aggregates are attached to it.
+        Hasher64 context;
+        LineTable projects;
+        projects.Decode(loader, loader->GetExpressIDsWithType(IFCPROJECT));
+        for (size_t line = 0; line < projects.NumLines(); ++line)
+            for (size_t arg : { 7, 8 })
+                projects.ForEachRef(line, arg, [&](uint32_t id) { context.Add(hasher.Hash(id)); });
+        contextHash = context.Digest();
+    }
+
+    // Returns the index of an element, or -1
+    int64_t IndexOf(uint32_t elementId) const
+    {
+        auto it = std::lower_bound(elementIds.begin(), elementIds.end(), elementId);
+        if (it == elementIds.end() || *it != elementId)
+            return -1;
+        return it - elementIds.begin();
+    }
+
+    // Returns the hash of a line, or 0 if it was not hashed
+    uint64_t LineHash(uint32_t id) const
+    {
+        return id < lineHashes.size() ? lineHashes[id] : 0;
+    }
+};
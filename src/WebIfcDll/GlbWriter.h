@@ -0,0 +1,548 @@
+// Apache 2.0 License
+// Author: Christopher Diggins of Ara 3D Inc for Speckle Systems Ltd.
+// Streams binary glTF 2.0 (GLB) from unique geometries and the placed instances that refer to them.
+// Each geometry is written once, and shared by instance nodes or by EXT_mesh_gpu_instancing.
+// The layout is planned from the counts alone, so the JSON chunk is generated twice (once to measure it),
+// and the binary chunk is encoded in bounded slices, so that the document is never held in memory.
+// It has no dependencies on the engine. Vertices are supplied as 6 floats (position, normal), and
+// coordinates are written as given: glTF expects Y up, which is how the engine places geometry.
+
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct GlbGeometry
+{
+    int64_t numVertices;
+    int64_t numIndices;
+
+    // Bounds of the local positions, required by glTF for the POSITION accessor
+    double min[3];
+    double max[3];
+};
+
+struct GlbInstance
+{
+    int32_t geometry;
+    int32_t material;
+    uint32_t expressId;
+
+    // Column-major, as in glTF
+    std::array<double, 16> matrix;
+};
+
+class GlbWriter
+{
+public:
+
+    std::vector<GlbGeometry> geometries;
+
+    // Base color of each material, RGBA
+    std::vector<std::array<double, 4>> materials;
+
+    std::vector<GlbInstance> instances;
+
+    // When set, geometries placed more than once with the same material are drawn by a single node
+    // using EXT_mesh_gpu_instancing, unless one of their transforms has shear or mirroring
+    bool gpuInstancing = false;
+
+    // Approximate size of the slices of geometry encoded at once
+    size_t sliceBytes = 64 << 20;
+
+    // Writes the document. encode(geometry, vertices, indices) fills the 6 floats of each vertex and the indices
+    // of a geometry, and is called through forEach(count, body(worker, index)), which may run in parallel.
+    // sink(data, size) receives the output in order, and returns false to abort.
+    // Returns the number of bytes written, or -1 if the sink failed or the document would exceed the 4 GiB limit of GLB.
+    template<typename Sink, typename Encode, typename ForEach>
+    int64_t Write(Sink sink, Encode encode, ForEach forEach)
+    {
+        Plan();
+
+        CountingOut counter;
+        WriteJson(counter);
+        auto jsonLength = Pad4(counter.n);
+        auto totalLength = 12 + 8 + jsonLength + 8 + binLength;
+        if (totalLength > UINT32_MAX)
+            return -1;
+
+        SinkOut<Sink> out(sink);
+        uint32_t header[3] = { 0x46546C67, 2, (uint32_t)totalLength };   // "glTF"
+        out.Write(header, sizeof(header));
+        uint32_t jsonHeader[2] = { (uint32_t)jsonLength, 0x4E4F534A };  // "JSON"
+        out.Write(jsonHeader, sizeof(jsonHeader));
+        WriteJson(out);
+        for (auto i = counter.n; i < jsonLength; ++i)
+            out.Put(" ");
+        uint32_t binHeader[2] = { (uint32_t)binLength, 0x004E4942 };   // "BIN\0"
+        out.Write(binHeader, sizeof(binHeader));
+
+        // Geometries are encoded in parallel a slice at a time, then written in order
+        std::vector<std::vector<uint8_t>> encoded;
+        size_t first = 0;
+        while (first < used.size())
+        {
+            size_t last = first;
+            size_t bytes = 0;
+            while (last < used.size() && (last == first || bytes < sliceBytes))
+                bytes += GeometryBytes(used[last++]);
+            encoded.assign(last - first, {});
+            forEach(last - first, [&](size_t, size_t i)
+            {
+                auto& g = geometries[used[first + i]];
+                auto& buffer = encoded[i];
+                buffer.resize(GeometryBytes(used[first + i]));
+                encode(used[first + i], reinterpret_cast<float*>(buffer.data()),
+                    reinterpret_cast<uint32_t*>(buffer.data() + g.numVertices * VertexStride));
+            });
+            for (auto& buffer : encoded)
+                out.Write(buffer.data(), buffer.size());
+            first = last;
+        }
+        encoded.clear();
+
+        for (auto& group : groups)
+            out.Write(group.trs.data(), group.trs.size() * sizeof(float));
+        out.Flush();
+        return out.ok ? (int64_t)totalLength : -1;
+    }
+
+private:
+
+    static constexpr size_t VertexStride = 6 * sizeof(float);
+
+    // Nodes sharing one mesh through EXT_mesh_gpu_instancing.
+    // trs holds all translations, then all rotations (xyzw), then all scales.
+    struct InstanceGroup
+    {
+        int32_t mesh;
+        std::vector<uint32_t> expressIds;
+        std::vector<float> trs;
+        int64_t byteOffset;
+    };
+
+    // Planned layout
+    std::vector<int32_t> used;                              // non-empty geometries, in output order
+    std::vector<int32_t> usedIndex;                         // per geometry, its index in used, or -1
+    std::vector<int64_t> byteOffsets;                       // per used geometry, in the binary chunk
+    std::vector<std::pair<int32_t, int32_t>> meshes;        // (used geometry, material)
+    std::vector<int32_t> instanceMesh;                      // per instance, or -1 when drawn by a group
+    std::vector<InstanceGroup> groups;
+    int64_t binLength = 0;
+
+    static size_t Pad4(size_t n)
+    {
+        return (n + 3) & ~(size_t)3;
+    }
+
+    size_t GeometryBytes(int32_t g) const
+    {
+        return geometries[g].numVertices * VertexStride + geometries[g].numIndices * sizeof(uint32_t);
+    }
+
+    void Plan()
+    {
+        used.clear();
+        usedIndex.assign(geometries.size(), -1);
+        byteOffsets.clear();
+        binLength = 0;
+        for (size_t g = 0; g < geometries.size(); ++g)
+        {
+            if (geometries[g].numVertices == 0 || geometries[g].numIndices == 0)
+                continue;
+            usedIndex[g] = (int32_t)used.size();
+            used.push_back((int32_t)g);
+            byteOffsets.push_back(binLength);
+            binLength += GeometryBytes((int32_t)g);
+        }
+
+        // One mesh per pair of geometry and material, so each geometry's buffers are shared by all its colors
+        meshes.clear();
+        instanceMesh.assign(instances.size(), -1);
+        std::vector<std::vector<int32_t>> meshInstances;
+        std::vector<std::vector<std::pair<int32_t, int32_t>>> meshesOfGeometry(used.size());
+        for (size_t i = 0; i < instances.size(); ++i)
+        {
+            auto g = usedIndex[instances[i].geometry];
+            if (g < 0)
+                continue;
+            auto& candidates = meshesOfGeometry[g];
+            auto mesh = -1;
+            for (auto& c : candidates)
+                if (c.first == instances[i].material)
+                    mesh = c.second;
+            if (mesh < 0)
+            {
+                mesh = (int32_t)meshes.size();
+                meshes.push_back({ g, instances[i].material });
+                meshInstances.emplace_back();
+                candidates.push_back({ instances[i].material, mesh });
+            }
+            instanceMesh[i] = mesh;
+            meshInstances[mesh].push_back((int32_t)i);
+        }
+
+        groups.clear();
+        if (!gpuInstancing)
+            return;
+        for (size_t m = 0; m < meshes.size(); ++m)
+        {
+            auto& members = meshInstances[m];
+            if (members.size() < 2)
+                continue;
+            InstanceGroup group = { (int32_t)m, {}, std::vector<float>(members.size() * 10), 0 };
+            auto n = members.size();
+            auto decomposed = true;
+            for (size_t k = 0; k < n && decomposed; ++k)
+            {
+                auto& inst = instances[members[k]];
+                decomposed = Decompose(inst.matrix, &group.trs[k * 3], &group.trs[n * 3 + k * 4], &group.trs[n * 7 + k * 3]);
+                group.expressIds.push_back(inst.expressId);
+            }
+            if (!decomposed)
+                continue;
+            for (auto i : members)
+                instanceMesh[i] = -1;
+            group.byteOffset = binLength;
+            binLength += group.trs.size() * sizeof(float);
+            groups.push_back(std::move(group));
+        }
+    }
+
+    // Splits a transform into translation, rotation quaternion (xyzw) and scale.
+    // Fails for transforms with shear, mirroring or a projective row, which nodes must keep as matrices.
+    static bool Decompose(const std::array<double, 16>& m, float* t, float* r, float* s)
+    {
+        if (std::abs(m[3]) > 1e-9 || std::abs(m[7]) > 1e-9 || std::abs(m[11]) > 1e-9 || std::abs(m[15] - 1) > 1e-9)
+            return false;
+        double c[3][3];
+        double scale[3];
+        for (int i = 0; i < 3; ++i)
+        {
+            scale[i] = std::sqrt(m[i * 4] * m[i * 4] + m[i * 4 + 1] * m[i * 4 + 1] + m[i * 4 + 2] * m[i * 4 + 2]);
+            if (scale[i] <= 0)
+                return false;
+            for (int j = 0; j < 3; ++j)
+                c[i][j] = m[i * 4 + j] / scale[i];
+        }
+        for (int i = 0; i < 3; ++i)
+            for (int j = i + 1; j < 3; ++j)
+                if (std::abs(c[i][0] * c[j][0] + c[i][1] * c[j][1] + c[i][2] * c[j][2]) > 1e-6)
+                    return false;
+        auto det = c[0][0] * (c[1][1] * c[2][2] - c[2][1] * c[1][2])
+            - c[1][0] * (c[0][1] * c[2][2] - c[2][1] * c[0][2])
+            + c[2][0] * (c[0][1] * c[1][2] - c[1][1] * c[0][2]);
+        if (det <= 0)
+            return false;
+
+        // Rotation matrix element (row, column) is c[column][row]
+        auto m00 = c[0][0], m11 = c[1][1], m22 = c[2][2];
+        double q[4];
+        auto trace = m00 + m11 + m22;
+        if (trace > 0)
+        {
+            auto k = 0.5 / std::sqrt(trace + 1);
+            q[3] = 0.25 / k;
+            q[0] = (c[1][2] - c[2][1]) * k;
+            q[1] = (c[2][0] - c[0][2]) * k;
+            q[2] = (c[0][1] - c[1][0]) * k;
+        }
+        else if (m00 > m11 && m00 > m22)
+        {
+            auto k = 2 * std::sqrt(1 + m00 - m11 - m22);
+            q[3] = (c[1][2] - c[2][1]) / k;
+            q[0] = 0.25 * k;
+            q[1] = (c[1][0] + c[0][1]) / k;
+            q[2] = (c[2][0] + c[0][2]) / k;
+        }
+        else if (m11 > m22)
+        {
+            auto k = 2 * std::sqrt(1 + m11 - m00 - m22);
+            q[3] = (c[2][0] - c[0][2]) / k;
+            q[0] = (c[1][0] + c[0][1]) / k;
+            q[1] = 0.25 * k;
+            q[2] = (c[2][1] + c[1][2]) / k;
+        }
+        else
+        {
+            auto k = 2 * std::sqrt(1 + m22 - m00 - m11);
+            q[3] = (c[0][1] - c[1][0]) / k;
+            q[0] = (c[2][0] + c[0][2]) / k;
+            q[1] = (c[2][1] + c[1][2]) / k;
+            q[2] = 0.25 * k;
+        }
+        auto len = std::sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+        for (int i = 0; i < 3; ++i)
+        {
+            t[i] = (float)m[12 + i];
+            s[i] = (float)scale[i];
+        }
+        for (int i = 0; i < 4; ++i)
+            r[i] = (float)(q[i] / len);
+        return true;
+    }
+
+    struct CountingOut
+    {
+        size_t n = 0;
+
+        void Put(std::string_view s)
+        {
+            n += s.size();
+        }
+    };
+
+    // Buffers small writes, and passes large ones straight to the sink
+    template<typename Sink>
+    struct SinkOut
+    {
+        Sink& sink;
+        std::string buffer;
+        bool ok = true;
+
+        SinkOut(Sink& sink) : sink(sink) {}
+
+        void Put(std::string_view s)
+        {
+            buffer.append(s);
+            if (buffer.size() >= (1 << 20))
+                Flush();
+        }
+
+        void Write(const void* data, size_t size)
+        {
+            if (size < 4096)
+            {
+                Put(std::string_view(static_cast<const char*>(data), size));
+                return;
+            }
+            Flush();
+            if (ok)
+                ok = sink(data, size);
+        }
+
+        void Flush()
+        {
+            if (ok && !buffer.empty())
+                ok = sink(buffer.data(), buffer.size());
+            buffer.clear();
+        }
+    };
+
+    // Numbers are written with enough digits to round trip: 17 for doubles, and 9 for values stored as floats
+    static std::string Number(double x, bool asFloat = false)
+    {
+        if (!std::isfinite(x))
+            return "0";
+        char s[32];
+        if (asFloat)
+            std::snprintf(s, sizeof(s), "%.9g", (double)(float)x);
+        else
+            std::snprintf(s, sizeof(s), "%.17g", x);
+        return s;
+    }
+
+    static bool IsIdentity(const std::array<double, 16>& m)
+    {
+        for (int i = 0; i < 16; ++i)
+            if (m[i] != (i % 5 == 0 ? 1.0 : 0.0))
+                return false;
+        return true;
+    }
+
+    template<typename Out>
+    void WriteJson(Out& out) const
+    {
+        auto put = [&](std::string_view s) { out.Put(s); };
+        auto num = [&](double x) { out.Put(Number(x)); };
+        auto integer = [&](int64_t x) { out.Put(std::to_string(x)); };
+        auto list = [&](size_t n, auto item)
+        {
+            put("[");
+            for (size_t i = 0; i < n; ++i)
+            {
+                if (i > 0)
+                    put(",");
+                item(i);
+            }
+            put("]");
+        };
+
+        put("{\"asset\":{\"version\":\"2.0\",\"generator\":\"WebIfcDotNet\"}");
+        if (!groups.empty())
+            put(",\"extensionsUsed\":[\"EXT_mesh_gpu_instancing\"]");
+
+        put(",\"buffers\":[{\"byteLength\":");
+        integer(binLength);
+        put("}]");
+
+        // Two views per geometry (interleaved vertices, then indices), then three per instance group
+        put(",\"bufferViews\":");
+        list(used.size() * 2 + groups.size() * 3, [&](size_t v)
+        {
+            int64_t offset, length;
+            auto target = 0;
+            auto stride = 0;
+            if (v < used.size() * 2)
+            {
+                auto& g = geometries[used[v / 2]];
+                auto vertexBytes = g.numVertices * (int64_t)VertexStride;
+                offset = byteOffsets[v / 2] + (v % 2 ? vertexBytes : 0);
+                length = v % 2 ? g.numIndices * (int64_t)sizeof(uint32_t) : vertexBytes;
+                target = v % 2 ? 34963 : 34962;
+                stride = v % 2 ? 0 : (int)VertexStride;
+            }
+            else
+            {
+                auto k = v - used.size() * 2;
+                auto& group = groups[k / 3];
+                auto n = (int64_t)group.expressIds.size();
+                int64_t starts[3] = { 0, n * 3, n * 7 };
+                int64_t sizes[3] = { n * 3, n * 4, n * 3 };
+                offset = group.byteOffset + starts[k % 3] * (int64_t)sizeof(float);
+                length = sizes[k % 3] * (int64_t)sizeof(float);
+            }
+            put("{\"buffer\":0,\"byteOffset\":");
+            integer(offset);
+            put(",\"byteLength\":");
+            integer(length);
+            if (stride)
+            {
+                put(",\"byteStride\":");
+                integer(stride);
+            }
+            if (target)
+            {
+                put(",\"target\":");
+                integer(target);
+            }
+            put("}");
+        });
+
+        // Three accessors per geometry (position, normal, indices), then three per instance group
+        put(",\"accessors\":");
+        list(used.size() * 3 + groups.size() * 3, [&](size_t a)
+        {
+            if (a < used.size() * 3)
+            {
+                auto& g = geometries[used[a / 3]];
+                auto view = (int64_t)(a / 3 * 2);
+                switch (a % 3)
+                {
+                case 0:
+                    put("{\"bufferView\":");
+                    integer(view);
+                    put(",\"componentType\":5126,\"type\":\"VEC3\",\"count\":");
+                    integer(g.numVertices);
+                    put(",\"min\":[");
+                    out.Put(Number(g.min[0], true) + "," + Number(g.min[1], true) + "," + Number(g.min[2], true));
+                    put("],\"max\":[");
+                    out.Put(Number(g.max[0], true) + "," + Number(g.max[1], true) + "," + Number(g.max[2], true));
+                    put("]}");
+                    break;
+                case 1:
+                    put("{\"bufferView\":");
+                    integer(view);
+                    put(",\"byteOffset\":12,\"componentType\":5126,\"type\":\"VEC3\",\"count\":");
+                    integer(g.numVertices);
+                    put("}");
+                    break;
+                default:
+                    put("{\"bufferView\":");
+                    integer(view + 1);
+                    put(",\"componentType\":5125,\"type\":\"SCALAR\",\"count\":");
+                    integer(g.numIndices);
+                    put("}");
+                    break;
+                }
+                return;
+            }
+            auto k = a - used.size() * 3;
+            auto& group = groups[k / 3];
+            put("{\"bufferView\":");
+            integer((int64_t)(used.size() * 2 + k));
+            put(",\"componentType\":5126,\"type\":");
+            put(k % 3 == 1 ? "\"VEC4\"" : "\"VEC3\"");
+            put(",\"count\":");
+            integer((int64_t)group.expressIds.size());
+            put("}");
+        });
+
+        put(",\"materials\":");
+        list(materials.size(), [&](size_t i)
+        {
+            auto& c = materials[i];
+            put("{\"pbrMetallicRoughness\":{\"baseColorFactor\":[");
+            num(c[0]); put(","); num(c[1]); put(","); num(c[2]); put(","); num(c[3]);
+            put("],\"metallicFactor\":0,\"roughnessFactor\":1},\"doubleSided\":true");
+            if (c[3] < 1)
+                put(",\"alphaMode\":\"BLEND\"");
+            put("}");
+        });
+
+        put(",\"meshes\":");
+        list(meshes.size(), [&](size_t i)
+        {
+            auto g = (int64_t)meshes[i].first;
+            put("{\"primitives\":[{\"attributes\":{\"POSITION\":");
+            integer(g * 3);
+            put(",\"NORMAL\":");
+            integer(g * 3 + 1);
+            put("},\"indices\":");
+            integer(g * 3 + 2);
+            put(",\"material\":");
+            integer(meshes[i].second);
+            put("}]}");
+        });
+
+        // A node per instance, then a node per instance group
+        std::vector<size_t> nodeInstances;
+        for (size_t i = 0; i < instances.size(); ++i)
+            if (instanceMesh[i] >= 0)
+                nodeInstances.push_back(i);
+        auto numNodes = nodeInstances.size() + groups.size();
+        put(",\"nodes\":");
+        list(numNodes, [&](size_t n)
+        {
+            if (n < nodeInstances.size())
+            {
+                auto& inst = instances[nodeInstances[n]];
+                put("{\"mesh\":");
+                integer(instanceMesh[nodeInstances[n]]);
+                if (!IsIdentity(inst.matrix))
+                {
+                    put(",\"matrix\":");
+                    list(16, [&](size_t k) { num(inst.matrix[k]); });
+                }
+                put(",\"extras\":{\"expressId\":");
+                integer(inst.expressId);
+                put("}}");
+                return;
+            }
+            auto k = n - nodeInstances.size();
+            auto& group = groups[k];
+            auto accessor = (int64_t)(used.size() * 3 + k * 3);
+            put("{\"mesh\":");
+            integer(group.mesh);
+            put(",\"extensions\":{\"EXT_mesh_gpu_instancing\":{\"attributes\":{\"TRANSLATION\":");
+            integer(accessor);
+            put(",\"ROTATION\":");
+            integer(accessor + 1);
+            put(",\"SCALE\":");
+            integer(accessor + 2);
+            put("}}},\"extras\":{\"expressIds\":");
+            list(group.expressIds.size(), [&](size_t i) { integer(group.expressIds[i]); });
+            put("}}");
+        });
+
+        put(",\"scenes\":[{\"nodes\":");
+        list(numNodes, [&](size_t n) { integer((int64_t)n); });
+        put("}],\"scene\":0}");
+    }
+};
@@ -0,0 +1,154 @@
+// Apache 2.0 License
+// Author: Christopher Diggins of Ara 3D Inc for Speckle Systems Ltd.
+// Decodes the GlobalId of every IfcRoot entity into a 128-bit value, and indexes them in both directions.
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <numeric>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "../engine_web-ifc/src/cpp/modelmanager/ModelManager.h"
+
+// A GUID as 16 bytes in the order of its canonical form "xxxxxxxx-xxxx-xxxx-xxxx-xxxxxxxxxxxx",
+// so that byte-wise comparison orders GUIDs as 128-bit numbers.
+// IFC writes a GUID as a 22 digit number in base 64, with the digits 0-9, A-Z, a-z, _ and $:
+// the first digit holds the top 2 bits, and each of the others 6 bits.
+struct IfcGuid
+{
+    uint8_t bytes[16];
+
+    static int Digit(char c)
+    {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'A' && c <= 'Z') return c - 'A' + 10;
+        if (c >= 'a' && c <= 'z') return c - 'a' + 36;
+        if (c == '_') return 62;
+        if (c == '$') return 63;
+        return -1;
+    }
+
+    // Returns false if the text is not a valid compressed GUID
+    static bool Decode(std::string_view s, IfcGuid& g)
+    {
+        if (s.size() != 22 || Digit(s[0]) < 0 || Digit(s[0]) > 3)
+            return false;
+        uint64_t hi = 0, lo = 0;
+        for (auto c : s)
+        {
+            auto d = Digit(c);
+            if (d < 0)
+                return false;
+            hi = hi << 6 | lo >> 58;
+            lo = lo << 6 | (uint64_t)d;
+        }
+        for (int i = 0; i < 8; ++i)
+        {
+            g.bytes[i] = (uint8_t)(hi >> (56 - i * 8));
+            g.bytes[8 + i] = (uint8_t)(lo >> (56 - i * 8));
+        }
+        return true;
+    }
+
+    std::string Encode() const
+    {
+        static const char digits[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz_$";
+        uint64_t hi = 0, lo = 0;
+        for (int i = 0; i < 8; ++i)
+        {
+            hi = hi << 8 | bytes[i];
+            lo = lo << 8 | bytes[8 + i];
+        }
+        std::string r(22, '0');
+        for (int i = 21; i >= 0; --i)
+        {
+            r[i] = digits[lo & 63];
+            lo = lo >> 6 | hi << 58;
+            hi >>= 6;
+        }
+        return r;
+    }
+
+    bool operator==(const IfcGuid& other) const
+    {
+        return std::memcmp(bytes, other.bytes, 16) == 0;
+    }
+
+    bool operator<(const IfcGuid& other) const
+    {
+        return std::memcmp(bytes, other.bytes, 16) < 0;
+    }
+};
+
+// The GlobalId of every line whose first argument is a valid compressed GUID, which is how IfcRoot entities
+// are recognized without inheritance data from the schema. Lookups are binary searches in sorted arrays.
+struct GlobalIdTable
+{
+    std::vector<uint32_t> expressIds;   // ascending
+    std::vector<IfcGuid> guids;         // the GlobalId of each of the express IDs
+    std::vector<uint32_t> guidOrder;    // positions in the arrays above, sorted by GUID then express ID
+    int64_t numDuplicates = 0;          // lines whose GlobalId is also used by a line with a lower express ID
+
+    size_t Size() const { return expressIds.size(); }
+
+    size_t Bytes() const
+    {
+        return expressIds.capacity() * sizeof(uint32_t) + guids.capacity() * sizeof(IfcGuid)
+            + guidOrder.capacity() * sizeof(uint32_t);
+    }
+
+    // Reads the first argument of every line. Only the GUIDs are kept.
+    void Build(webifc::parsing::IfcLoader* loader)
+    {
+        using namespace webifc::parsing;
+
+        auto lines = loader->GetAllLines();
+        std::sort(lines.begin(), lines.end());
+        for (auto id : lines)
+        {
+            loader->MoveToArgumentOffset(id, 0);
+            if (loader->GetTokenType() != IfcTokenType::STRING)
+                continue;
+            loader->StepBack();
+            IfcGuid g;
+            if (!IfcGuid::Decode(loader->GetStringArgument(), g))
+                continue;
+            expressIds.push_back(id);
+            guids.push_back(g);
+        }
+
+        guidOrder.resize(expressIds.size());
+        std::iota(guidOrder.begin(), guidOrder.end(), 0);
+        std::sort(guidOrder.begin(), guidOrder.end(), [&](uint32_t a, uint32_t b)
+        {
+            return guids[a] < guids[b] || (guids[a] == guids[b] && a < b);
+        });
+        for (size_t i = 1; i < guidOrder.size(); ++i)
+            if (guids[guidOrder[i]] == guids[guidOrder[i - 1]])
+                numDuplicates++;
+    }
+
+    // Returns the GlobalId of an express ID, or null if it has none
+    const IfcGuid* FindGuid(uint32_t expressId) const
+    {
+        auto it = std::lower_bound(expressIds.begin(), expressIds.end(), expressId);
+        if (it == expressIds.end() || *it != expressId)
+            return nullptr;
+        return &guids[it - expressIds.begin()];
+    }
+
+    // Returns the express ID with a GlobalId (the lowest one if the GlobalId is used more than once), or 0
+    uint32_t FindExpressId(const IfcGuid& g) const
+    {
+        auto it = std::lower_bound(guidOrder.begin(), guidOrder.end(), g, [&](uint32_t i, const IfcGuid& key)
+        {
+            return guids[i] < key;
+        });
+        if (it == guidOrder.end() || !(guids[*it] == g))
+            return 0;
+        return expressIds[*it];
+    }
+};
@@ -0,0 +1,89 @@
+// Apache 2.0 License
+// Author: Christopher Diggins of Ara 3D Inc for Speckle Systems Ltd.
+// A fast non-cryptographic 64-bit hash, used to detect identical content (e.g. geometry buffers).
+// Callers that merge content based on a hash should still compare the content itself.
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <vector>
+
+class Hasher64
+{
+    static constexpr uint64_t K1 = 0x9E3779B97F4A7C15ull;
+    static constexpr uint64_t K2 = 0xC2B2AE3D27D4EB4Full;
+
+    uint64_t h;
+    uint64_t length = 0;
+
+    static uint64_t RotL(uint64_t x, int r)
+    {
+        return (x << r) | (x >> (64 - r));
+    }
+
+    void AddWord(uint64_t w)
+    {
+        h = RotL(h ^ (w * K2), 31) * K1;
+    }
+
+public:
+
+    explicit Hasher64(uint64_t seed = 0)
+        : h(seed ^ K1)
+    { }
+
+    Hasher64& Add(const void* data, size_t n)
+    {
+        auto p = static_cast<const uint8_t*>(data);
+        length += n;
+        while (n >= 8)
+        {
+            uint64_t w;
+            std::memcpy(&w, p, 8);
+            AddWord(w);
+            p += 8;
+            n -= 8;
+        }
+        if (n > 0)
+        {
+            uint64_t w = 0;
+            std::memcpy(&w, p, n);
+            AddWord(w ^ ((uint64_t)n << 56));
+        }
+        return *this;
+    }
+
+    template<typename T>
+    Hasher64& Add(const std::vector<T>& v)
+    {
+        Add((uint64_t)v.size());
+        return Add(v.data(), v.size() * sizeof(T));
+    }
+
+    Hasher64& Add(std::string_view s)
+    {
+        Add((uint64_t)s.size());
+        return Add(s.data(), s.size());
+    }
+
+    Hasher64& Add(uint64_t x)
+    {
+        length += 8;
+        AddWord(x);
+        return *this;
+    }
+
+    // Final avalanche (from MurmurHash3's fmix64), so that all input bits affect all output bits
+    uint64_t Digest() const
+    {
+        auto x = h ^ length;
+        x ^= x >> 33;
+        x *= 0xFF51AFD7ED558CCDull;
+        x ^= x >> 33;
+        x *= 0xC4CEB9FE1A85EC53ull;
+        x ^= x >> 33;
+        return x;
+    }
+};
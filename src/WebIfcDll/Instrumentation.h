@@ -0,0 +1,199 @@
+// Apache 2.0 License
+// Author: Christopher Diggins of Ara 3D Inc for Speckle Systems Ltd.
+// Always-on counters for the hot paths of a model: tessellation time per IFC type, the slowest elements,
+// triangle and vertex totals, cache hits and bytes allocated. Optionally records a Chrome trace.
+// Counters may be updated from any thread.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Cumulative tessellation counters of one IFC type
+struct TypeStats
+{
+    uint32_t type;
+    int32_t reserved;
+    int64_t elements;
+    int64_t meshes;
+    int64_t vertices;
+    int64_t triangles;
+    double seconds;
+};
+
+// Tessellation of one element
+struct ElementTiming
+{
+    uint32_t expressId;
+    uint32_t type;
+    int64_t triangles;
+    double seconds;
+};
+
+class Instrumentation
+{
+public:
+
+    using Clock = std::chrono::steady_clock;
+
+    // A completed span of work, in microseconds since the instrumentation was created
+    struct TraceEvent
+    {
+        const char* name;
+        uint32_t expressId;
+        uint32_t type;
+        int32_t thread;
+        double start;
+        double duration;
+    };
+
+private:
+
+    Clock::time_point origin = Clock::now();
+    size_t maxSlowest;
+    bool tracing = false;
+
+    mutable std::mutex mutex;
+    std::unordered_map<uint32_t, TypeStats> byType;
+    std::vector<ElementTiming> slowest;     // min-heap on seconds, of at most maxSlowest entries
+    std::vector<TraceEvent> events;
+
+    static bool Slower(const ElementTiming& a, const ElementTiming& b)
+    {
+        return a.seconds > b.seconds;
+    }
+
+    // Small sequential IDs are easier to read in a trace viewer than native thread IDs
+    static int32_t ThreadIndex()
+    {
+        static std::atomic<int32_t> next(0);
+        thread_local int32_t index = next++;
+        return index;
+    }
+
+public:
+
+    std::atomic<int64_t> cacheHits{ 0 };
+    std::atomic<int64_t> cacheMisses{ 0 };
+    std::atomic<int64_t> bytesAllocated{ 0 };
+
+    explicit Instrumentation(size_t maxSlowest = 32)
+        : maxSlowest(maxSlowest)
+    { }
+
+    void EnableTracing(bool enable)
+    {
+        tracing = enable;
+    }
+
+    bool Tracing() const
+    {
+        return tracing;
+    }
+
+    Clock::time_point Now() const
+    {
+        return Clock::now();
+    }
+
+    double Microseconds(Clock::time_point t) const
+    {
+        return std::chrono::duration<double, std::micro>(t - origin).count();
+    }
+
+    // Records a span of work other than the tessellation of an element, e.g. a loading phase
+    void RecordPhase(const char* name, Clock::time_point start)
+    {
+        if (!tracing)
+            return;
+        auto end = Now();
+        std::lock_guard<std::mutex> lock(mutex);
+        events.push_back({ name, 0, 0, ThreadIndex(), Microseconds(start), Microseconds(end) - Microseconds(start) });
+    }
+
+    void RecordElement(uint32_t expressId, uint32_t type, Clock::time_point start, Clock::time_point end, 
+        int64_t meshes, int64_t vertices, int64_t triangles)
+    {
+        auto seconds = std::chrono::duration<double>(end - start).count();
+        std::lock_guard<std::mutex> lock(mutex);
+
+        auto& t = byType[type];
+        t.type = type;
+        t.elements++;
+        t.meshes += meshes;
+        t.vertices += vertices;
+        t.triangles += triangles;
+        t.seconds += seconds;
+
+        if (maxSlowest > 0 && (slowest.size() < maxSlowest || seconds > slowest.front().seconds))
+        {
+            if (slowest.size() == maxSlowest)
+            {
+                std::pop_heap(slowest.begin(), slowest.end(), Slower);
+                slowest.pop_back();
+            }
+            slowest.push_back({ expressId, type, triangles, seconds });
+            std::push_heap(slowest.begin(), slowest.end(), Slower);
+        }
+
+        if (tracing)
+            events.push_back({ "element", expressId, type, ThreadIndex(), Microseconds(start), seconds * 1e6 });
+    }
+
+    // Per-type counters ordered by type code
+    std::vector<TypeStats> Types() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::vector<TypeStats> r;
+        for (auto& kv : byType)
+            r.push_back(kv.second);
+        std::sort(r.begin(), r.end(), [](const TypeStats& a, const TypeStats& b) { return a.type < b.type; });
+        return r;
+    }
+
+    // The slowest elements, slowest first
+    std::vector<ElementTiming> Slowest() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto r = slowest;
+        std::sort(r.begin(), r.end(), Slower);
+        return r;
+    }
+
+    // Writes the recorded events in the Chrome trace event format (chrome://tracing, Perfetto)
+    void WriteTrace(std::ostream& out, const std::function<std::string(uint32_t)>& typeName) const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::unordered_map<uint32_t, std::string> names;
+        auto flags = out.flags();
+        auto precision = out.precision(3);
+        out << std::fixed << "{\"traceEvents\":[";
+        for (size_t i = 0; i < events.size(); ++i)
+        {
+            auto& e = events[i];
+            out << (i ? ",\n" : "\n") << "{\"ph\":\"X\",\"pid\":1,\"tid\":" << e.thread
+                << ",\"ts\":" << e.start << ",\"dur\":" << e.duration;
+            if (e.expressId == 0)
+            {
+                out << ",\"name\":\"" << e.name << "\"}";
+                continue;
+            }
+            auto it = names.find(e.type);
+            if (it == names.end())
+                it = names.emplace(e.type, typeName(e.type)).first;
+            out << ",\"name\":\"" << it->second << "\",\"cat\":\"" << e.name
+                << "\",\"args\":{\"expressId\":" << e.expressId << "}}";
+        }
+        out << "\n]}\n";
+        out.flags(flags);
+        out.precision(precision);
+    }
+};
@@ -0,0 +1,64 @@
+// Apache 2.0 License
+// Author: Christopher Diggins of Ara 3D Inc for Speckle Systems Ltd.
+// A fixed set of worker threads running independent jobs (e.g. loading one model each) in submission order.
+// Unlike WorkStealingPool, which splits one task over all cores and blocks the caller,
+// jobs are submitted from any thread and the caller waits on the returned future when it needs the result.
+
+#pragma once
+
+#include <algorithm>
+#include <functional>
+#include <future>
+#include <limits>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "BoundedQueue.h"
+
+class JobQueue
+{
+    BoundedQueue<std::function<void()>> jobs;
+    std::vector<std::thread> workers;
+
+public:
+
+    explicit JobQueue(size_t numWorkers)
+        : jobs(std::numeric_limits<size_t>::max())
+    {
+        for (size_t i = 0; i < std::max<size_t>(numWorkers, 1); ++i)
+        {
+            workers.emplace_back([this]()
+            {
+                std::function<void()> job;
+                while (jobs.Pop(job))
+                    job();
+            });
+        }
+    }
+
+    // Runs the jobs already submitted, then stops the workers
+    ~JobQueue()
+    {
+        jobs.Close();
+        for (auto& w : workers)
+            w.join();
+    }
+
+    JobQueue(const JobQueue&) = delete;
+    JobQueue& operator=(const JobQueue&) = delete;
+
+    size_t NumWorkers() const
+    {
+        return workers.size();
+    }
+
+    // Queues f to run on a worker. An exception thrown by f is rethrown by the future.
+    template<typename F>
+    auto Submit(F f) -> std::future<decltype(f())>
+    {
+        auto task = std::make_shared<std::packaged_task<decltype(f())()>>(std::move(f));
+        auto result = task->get_future();
+        jobs.Push([task]() { (*task)(); });
+        return result;
+    }
+};
@@ -0,0 +1,199 @@
+// Apache 2.0 License
+// Author: Christopher Diggins of Ara 3D Inc for Speckle Systems Ltd.
+// Decodes the arguments of many IFC lines into a flat columnar table in one pass over the token stream.
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "../engine_web-ifc/src/cpp/modelmanager/ModelManager.h"
+
+// The kind of each value in a LineTable
+enum LineValueTag : uint8_t
+{
+    LineValueEmpty = 0,     // value is 0
+    LineValueInteger = 1,   // value is the integer
+    LineValueReal = 2,      // value is an index into reals
+    LineValueRef = 3,       // value is an express ID
+    LineValueString = 4,    // value is an index into the string pool (decoded to UTF-8)
+    LineValueEnum = 5,      // value is an index into the string pool
+    LineValueLabel = 6,     // value is an index into the string pool. It is always followed by a set of arguments.
+    LineValueSet = 7,       // value is the index one past its last descendant. Its children follow it.
+};
+
+// The arguments of a group of lines, stored as a pre-order sequence of tagged values.
+// The values of line i are in [lineOffsets[i], lineOffsets[i + 1]).
+// String i is in stringData, in [stringOffsets[i], stringOffsets[i + 1]). Strings are interned.
+struct LineTable
+{
+    std::vector<uint32_t> lineIds;
+    std::vector<uint32_t> lineTypes;
+    std::vector<uint32_t> lineOffsets = { 0 };
+    std::vector<uint8_t> tags;
+    std::vector<int64_t> values;
+    std::vector<double> reals;
+    std::vector<uint32_t> stringOffsets = { 0 };
+    std::vector<char> stringData;
+    std::unordered_map<std::string, uint32_t> stringLookup;
+
+    size_t NumLines() const { return lineIds.size(); }
+    size_t NumStrings() const { return stringOffsets.size() - 1; }
+
+    // Approximate heap bytes, counting the string lookup as one string and entry per pooled string
+    size_t Bytes() const
+    {
+        return lineIds.capacity() * sizeof(uint32_t) + lineTypes.capacity() * sizeof(uint32_t)
+            + lineOffsets.capacity() * sizeof(uint32_t) + tags.capacity() + values.capacity() * sizeof(int64_t)
+            + reals.capacity() * sizeof(double) + stringOffsets.capacity() * sizeof(uint32_t) + stringData.capacity()
+            + stringLookup.size() * (sizeof(std::string) + sizeof(uint32_t) + 2 * sizeof(void*)) + stringData.size();
+    }
+
+    std::string_view GetString(size_t i) const
+    {
+        return std::string_view(stringData.data() + stringOffsets[i], stringOffsets[i + 1] - stringOffsets[i]);
+    }
+
+    void Decode(webifc::parsing::IfcLoader* loader, uint32_t expressId)
+    {
+        lineIds.push_back(expressId);
+        lineTypes.push_back(loader->GetLineType(expressId));
+        loader->MoveToArgumentOffset(expressId, 0);
+        DecodeArguments(loader);
+        lineOffsets.push_back((uint32_t)tags.size());
+    }
+
+    template<typename Ids>
+    void Decode(webifc::parsing::IfcLoader* loader, const Ids& expressIds)
+    {
+        for (auto id : expressIds)
+            Decode(loader, id);
+    }
+
+    // Returns the index of the value following value i and all of its descendants
+    size_t NextSibling(size_t i) const
+    {
+        switch (tags[i])
+        {
+        case LineValueSet: return (size_t)values[i];
+        case LineValueLabel: return (size_t)values[i + 1];
+        default: return i + 1;
+        }
+    }
+
+    // Returns the index of the value of an argument of a line, or the end of the line if there are fewer arguments
+    size_t ArgumentIndex(size_t line, size_t arg) const
+    {
+        size_t i = lineOffsets[line];
+        size_t end = lineOffsets[line + 1];
+        for (; i < end && arg > 0; --arg)
+            i = NextSibling(i);
+        return i;
+    }
+
+    // Calls f with the express ID of an argument that is a reference, 
+    // or with each express ID of an argument that is a set of references
+    template<typename F>
+    void ForEachRef(size_t line, size_t arg, F f) const
+    {
+        auto i = ArgumentIndex(line, arg);
+        if (i >= lineOffsets[line + 1])
+            return;
+        if (tags[i] == LineValueRef)
+            f((uint32_t)values[i]);
+        else if (tags[i] == LineValueSet)
+            for (auto j = i + 1; j < (size_t)values[i]; j = NextSibling(j))
+                if (tags[j] == LineValueRef)
+                    f((uint32_t)values[j]);
+    }
+
+private:
+
+    size_t Push(LineValueTag tag, int64_t value)
+    {
+        tags.push_back(tag);
+        values.push_back(value);
+        return tags.size() - 1;
+    }
+
+    uint32_t Intern(std::string_view s)
+    {
+        auto [it, inserted] = stringLookup.try_emplace(std::string(s), (uint32_t)NumStrings());
+        if (inserted)
+        {
+            stringData.insert(stringData.end(), s.begin(), s.end());
+            stringOffsets.push_back((uint32_t)stringData.size());
+        }
+        return it->second;
+    }
+
+    // Follows the same token handling as DotNetApi::GetArgs.
+    // Reads values until the end of the line or of the enclosing set.
+    void DecodeArguments(webifc::parsing::IfcLoader* loader)
+    {
+        using namespace webifc::parsing;
+
+        while (!loader->IsAtEnd())
+        {
+            try
+            {
+                switch (loader->GetTokenType())
+                {
+                case IfcTokenType::LINE_END:
+                case IfcTokenType::SET_END:
+                    return;
+                case IfcTokenType::EMPTY:
+                    Push(LineValueEmpty, 0);
+                    break;
+                case IfcTokenType::SET_BEGIN:
+                {
+                    auto set = Push(LineValueSet, 0);
+                    DecodeArguments(loader);
+                    values[set] = (int64_t)tags.size();
+                    break;
+                }
+                case IfcTokenType::LABEL:
+                {
+                    loader->StepBack();
+                    Push(LineValueLabel, Intern(loader->GetStringArgument()));
+                    // Skips the SET_BEGIN of the label's arguments
+                    loader->GetTokenType();
+                    auto set = Push(LineValueSet, 0);
+                    DecodeArguments(loader);
+                    values[set] = (int64_t)tags.size();
+                    break;
+                }
+                case IfcTokenType::STRING:
+                    loader->StepBack();
+                    Push(LineValueString, Intern(loader->GetDecodedStringArgument()));
+                    break;
+                case IfcTokenType::ENUM:
+                    loader->StepBack();
+                    Push(LineValueEnum, Intern(loader->GetStringArgument()));
+                    break;
+                case IfcTokenType::REAL:
+                    loader->StepBack();
+                    Push(LineValueReal, (int64_t)reals.size());
+                    reals.push_back(loader->GetDoubleArgument());
+                    break;
+                case IfcTokenType::INTEGER:
+                    loader->StepBack();
+                    Push(LineValueInteger, loader->GetIntArgument());
+                    break;
+                case IfcTokenType::REF:
+                    loader->StepBack();
+                    Push(LineValueRef, loader->GetRefArgument());
+                    break;
+                default:
+                    break;
+                }
+            }
+            catch (const std::exception&)
+            {
+                // Same as GetArgs: a token that fails to parse (e.g. an integer written as "1.") is skipped
+            }
+        }
+    }
+};
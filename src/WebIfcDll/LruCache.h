@@ -0,0 +1,105 @@
+// Apache 2.0 License
+// Author: Christopher Diggins of Ara 3D Inc for Speckle Systems Ltd.
+// A least-recently-used cache with a memory budget, used for lazily tessellated geometry.
+
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <unordered_map>
+
+// Maps keys to owned values, and tracks the approximate number of bytes held by each value.
+// When an insertion pushes the total over the budget, the least recently used entries are evicted.
+// The most recently inserted entry is never evicted, so a single value larger than the budget
+// can still be returned to the caller. A budget of zero means the cache is unbounded.
+template<typename K, typename V>
+class LruCache
+{
+    struct Entry
+    {
+        K key;
+        std::unique_ptr<V> value;
+        size_t bytes;
+    };
+
+    std::list<Entry> entries;
+    std::unordered_map<K, typename std::list<Entry>::iterator> lookup;
+    size_t budget;
+    size_t used = 0;
+
+public:
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+
+    explicit LruCache(size_t budget = 0)
+        : budget(budget)
+    { }
+
+    void SetBudget(size_t bytes)
+    {
+        budget = bytes;
+        Trim();
+    }
+
+    size_t Budget() const { return budget; }
+    size_t Bytes() const { return used; }
+    size_t Count() const { return entries.size(); }
+
+    // Returns the value for the key and marks it as most recently used, or nullptr if absent.
+    V* Find(const K& key)
+    {
+        auto it = lookup.find(key);
+        if (it == lookup.end())
+        {
+            misses++;
+            return nullptr;
+        }
+        hits++;
+        entries.splice(entries.begin(), entries, it->second);
+        return it->second->value.get();
+    }
+
+    // Takes ownership of a value, evicting older entries if the budget is exceeded.
+    V* Insert(const K& key, std::unique_ptr<V> value, size_t bytes)
+    {
+        Erase(key);
+        entries.push_front(Entry{ key, std::move(value), bytes });
+        lookup[key] = entries.begin();
+        used += bytes;
+        Trim();
+        return entries.front().value.get();
+    }
+
+    void Erase(const K& key)
+    {
+        auto it = lookup.find(key);
+        if (it == lookup.end())
+            return;
+        used -= it->second->bytes;
+        entries.erase(it->second);
+        lookup.erase(it);
+    }
+
+    void Clear()
+    {
+        entries.clear();
+        lookup.clear();
+        used = 0;
+    }
+
+private:
+
+    void Trim()
+    {
+        while (budget != 0 && used > budget && entries.size() > 1)
+        {
+            auto& last = entries.back();
+            used -= last.bytes;
+            lookup.erase(last.key);
+            entries.pop_back();
+            evictions++;
+        }
+    }
+};
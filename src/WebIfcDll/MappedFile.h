@@ -0,0 +1,164 @@
+// Apache 2.0 License
+// Author: Christopher Diggins of Ara 3D Inc for Speckle Systems Ltd.
+// Read-only memory mapping of a file, and loading of an IFC loader from memory.
+// The file is mapped in binary mode, so no line-ending translation happens,
+// and paths are treated as UTF-8 (or UTF-16 on Windows).
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+class MappedFile
+{
+    const char* data = nullptr;
+    size_t size = 0;
+
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+#endif
+
+public:
+
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile()
+    {
+        Close();
+    }
+
+    const char* Data() const { return data; }
+    size_t Size() const { return size; }
+
+#ifdef _WIN32
+    // Opens a file given a UTF-8 path. Returns false if the file cannot be opened or mapped.
+    bool Open(const char* utf8Path)
+    {
+        auto n = MultiByteToWideChar(CP_UTF8, 0, utf8Path, -1, nullptr, 0);
+        if (n <= 0)
+            return false;
+        std::wstring path(n, L'\0');
+        MultiByteToWideChar(CP_UTF8, 0, utf8Path, -1, &path[0], n);
+        return Open(path.c_str());
+    }
+
+    bool Open(const wchar_t* path)
+    {
+        Close();
+        file = CreateFileW(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+            return false;
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(file, &fileSize))
+        {
+            Close();
+            return false;
+        }
+        size = (size_t)fileSize.QuadPart;
+        if (size == 0)
+            return true;
+        mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!mapping)
+        {
+            Close();
+            return false;
+        }
+        data = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+        if (!data)
+        {
+            Close();
+            return false;
+        }
+        return true;
+    }
+
+    void Close()
+    {
+        if (data)
+            UnmapViewOfFile(data);
+        if (mapping)
+            CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE)
+            CloseHandle(file);
+        data = nullptr;
+        mapping = nullptr;
+        file = INVALID_HANDLE_VALUE;
+        size = 0;
+    }
+#else
+    // Opens a file given a UTF-8 path. Returns false if the file cannot be opened or mapped.
+    bool Open(const char* path)
+    {
+        Close();
+        auto fd = ::open(path, O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0)
+        {
+            ::close(fd);
+            return false;
+        }
+        size = (size_t)st.st_size;
+        if (size > 0)
+        {
+            auto p = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p == MAP_FAILED)
+            {
+                ::close(fd);
+                size = 0;
+                return false;
+            }
+            madvise(p, size, MADV_SEQUENTIAL);
+            data = static_cast<const char*>(p);
+        }
+        ::close(fd);
+        return true;
+    }
+
+    void Close()
+    {
+        if (data)
+            munmap(const_cast<char*>(data), size);
+        data = nullptr;
+        size = 0;
+    }
+#endif
+};
+
+// Loads an IFC loader from a block of memory, through the loader's data request callback.
+// The token stream pulls its chunks directly from the memory (e.g. mapped pages)
+// rather than from a stream. It may request chunks again later if it unloads them,
+// so the memory must remain valid for the lifetime of the loader.
+template<typename Loader>
+void LoadFromMemory(Loader* loader, const char* data, size_t size)
+{
+    loader->LoadFile([data, size](char* dest, size_t sourceOffset, size_t destSize) -> uint32_t
+    {
+        if (sourceOffset >= size)
+            return 0;
+        auto n = std::min(destSize, size - sourceOffset);
+        std::memcpy(dest, data + sourceOffset, n);
+        return (uint32_t)n;
+    });
+}
@@ -0,0 +1,292 @@
+// Apache 2.0 License
+// Author: Christopher Diggins of Ara 3D Inc for Speckle Systems Ltd.
+// Post-processing of tessellated meshes for smaller and faster GPU buffers: welding duplicate vertices,
+// removing degenerate triangles, ordering triangles for the post-transform vertex cache,
+// and ordering vertices by first use for fetch locality.
+// It works on the engine vertex layout: position and normal as 6 doubles, and indexed triangles.
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "Hashing.h"
+
+namespace MeshOptimizer
+{
+    // Merges vertices whose positions are within positionTolerance of each other (per axis), and whose normals
+    // differ by at most normalTolerance radians. Each vertex joins the first earlier vertex that matches.
+    // Rewrites the indices and returns the welded vertices. Zero tolerances merge identical values only.
+    inline std::vector<double> WeldVertices(const std::vector<double>& vertices, std::vector<uint32_t>& indices,
+        double positionTolerance, double normalTolerance)
+    {
+        auto numVertices = vertices.size() / 6;
+        auto minDot = std::cos(std::max(normalTolerance, 0.0));
+        auto cellSize = std::max(positionTolerance, 0.0);
+
+        // Vertices are bucketed in a grid of cells the size of the tolerance,
+        // so a match is always in the same cell as the vertex or in one of its neighbors
+        auto cellOf = [&](const double* p, int64_t* cell)
+        {
+            for (int r = 0; r < 3; ++r)
+                cell[r] = cellSize > 0 ? (int64_t)std::floor(p[r] / cellSize) : 0;
+        };
+        auto cellKey = [&](const int64_t* cell, const double* p)
+        {
+            Hasher64 h;
+            if (cellSize > 0)
+            {
+                h.Add(cell, 3 * sizeof(int64_t));
+            }
+            else
+            {
+                // Adding zero turns -0.0 into 0.0, which compares equal to it
+                double normalized[3] = { p[0] + 0.0, p[1] + 0.0, p[2] + 0.0 };
+                h.Add(normalized, sizeof(normalized));
+            }
+            return h.Digest();
+        };
+
+        std::unordered_map<uint64_t, std::vector<uint32_t>> cells;
+        std::vector<uint32_t> remap(numVertices);
+        std::vector<double> r;
+        for (size_t v = 0; v < numVertices; ++v)
+        {
+            auto p = vertices.data() + v * 6;
+            int64_t cell[3];
+            cellOf(p, cell);
+            auto found = std::numeric_limits<uint32_t>::max();
+            auto range = cellSize > 0 ? 1 : 0;
+            for (int dx = -range; dx <= range && found == std::numeric_limits<uint32_t>::max(); ++dx)
+            for (int dy = -range; dy <= range && found == std::numeric_limits<uint32_t>::max(); ++dy)
+            for (int dz = -range; dz <= range && found == std::numeric_limits<uint32_t>::max(); ++dz)
+            {
+                int64_t neighbor[3] = { cell[0] + dx, cell[1] + dy, cell[2] + dz };
+                auto it = cells.find(cellKey(neighbor, p));
+                if (it == cells.end())
+                    continue;
+                for (auto w : it->second)
+                {
+                    auto q = r.data() + (size_t)w * 6;
+                    if (std::abs(p[0] - q[0]) <= cellSize && std::abs(p[1] - q[1]) <= cellSize && std::abs(p[2] - q[2]) <= cellSize
+                        && p[3] * q[3] + p[4] * q[4] + p[5] * q[5] >= minDot - 1e-12)
+                    {
+                        found = w;
+                        break;
+                    }
+                }
+            }
+            if (found == std::numeric_limits<uint32_t>::max())
+            {
+                found = (uint32_t)(r.size() / 6);
+                r.insert(r.end(), p, p + 6);
+                cells[cellKey(cell, p)].push_back(found);
+            }
+            remap[v] = found;
+        }
+        for (auto& i : indices)
+            i = remap[i];
+        return r;
+    }
+
+    // Removes triangles that use the same vertex twice
+    inline void RemoveDegenerateTriangles(std::vector<uint32_t>& indices)
+    {
+        size_t n = 0;
+        for (size_t i = 0; i + 2 < indices.size(); i += 3)
+        {
+            auto a = indices[i], b = indices[i + 1], c = indices[i + 2];
+            if (a == b || b == c || a == c)
+                continue;
+            indices[n++] = a;
+            indices[n++] = b;
+            indices[n++] = c;
+        }
+        indices.resize(n);
+    }
+
+    // Reorders triangles so that consecutive triangles share vertices, using Tom Forsyth's
+    // "Linear-Speed Vertex Cache Optimisation": each vertex is scored by its position in a simulated LRU cache
+    // and by how many triangles still use it, and the triangle with the highest total score is emitted next.
+    inline void OptimizeVertexCache(std::vector<uint32_t>& indices, size_t numVertices)
+    {
+        const int CacheSize = 32;
+        const double DecayPower = 1.5;
+        const double LastTriangleScore = 0.75;
+        const double ValenceScale = 2.0;
+        const double ValencePower = 0.5;
+
+        auto numTriangles = indices.size() / 3;
+        if (numTriangles == 0)
+            return;
+
+        // Triangles of each vertex, in CSR form
+        std::vector<uint32_t> offsets(numVertices + 1, 0);
+        for (auto i : indices)
+            offsets[i + 1]++;
+        for (size_t v = 0; v < numVertices; ++v)
+            offsets[v + 1] += offsets[v];
+        std::vector<uint32_t> vertexTriangles(indices.size());
+        std::vector<uint32_t> next(offsets.begin(), offsets.end() - 1);
+        for (size_t i = 0; i < indices.size(); ++i)
+            vertexTriangles[next[indices[i]]++] = (uint32_t)(i / 3);
+
+        std::vector<uint32_t> remaining(numVertices);
+        for (size_t v = 0; v < numVertices; ++v)
+            remaining[v] = offsets[v + 1] - offsets[v];
+        std::vector<int> cachePosition(numVertices, -1);
+
+        auto vertexScore = [&](uint32_t v)
+        {
+            if (remaining[v] == 0)
+                return -1.0;
+            double score = 0;
+            auto pos = cachePosition[v];
+            if (pos >= 0)
+            {
+                if (pos < 3)
+                    score = LastTriangleScore;
+                else
+                    score = std::pow(1.0 - (double)(pos - 3) / (CacheSize - 3), DecayPower);
+            }
+            return score + ValenceScale * std::pow((double)remaining[v], -ValencePower);
+        };
+
+        std::vector<double> vertexScores(numVertices);
+        for (size_t v = 0; v < numVertices; ++v)
+            vertexScores[v] = vertexScore((uint32_t)v);
+        std::vector<double> triangleScores(numTriangles);
+        std::vector<bool> emitted(numTriangles, false);
+        for (size_t t = 0; t < numTriangles; ++t)
+            triangleScores[t] = vertexScores[indices[t * 3]] + vertexScores[indices[t * 3 + 1]] + vertexScores[indices[t * 3 + 2]];
+
+        std::vector<uint32_t> result;
+        result.reserve(indices.size());
+
+        // The simulated cache, and the next one being built, in fixed buffers swapped after each triangle
+        uint32_t cacheBuffers[2][CacheSize + 3];
+        uint32_t* cache = cacheBuffers[0];
+        uint32_t* newCache = cacheBuffers[1];
+        size_t cacheSize = 0;
+
+        // When no cached vertex has a triangle left, the next triangle is taken from the most recently 
+        // emitted vertices that still have one (the dead-end stack), or else the first triangle not yet emitted.
+        // The stack only holds pushes of emitted vertices and the cursor only moves forward,
+        // so the fallback costs amortized constant time rather than a scan of the remaining triangles.
+        std::vector<uint32_t> deadEnds;
+        deadEnds.reserve(indices.size());
+        size_t cursor = 0;
+        auto best = std::numeric_limits<size_t>::max();
+
+        while (result.size() < indices.size())
+        {
+            while (best == std::numeric_limits<size_t>::max() && !deadEnds.empty())
+            {
+                auto v = deadEnds.back();
+                deadEnds.pop_back();
+                if (remaining[v] == 0)
+                    continue;
+                double bestScore = -1;
+                for (auto j = offsets[v]; j < offsets[v + 1]; ++j)
+                {
+                    auto t = vertexTriangles[j];
+                    if (!emitted[t] && triangleScores[t] > bestScore)
+                    {
+                        bestScore = triangleScores[t];
+                        best = t;
+                    }
+                }
+            }
+            if (best == std::numeric_limits<size_t>::max())
+            {
+                while (emitted[cursor])
+                    cursor++;
+                best = cursor;
+            }
+
+            emitted[best] = true;
+            size_t newCacheSize = 0;
+            for (int k = 0; k < 3; ++k)
+            {
+                auto v = indices[best * 3 + k];
+                result.push_back(v);
+                remaining[v]--;
+                deadEnds.push_back(v);
+                newCache[newCacheSize++] = v;
+            }
+            for (size_t i = 0; i < cacheSize; ++i)
+                if (std::find(newCache, newCache + 3, cache[i]) == newCache + 3)
+                    newCache[newCacheSize++] = cache[i];
+            for (size_t i = 0; i < cacheSize; ++i)
+                cachePosition[cache[i]] = -1;
+            for (size_t i = 0; i < newCacheSize; ++i)
+                cachePosition[newCache[i]] = i < (size_t)CacheSize ? (int)i : -1;
+
+            // Rescore the vertices that were in the cache, and their triangles
+            best = std::numeric_limits<size_t>::max();
+            double bestScore = -1;
+            for (size_t i = 0; i < newCacheSize; ++i)
+                vertexScores[newCache[i]] = vertexScore(newCache[i]);
+            for (size_t i = 0; i < newCacheSize; ++i)
+            {
+                auto v = newCache[i];
+                for (auto j = offsets[v]; j < offsets[v + 1]; ++j)
+                {
+                    auto t = vertexTriangles[j];
+                    if (emitted[t])
+                        continue;
+                    triangleScores[t] = vertexScores[indices[t * 3]] + vertexScores[indices[t * 3 + 1]] + vertexScores[indices[t * 3 + 2]];
+                    if (triangleScores[t] > bestScore)
+                    {
+                        bestScore = triangleScores[t];
+                        best = t;
+                    }
+                }
+            }
+            std::swap(cache, newCache);
+            cacheSize = std::min(newCacheSize, (size_t)CacheSize);
+        }
+        indices = std::move(result);
+    }
+
+    // Renumbers vertices in order of first use, dropping unused ones, so vertex fetches follow the index order
+    inline std::vector<double> OptimizeVertexFetch(const std::vector<double>& vertices, std::vector<uint32_t>& indices)
+    {
+        std::vector<uint32_t> remap(vertices.size() / 6, std::numeric_limits<uint32_t>::max());
+        std::vector<double> r;
+        for (auto& i : indices)
+        {
+            if (remap[i] == std::numeric_limits<uint32_t>::max())
+            {
+                remap[i] = (uint32_t)(r.size() / 6);
+                r.insert(r.end(), vertices.begin() + (size_t)i * 6, vertices.begin() + (size_t)i * 6 + 6);
+            }
+            i = remap[i];
+        }
+        return r;
+    }
+
+    // Average number of vertices transformed per triangle with a FIFO post-transform cache of the given size.
+    // 3 means no reuse, and 0.5 is the ideal for a large regular grid.
+    inline double AverageCacheMissRatio(const std::vector<uint32_t>& indices, size_t numVertices, size_t cacheSize = 16)
+    {
+        if (indices.empty())
+            return 0;
+        std::vector<size_t> timestamps(numVertices, 0);
+        size_t misses = 0;
+        for (auto i : indices)
+        {
+            // A vertex is still cached if fewer than cacheSize misses happened since it was loaded
+            if (timestamps[i] == 0 || misses - timestamps[i] + 1 > cacheSize)
+            {
+                misses++;
+                timestamps[i] = misses;
+            }
+        }
+        return (double)misses / (indices.size() / 3);
+    }
+}
@@ -0,0 +1,374 @@
+// Apache 2.0 License
+// Author: Christopher Diggins of Ara 3D Inc for Speckle Systems Ltd.
+// Quadric error mesh simplification (Garland and Heckbert), used to build levels of detail.
+// It works on the engine vertex layout: position and normal as 6 doubles, and indexed triangles.
+// A simplifier works on one mesh on one thread. Callers simplify different meshes in parallel.
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <queue>
+#include <unordered_map>
+#include <vector>
+#include "Hashing.h"
+
+// The sum of squared distances to a set of planes, each weighted by the area of the triangle it came from.
+// Dividing by the total weight gives the mean squared distance, so errors are comparable across meshes.
+struct Quadric
+{
+    double a00 = 0, a01 = 0, a02 = 0, a11 = 0, a12 = 0, a22 = 0;
+    double b0 = 0, b1 = 0, b2 = 0;
+    double c = 0;
+    double weight = 0;
+
+    // The plane is n.x + d = 0 with n of unit length
+    static Quadric FromPlane(const double* n, double d, double w)
+    {
+        Quadric q;
+        q.a00 = w * n[0] * n[0]; q.a01 = w * n[0] * n[1]; q.a02 = w * n[0] * n[2];
+        q.a11 = w * n[1] * n[1]; q.a12 = w * n[1] * n[2]; q.a22 = w * n[2] * n[2];
+        q.b0 = w * n[0] * d; q.b1 = w * n[1] * d; q.b2 = w * n[2] * d;
+        q.c = w * d * d;
+        q.weight = w;
+        return q;
+    }
+
+    void Add(const Quadric& q)
+    {
+        a00 += q.a00; a01 += q.a01; a02 += q.a02; a11 += q.a11; a12 += q.a12; a22 += q.a22;
+        b0 += q.b0; b1 += q.b1; b2 += q.b2;
+        c += q.c;
+        weight += q.weight;
+    }
+
+    // Mean squared distance of p to the planes
+    double Error(const double* p) const
+    {
+        auto x = p[0], y = p[1], z = p[2];
+        auto e = a00 * x * x + 2 * a01 * x * y + 2 * a02 * x * z + a11 * y * y + 2 * a12 * y * z + a22 * z * z
+            + 2 * (b0 * x + b1 * y + b2 * z) + c;
+        return weight > 0 ? std::max(e, 0.0) / weight : 0;
+    }
+};
+
+// Collapses edges in order of increasing quadric error. Each collapse moves a vertex onto one of its neighbors,
+// so the result reuses the input vertices and only the index buffer changes.
+// The engine splits vertices where normals differ, so the connectivity is found by welding vertices with identical
+// positions, and a moved corner takes the vertex of its new position whose normal is closest to its own.
+// Vertices on open or non-manifold edges are never moved, which preserves the outline of the mesh,
+// and collapses that would flip a triangle are rejected.
+class MeshSimplifier
+{
+    static constexpr uint32_t None = std::numeric_limits<uint32_t>::max();
+
+    const double* vertices;
+    size_t numVertices;
+
+    std::vector<uint32_t> welded;                   // vertex -> first vertex with the same position
+    std::vector<std::vector<uint32_t>> members;     // welded vertex -> vertices with its position
+    std::vector<std::vector<uint32_t>> triangles;   // welded vertex -> triangles using it, possibly removed
+    std::vector<uint32_t> corners;                  // current vertex of every triangle corner
+    std::vector<bool> removedTriangles;
+    std::vector<bool> removedVertices;
+    std::vector<bool> locked;
+    std::vector<Quadric> quadrics;
+    std::vector<uint32_t> versions;
+    size_t numTriangles = 0;
+
+    struct Candidate
+    {
+        double cost;
+        uint32_t from;
+        uint32_t to;
+        uint32_t version;
+
+        bool operator>(const Candidate& other) const
+        {
+            return cost > other.cost;
+        }
+    };
+
+    std::priority_queue<Candidate, std::vector<Candidate>, std::greater<Candidate>> heap;
+
+    const double* Position(uint32_t v) const
+    {
+        return vertices + (size_t)v * 6;
+    }
+
+    static void Normal(const double* a, const double* b, const double* c, double* n)
+    {
+        double u[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+        double w[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+        n[0] = u[1] * w[2] - u[2] * w[1];
+        n[1] = u[2] * w[0] - u[0] * w[2];
+        n[2] = u[0] * w[1] - u[1] * w[0];
+    }
+
+    uint32_t Welded(uint32_t corner) const
+    {
+        return welded[corners[corner]];
+    }
+
+    bool Contains(uint32_t t, uint32_t w) const
+    {
+        return Welded(t * 3) == w || Welded(t * 3 + 1) == w || Welded(t * 3 + 2) == w;
+    }
+
+    // True if moving `from` onto `to` would turn any remaining triangle around `from` upside down
+    bool Flips(uint32_t from, uint32_t to) const
+    {
+        for (auto t : triangles[from])
+        {
+            if (removedTriangles[t] || Contains(t, to))
+                continue;
+            const double* p[3];
+            const double* q[3];
+            for (int k = 0; k < 3; ++k)
+            {
+                auto w = Welded(t * 3 + k);
+                p[k] = Position(w);
+                q[k] = w == from ? Position(to) : p[k];
+            }
+            double before[3], after[3];
+            Normal(p[0], p[1], p[2], before);
+            Normal(q[0], q[1], q[2], after);
+            if (before[0] * after[0] + before[1] * after[1] + before[2] * after[2] <= 0)
+                return true;
+        }
+        return false;
+    }
+
+    // Queues the cheapest valid collapse of a vertex onto one of its neighbors
+    void Update(uint32_t from)
+    {
+        versions[from]++;
+        if (locked[from] || removedVertices[from])
+            return;
+        Candidate best = { std::numeric_limits<double>::max(), from, None, versions[from] };
+        for (auto t : triangles[from])
+        {
+            if (removedTriangles[t])
+                continue;
+            for (int k = 0; k < 3; ++k)
+            {
+                auto to = Welded(t * 3 + k);
+                if (to == from || to == best.to)
+                    continue;
+                auto q = quadrics[from];
+                q.Add(quadrics[to]);
+                auto cost = q.Error(Position(to));
+                if (cost < best.cost && !Flips(from, to))
+                {
+                    best.cost = cost;
+                    best.to = to;
+                }
+            }
+        }
+        if (best.to != None)
+            heap.push(best);
+    }
+
+    // Of the vertices at a welded position, the one whose normal is closest to the given vertex's
+    uint32_t ClosestMember(uint32_t w, uint32_t v) const
+    {
+        auto n = vertices + (size_t)v * 6 + 3;
+        auto best = members[w][0];
+        auto bestDot = -std::numeric_limits<double>::max();
+        for (auto m : members[w])
+        {
+            auto mn = vertices + (size_t)m * 6 + 3;
+            auto dot = n[0] * mn[0] + n[1] * mn[1] + n[2] * mn[2];
+            if (dot > bestDot)
+            {
+                bestDot = dot;
+                best = m;
+            }
+        }
+        return best;
+    }
+
+    void Collapse(uint32_t from, uint32_t to)
+    {
+        for (auto t : triangles[from])
+        {
+            if (removedTriangles[t])
+                continue;
+            if (Contains(t, to))
+            {
+                removedTriangles[t] = true;
+                numTriangles--;
+                continue;
+            }
+            for (int k = 0; k < 3; ++k)
+                if (Welded(t * 3 + k) == from)
+                    corners[t * 3 + k] = ClosestMember(to, corners[t * 3 + k]);
+            triangles[to].push_back(t);
+        }
+        triangles[from].clear();
+        removedVertices[from] = true;
+        quadrics[to].Add(quadrics[from]);
+
+        // Drop removed triangles, and update the collapse of every vertex around the one that grew
+        auto& around = triangles[to];
+        around.erase(std::remove_if(around.begin(), around.end(), [&](uint32_t t) { return removedTriangles[t]; }), around.end());
+        std::vector<uint32_t> neighbors;
+        for (auto t : around)
+            for (int k = 0; k < 3; ++k)
+                neighbors.push_back(Welded(t * 3 + k));
+        std::sort(neighbors.begin(), neighbors.end());
+        neighbors.erase(std::unique(neighbors.begin(), neighbors.end()), neighbors.end());
+        for (auto w : neighbors)
+            Update(w);
+    }
+
+    void Weld()
+    {
+        struct PositionHash
+        {
+            const double* vertices;
+            // Adding zero turns -0.0 into 0.0, so that positions equal under PositionEqual hash the same
+            size_t operator()(uint32_t v) const
+            {
+                auto p = vertices + (size_t)v * 6;
+                double normalized[3] = { p[0] + 0.0, p[1] + 0.0, p[2] + 0.0 };
+                return (size_t)Hasher64().Add(normalized, sizeof(normalized)).Digest();
+            }
+        };
+        struct PositionEqual
+        {
+            const double* vertices;
+            bool operator()(uint32_t a, uint32_t b) const
+            {
+                auto p = vertices + (size_t)a * 6;
+                auto q = vertices + (size_t)b * 6;
+                return p[0] == q[0] && p[1] == q[1] && p[2] == q[2];
+            }
+        };
+        std::unordered_map<uint32_t, uint32_t, PositionHash, PositionEqual> first(
+            numVertices, PositionHash{ vertices }, PositionEqual{ vertices });
+        welded.resize(numVertices);
+        members.resize(numVertices);
+        for (uint32_t v = 0; v < numVertices; ++v)
+        {
+            welded[v] = first.emplace(v, v).first->second;
+            members[welded[v]].push_back(v);
+        }
+    }
+
+public:
+
+    MeshSimplifier(const double* vertices, size_t numVertices, const uint32_t* indices, size_t numIndices)
+        : vertices(vertices), numVertices(numVertices)
+    {
+        Weld();
+        triangles.resize(numVertices);
+        locked.assign(numVertices, false);
+        removedVertices.assign(numVertices, false);
+        quadrics.resize(numVertices);
+        versions.assign(numVertices, 0);
+
+        // Degenerate triangles are dropped
+        for (size_t i = 0; i + 2 < numIndices; i += 3)
+        {
+            auto a = welded[indices[i]], b = welded[indices[i + 1]], c = welded[indices[i + 2]];
+            if (a == b || b == c || a == c)
+                continue;
+            corners.insert(corners.end(), { indices[i], indices[i + 1], indices[i + 2] });
+        }
+        numTriangles = corners.size() / 3;
+        removedTriangles.assign(numTriangles, false);
+
+        // Edges used by one triangle, or by more than two, lock their vertices
+        std::unordered_map<uint64_t, uint32_t> edgeUses;
+        for (uint32_t t = 0; t < numTriangles; ++t)
+        {
+            for (int k = 0; k < 3; ++k)
+            {
+                auto a = Welded(t * 3 + k);
+                auto b = Welded(t * 3 + (k + 1) % 3);
+                edgeUses[((uint64_t)std::min(a, b) << 32) | std::max(a, b)]++;
+                triangles[a].push_back(t);
+            }
+
+            const double* p[3] = { Position(Welded(t * 3)), Position(Welded(t * 3 + 1)), Position(Welded(t * 3 + 2)) };
+            double n[3];
+            Normal(p[0], p[1], p[2], n);
+            auto length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            if (length == 0)
+                continue;
+            for (auto& x : n)
+                x /= length;
+            auto q = Quadric::FromPlane(n, -(n[0] * p[0][0] + n[1] * p[0][1] + n[2] * p[0][2]), length / 2);
+            for (int k = 0; k < 3; ++k)
+                quadrics[Welded(t * 3 + k)].Add(q);
+        }
+        for (auto& kv : edgeUses)
+        {
+            if (kv.second != 2)
+            {
+                locked[kv.first >> 32] = true;
+                locked[kv.first & 0xFFFFFFFF] = true;
+            }
+        }
+    }
+
+    // Simplifies until at most targetIndexCount indices remain, or the next collapse would move the surface
+    // further than maxError (an RMS distance in model units). Returns the error reached.
+    // Can be called again with a lower target to continue from the current state.
+    double Simplify(size_t targetIndexCount, double maxError)
+    {
+        for (uint32_t v = 0; v < numVertices; ++v)
+            if (welded[v] == v)
+                Update(v);
+
+        double error = 0;
+        auto maxCost = maxError * maxError;
+        while (numTriangles * 3 > targetIndexCount && !heap.empty())
+        {
+            auto c = heap.top();
+            heap.pop();
+            if (c.version != versions[c.from] || removedVertices[c.from] || removedVertices[c.to])
+                continue;
+            if (c.cost > maxCost)
+                break;
+            error = std::max(error, std::sqrt(c.cost));
+            Collapse(c.from, c.to);
+        }
+        heap = {};
+        return error;
+    }
+
+    // The indices of the remaining triangles, into the input vertices
+    std::vector<uint32_t> Indices() const
+    {
+        std::vector<uint32_t> r;
+        r.reserve(numTriangles * 3);
+        for (size_t t = 0; t < removedTriangles.size(); ++t)
+            if (!removedTriangles[t])
+                r.insert(r.end(), corners.begin() + t * 3, corners.begin() + t * 3 + 3);
+        return r;
+    }
+
+    // Copies the vertices used by the indices, in order of first use, and rewrites the indices to match
+    static void Compact(const double* vertices, const std::vector<uint32_t>& indices,
+        std::vector<double>& outVertices, std::vector<uint32_t>& outIndices)
+    {
+        std::unordered_map<uint32_t, uint32_t> remap;
+        outVertices.clear();
+        outIndices.clear();
+        outIndices.reserve(indices.size());
+        for (auto i : indices)
+        {
+            auto it = remap.find(i);
+            if (it == remap.end())
+            {
+                it = remap.emplace(i, (uint32_t)(outVertices.size() / 6)).first;
+                outVertices.insert(outVertices.end(), vertices + (size_t)i * 6, vertices + (size_t)i * 6 + 6);
+            }
+            outIndices.push_back(it->second);
+        }
+    }
+};
@@ -0,0 +1,262 @@
+// Apache 2.0 License
+// Author: Christopher Diggins of Ara 3D Inc for Speckle Systems Ltd.
+// Flattens the property sets of a model into a columnar table with one row per element, property and value.
+
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+#include "LineDecoder.h"
+#include "RelationIndex.h"
+
+// How the value of a row is stored
+enum PropertyValueKind : uint8_t
+{
+    PropertyValueNone = 0,      // no value (e.g. an empty nominal value, or an unsupported property type)
+    PropertyValueInteger = 1,   // intValue is the integer
+    PropertyValueReal = 2,      // realValue is the number
+    PropertyValueString = 3,    // intValue is an index into the string pool
+    PropertyValueEnum = 4,      // intValue is an index into the string pool (e.g. "T" for a boolean)
+    PropertyValueRef = 5,       // intValue is an express ID
+};
+
+// Runs the tasks of PropertyTable::Build in order on the calling thread
+struct SerialForEach
+{
+    template<typename F>
+    void operator()(size_t numTasks, F body) const
+    {
+        for (size_t i = 0; i < numTasks; ++i)
+            body(0, i);
+    }
+};
+
+// The rows for every element that has property sets assigned through IfcRelDefinesByProperties.
+// Single values give one row. Enumerated and list values give one row per value, numbered by valueIndex.
+// The properties of a complex property are flattened, with complexNameIds holding the name of the complex property.
+// Names and string values are indices into the string pool, NoString when absent.
+struct PropertyTable
+{
+    static constexpr uint32_t NoString = std::numeric_limits<uint32_t>::max();
+
+    std::vector<uint32_t> elementIds;
+    std::vector<uint32_t> propertySetIds;
+    std::vector<uint32_t> propertySetNameIds;
+    std::vector<uint32_t> propertyIds;
+    std::vector<uint32_t> propertyNameIds;
+    std::vector<uint32_t> complexNameIds;
+    std::vector<uint32_t> valueTypeIds;         // e.g. "IFCLABEL" or "IFCLENGTHMEASURE"
+    std::vector<int32_t> valueIndices;
+    std::vector<uint8_t> valueKinds;
+    std::vector<int64_t> intValues;
+    std::vector<double> realValues;
+
+    // The decoded property set and property lines, which also hold the string pool
+    LineTable lines;
+
+    size_t NumRows() const { return elementIds.size(); }
+
+    size_t Bytes() const
+    {
+        return elementIds.capacity() * (7 * sizeof(uint32_t) + sizeof(int32_t) + sizeof(uint8_t) + sizeof(int64_t) + sizeof(double))
+            + lines.Bytes();
+    }
+
+    // Builds the table. The lines are decoded serially, because the loader is not thread-safe.
+    // They are then flattened one property set per task, through forEach(numTasks, body(worker, task)).
+    template<typename ForEach>
+    void Build(webifc::parsing::IfcLoader* loader, const RelationIndex& relations, ForEach forEach)
+    {
+        using namespace webifc::schema;
+
+        lines.Decode(loader, loader->GetExpressIDsWithType(IFCPROPERTYSET));
+        auto numPropertySets = lines.NumLines();
+        for (auto type : { IFCPROPERTYSINGLEVALUE, IFCPROPERTYENUMERATEDVALUE, IFCPROPERTYLISTVALUE,
+            IFCPROPERTYREFERENCEVALUE, IFCPROPERTYBOUNDEDVALUE, IFCPROPERTYTABLEVALUE, IFCCOMPLEXPROPERTY })
+            lines.Decode(loader, loader->GetExpressIDsWithType(type));
+
+        lineOfId.assign((size_t)loader->GetMaxExpressId() + 1, NoLine);
+        for (size_t i = 0; i < lines.NumLines(); ++i)
+            lineOfId[lines.lineIds[i]] = (uint32_t)i;
+
+        // Values of each property set, without the element, computed in parallel
+        std::vector<std::vector<Value>> setValues(numPropertySets);
+        forEach(numPropertySets, [&](size_t, size_t set)
+        {
+            lines.ForEachRef(set, 4, [&](uint32_t property)
+            {
+                AddValues(property, NoString, setValues[set], 0);
+            });
+        });
+
+        // Every element related to a property set gets a copy of its values
+        std::vector<size_t> firstRow(numPropertySets + 1, 0);
+        for (size_t set = 0; set < numPropertySets; ++set)
+        {
+            size_t numElements = 0;
+            ForEachElement(relations, lines.lineIds[set], [&](uint32_t) { ++numElements; });
+            firstRow[set + 1] = firstRow[set] + setValues[set].size() * numElements;
+        }
+        Resize(firstRow.back());
+
+        forEach(numPropertySets, [&](size_t, size_t set)
+        {
+            auto setId = lines.lineIds[set];
+            auto setName = StringArgument(set, 2);
+            auto row = firstRow[set];
+            ForEachElement(relations, setId, [&](uint32_t element)
+            {
+                for (auto& v : setValues[set])
+                {
+                    elementIds[row] = element;
+                    propertySetIds[row] = setId;
+                    propertySetNameIds[row] = setName;
+                    propertyIds[row] = v.propertyId;
+                    propertyNameIds[row] = v.nameId;
+                    complexNameIds[row] = v.complexNameId;
+                    valueTypeIds[row] = v.typeId;
+                    valueIndices[row] = v.index;
+                    valueKinds[row] = v.kind;
+                    intValues[row] = v.intValue;
+                    realValues[row] = v.realValue;
+                    ++row;
+                }
+            });
+        });
+
+        lineOfId.clear();
+        lineOfId.shrink_to_fit();
+    }
+
+private:
+
+    static constexpr uint32_t NoLine = std::numeric_limits<uint32_t>::max();
+
+    struct Value
+    {
+        uint32_t propertyId;
+        uint32_t nameId;
+        uint32_t complexNameId;
+        uint32_t typeId;
+        int32_t index;
+        PropertyValueKind kind;
+        int64_t intValue;
+        double realValue;
+    };
+
+    std::vector<uint32_t> lineOfId;
+
+    void Resize(size_t n)
+    {
+        elementIds.resize(n);
+        propertySetIds.resize(n);
+        propertySetNameIds.resize(n);
+        propertyIds.resize(n);
+        propertyNameIds.resize(n);
+        complexNameIds.resize(n);
+        valueTypeIds.resize(n);
+        valueIndices.resize(n);
+        valueKinds.resize(n);
+        intValues.resize(n);
+        realValues.resize(n);
+    }
+
+    // Calls f with each element related to a property set by IfcRelDefinesByProperties
+    template<typename F>
+    static void ForEachElement(const RelationIndex& relations, uint32_t setId, F f)
+    {
+        using namespace webifc::schema;
+        auto ids = relations.forward.Ids(setId);
+        auto rels = relations.forward.Relations(setId);
+        for (uint32_t i = 0; i < relations.forward.Count(setId); ++i)
+            if (relations.relationTypes[rels[i]] == IFCRELDEFINESBYPROPERTIES)
+                f(ids[i]);
+    }
+
+    uint32_t StringArgument(size_t line, size_t arg) const
+    {
+        auto i = lines.ArgumentIndex(line, arg);
+        if (i < lines.lineOffsets[line + 1] && lines.tags[i] == LineValueString)
+            return (uint32_t)lines.values[i];
+        return NoString;
+    }
+
+    // Reads a value, which is usually a typed label such as IFCLABEL('x'), into v
+    void ReadValue(size_t i, Value& v) const
+    {
+        if (lines.tags[i] == LineValueLabel)
+        {
+            v.typeId = (uint32_t)lines.values[i];
+            auto setEnd = (size_t)lines.values[i + 1];
+            if (i + 2 >= setEnd)
+                return;
+            i += 2;
+        }
+        switch (lines.tags[i])
+        {
+        case LineValueInteger: v.kind = PropertyValueInteger; v.intValue = lines.values[i]; break;
+        case LineValueReal: v.kind = PropertyValueReal; v.realValue = lines.reals[lines.values[i]]; break;
+        case LineValueString: v.kind = PropertyValueString; v.intValue = lines.values[i]; break;
+        case LineValueEnum: v.kind = PropertyValueEnum; v.intValue = lines.values[i]; break;
+        case LineValueRef: v.kind = PropertyValueRef; v.intValue = lines.values[i]; break;
+        default: break;
+        }
+    }
+
+    // Adds one value for each value in an argument that is a single value or a set of values
+    void AddArgumentValues(size_t line, size_t arg, const Value& property, std::vector<Value>& out) const
+    {
+        auto i = lines.ArgumentIndex(line, arg);
+        if (i >= lines.lineOffsets[line + 1] || lines.tags[i] == LineValueEmpty)
+        {
+            out.push_back(property);
+            return;
+        }
+        if (lines.tags[i] != LineValueSet)
+        {
+            out.push_back(property);
+            ReadValue(i, out.back());
+            return;
+        }
+        int32_t index = 0;
+        for (auto j = i + 1; j < (size_t)lines.values[i]; j = lines.NextSibling(j))
+        {
+            out.push_back(property);
+            out.back().index = index++;
+            ReadValue(j, out.back());
+        }
+    }
+
+    void AddValues(uint32_t propertyId, uint32_t complexNameId, std::vector<Value>& out, int depth) const
+    {
+        using namespace webifc::schema;
+
+        // Guards against cycles between complex properties in malformed files
+        if (propertyId >= lineOfId.size() || lineOfId[propertyId] == NoLine || depth > 16)
+            return;
+        auto line = lineOfId[propertyId];
+
+        Value property = { propertyId, StringArgument(line, 0), complexNameId, NoString, 0, PropertyValueNone, 0, 0 };
+        switch (lines.lineTypes[line])
+        {
+        case IFCPROPERTYSINGLEVALUE:
+        case IFCPROPERTYENUMERATEDVALUE:
+        case IFCPROPERTYLISTVALUE:
+            AddArgumentValues(line, 2, property, out);
+            break;
+        case IFCPROPERTYREFERENCEVALUE:
+            AddArgumentValues(line, 3, property, out);
+            break;
+        case IFCCOMPLEXPROPERTY:
+            lines.ForEachRef(line, 3, [&](uint32_t child)
+            {
+                AddValues(child, property.nameId, out, depth + 1);
+            });
+            break;
+        default:
+            out.push_back(property);
+            break;
+        }
+    }
+};
@@ -0,0 +1,155 @@
+// Apache 2.0 License
+// Author: Christopher Diggins of Ara 3D Inc for Speckle Systems Ltd.
+// A compressed sparse row (CSR) adjacency index over the IfcRel* entities of a model.
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "LineDecoder.h"
+
+// Which arguments of a relation entity hold the relating object and the related object(s).
+// Either argument may be a single reference or a set of references.
+struct RelationKind
+{
+    uint32_t type;
+    uint32_t relatingArg;
+    uint32_t relatedArg;
+};
+
+// The relations indexed by default. Argument positions are the same in IFC2x3 and IFC4.
+inline std::vector<RelationKind> DefaultRelationKinds()
+{
+    using namespace webifc::schema;
+    return {
+        { IFCRELAGGREGATES, 4, 5 },
+        { IFCRELNESTS, 4, 5 },
+        { IFCRELCONTAINEDINSPATIALSTRUCTURE, 5, 4 },
+        { IFCRELREFERENCEDINSPATIALSTRUCTURE, 5, 4 },
+        { IFCRELDEFINESBYPROPERTIES, 5, 4 },
+        { IFCRELDEFINESBYTYPE, 5, 4 },
+        { IFCRELASSOCIATESMATERIAL, 5, 4 },
+        { IFCRELASSOCIATESCLASSIFICATION, 5, 4 },
+        { IFCRELVOIDSELEMENT, 4, 5 },
+        { IFCRELFILLSELEMENT, 4, 5 },
+        { IFCRELSPACEBOUNDARY, 4, 5 },
+        { IFCRELASSIGNSTOGROUP, 6, 4 },
+        { IFCRELDECLARES, 4, 5 },
+    };
+}
+
+// The relations of the spatial tree walked by ElementFilter: aggregation and spatial containment.
+// Taken from the default relations, so that an index built with only these matches the full one.
+inline std::vector<RelationKind> SpatialRelationKinds()
+{
+    using namespace webifc::schema;
+    std::vector<RelationKind> r;
+    for (auto& kind : DefaultRelationKinds())
+        if (kind.type == IFCRELAGGREGATES || kind.type == IFCRELCONTAINEDINSPATIALSTRUCTURE)
+            r.push_back(kind);
+    return r;
+}
+
+// Neighbors of every express ID, in CSR form: the neighbors of id are ids[offsets[id] .. offsets[id + 1]),
+// and relations holds the index of the relation that produced each neighbor.
+struct Adjacency
+{
+    std::vector<uint32_t> offsets;
+    std::vector<uint32_t> ids;
+    std::vector<uint32_t> relations;
+
+    uint32_t Count(uint32_t id) const
+    {
+        return (size_t)id + 1 < offsets.size() ? offsets[id + 1] - offsets[id] : 0;
+    }
+
+    const uint32_t* Ids(uint32_t id) const
+    {
+        return Count(id) ? ids.data() + offsets[id] : nullptr;
+    }
+
+    const uint32_t* Relations(uint32_t id) const
+    {
+        return Count(id) ? relations.data() + offsets[id] : nullptr;
+    }
+
+    size_t Bytes() const
+    {
+        return (offsets.capacity() + ids.capacity() + relations.capacity()) * sizeof(uint32_t);
+    }
+};
+
+// Edges go from the relating object to each related object. 
+// Forward lookups give the related objects of an ID, reverse lookups give the relating objects.
+struct RelationIndex
+{
+    std::vector<uint32_t> relationIds;
+    std::vector<uint32_t> relationTypes;
+    Adjacency forward;
+    Adjacency reverse;
+
+    size_t NumRelations() const { return relationIds.size(); }
+    size_t NumEdges() const { return forward.ids.size(); }
+
+    size_t Bytes() const
+    {
+        return (relationIds.capacity() + relationTypes.capacity()) * sizeof(uint32_t) + forward.Bytes() + reverse.Bytes();
+    }
+
+    void Build(webifc::parsing::IfcLoader* loader, const std::vector<RelationKind>& kinds)
+    {
+        std::vector<Edge> edges;
+        uint32_t maxId = loader->GetMaxExpressId();
+        for (auto& kind : kinds)
+        {
+            LineTable table;
+            table.Decode(loader, loader->GetExpressIDsWithType(kind.type));
+            for (size_t line = 0; line < table.NumLines(); ++line)
+            {
+                auto relation = (uint32_t)relationIds.size();
+                relationIds.push_back(table.lineIds[line]);
+                relationTypes.push_back(kind.type);
+                table.ForEachRef(line, kind.relatingArg, [&](uint32_t from)
+                {
+                    table.ForEachRef(line, kind.relatedArg, [&](uint32_t to)
+                    {
+                        // References to lines that do not exist are dropped
+                        if (from <= maxId && to <= maxId)
+                            edges.push_back(Edge{ from, to, relation });
+                    });
+                });
+            }
+        }
+        BuildAdjacency(edges, maxId, false, forward);
+        BuildAdjacency(edges, maxId, true, reverse);
+    }
+
+private:
+
+    struct Edge
+    {
+        uint32_t from;
+        uint32_t to;
+        uint32_t relation;
+    };
+
+    // Counting sort of the edges by source (or target when reversed), which keeps the order of the relations
+    static void BuildAdjacency(const std::vector<Edge>& edges, uint32_t maxId, bool reversed, Adjacency& adjacency)
+    {
+        adjacency.offsets.assign((size_t)maxId + 2, 0);
+        for (auto& e : edges)
+            adjacency.offsets[(size_t)(reversed ? e.to : e.from) + 1]++;
+        for (size_t i = 1; i < adjacency.offsets.size(); ++i)
+            adjacency.offsets[i] += adjacency.offsets[i - 1];
+
+        adjacency.ids.resize(edges.size());
+        adjacency.relations.resize(edges.size());
+        std::vector<uint32_t> next(adjacency.offsets.begin(), adjacency.offsets.end() - 1);
+        for (auto& e : edges)
+        {
+            auto i = next[reversed ? e.to : e.from]++;
+            adjacency.ids[i] = reversed ? e.from : e.to;
+            adjacency.relations[i] = e.relation;
+        }
+    }
+};
@@ -0,0 +1,121 @@
+// Apache 2.0 License
+// Author: Christopher Diggins of Ara 3D Inc for Speckle Systems Ltd.
+// SHA-256 (FIPS 180-4), used where content IDs must match those computed by other tools,
+// such as the IDs of Speckle objects.
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+class Sha256
+{
+    uint32_t state[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19 };
+    uint8_t block[64];
+    size_t blockSize = 0;
+    uint64_t length = 0;
+
+    static uint32_t RotR(uint32_t x, int r)
+    {
+        return (x >> r) | (x << (32 - r));
+    }
+
+    void Compress(const uint8_t* p)
+    {
+        static const uint32_t K[64] = {
+            0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+            0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+            0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+            0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+            0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+            0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+            0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+            0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2 };
+
+        uint32_t w[64];
+        for (int i = 0; i < 16; ++i)
+            w[i] = (uint32_t)p[i * 4] << 24 | (uint32_t)p[i * 4 + 1] << 16 | (uint32_t)p[i * 4 + 2] << 8 | p[i * 4 + 3];
+        for (int i = 16; i < 64; ++i)
+        {
+            auto s0 = RotR(w[i - 15], 7) ^ RotR(w[i - 15], 18) ^ (w[i - 15] >> 3);
+            auto s1 = RotR(w[i - 2], 17) ^ RotR(w[i - 2], 19) ^ (w[i - 2] >> 10);
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+
+        auto a = state[0], b = state[1], c = state[2], d = state[3];
+        auto e = state[4], f = state[5], g = state[6], h = state[7];
+        for (int i = 0; i < 64; ++i)
+        {
+            auto t1 = h + (RotR(e, 6) ^ RotR(e, 11) ^ RotR(e, 25)) + ((e & f) ^ (~e & g)) + K[i] + w[i];
+            auto t2 = (RotR(a, 2) ^ RotR(a, 13) ^ RotR(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+            h = g; g = f; f = e; e = d + t1;
+            d = c; c = b; b = a; a = t1 + t2;
+        }
+        state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+        state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+    }
+
+public:
+
+    Sha256& Add(const void* data, size_t n)
+    {
+        auto p = static_cast<const uint8_t*>(data);
+        length += n;
+        if (blockSize > 0)
+        {
+            auto k = std::min(n, 64 - blockSize);
+            std::memcpy(block + blockSize, p, k);
+            blockSize += k;
+            p += k;
+            n -= k;
+            if (blockSize < 64)
+                return *this;
+            Compress(block);
+            blockSize = 0;
+        }
+        for (; n >= 64; p += 64, n -= 64)
+            Compress(p);
+        std::memcpy(block, p, n);
+        blockSize = n;
+        return *this;
+    }
+
+    Sha256& Add(std::string_view s)
+    {
+        return Add(s.data(), s.size());
+    }
+
+    // Pads the message and writes the 32 byte digest. The hasher cannot be used afterwards.
+    void Digest(uint8_t* out)
+    {
+        auto bits = length * 8;
+        uint8_t pad[72] = { 0x80 };
+        auto padSize = (blockSize < 56 ? 56 : 120) - blockSize;
+        for (int i = 0; i < 8; ++i)
+            pad[padSize + i] = (uint8_t)(bits >> (56 - i * 8));
+        Add(pad, padSize + 8);
+        for (int i = 0; i < 8; ++i)
+            for (int j = 0; j < 4; ++j)
+                out[i * 4 + j] = (uint8_t)(state[i] >> (24 - j * 8));
+    }
+
+    // The first numChars lowercase hex digits of the digest
+    std::string HexDigest(size_t numChars = 64)
+    {
+        static const char digits[] = "0123456789abcdef";
+        uint8_t d[32];
+        Digest(d);
+        std::string r;
+        for (size_t i = 0; i < 32 && r.size() < numChars; ++i)
+        {
+            r.push_back(digits[d[i] >> 4]);
+            r.push_back(digits[d[i] & 15]);
+        }
+        r.resize(std::min(r.size(), numChars));
+        return r;
+    }
+};
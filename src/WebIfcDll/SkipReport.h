@@ -0,0 +1,106 @@
+// Apache 2.0 License
+// Author: Christopher Diggins of Ara 3D Inc for Speckle Systems Ltd.
+// Limits on the tessellation of a single element, and the report of the elements that were skipped
+// because they failed or exceeded those limits. Elements may be reported from any thread.
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <unordered_set>
+#include <vector>
+
+enum SkipReason : int32_t
+{
+    // The geometry processor threw an exception
+    SkipReasonException = 1,
+
+    // Tessellation took longer than the element time budget
+    SkipReasonTimeBudget = 2,
+
+    // The element produced more triangles than the element triangle budget
+    SkipReasonTriangleBudget = 3,
+
+    // The extraction deadline had passed before the element was started, so it was not tessellated
+    SkipReasonDeadline = 4,
+};
+
+// An element whose geometry was discarded.
+// When the element was tessellated before being discarded, its world-space bounds are given
+// so that a placeholder box can be shown in its place.
+struct SkippedElement
+{
+    uint32_t expressId;
+    uint32_t type;
+    int32_t reason;
+    int32_t hasBounds;
+    int64_t triangles;      // zero unless the element was tessellated
+    double seconds;         // time spent on the element before it was discarded
+    double bounds[6];       // min xyz, max xyz, when hasBounds is non-zero
+};
+
+// Limits on the geometry of each element. Zero means no limit.
+// The geometry processor cannot be interrupted, so the time budget is checked once an element is done:
+// an element that ran over is discarded, and the overrun is bounded by the deadline of the whole extraction,
+// after which the remaining elements are skipped without being tessellated.
+struct ElementBudget
+{
+    using Clock = std::chrono::steady_clock;
+
+    double seconds = 0;
+    int64_t triangles = 0;
+    Clock::time_point deadline = Clock::time_point::max();
+
+    bool PastDeadline(Clock::time_point t) const
+    {
+        return t >= deadline;
+    }
+
+    int32_t Check(double elementSeconds, int64_t elementTriangles) const
+    {
+        if (seconds > 0 && elementSeconds > seconds)
+            return SkipReasonTimeBudget;
+        if (triangles > 0 && elementTriangles > triangles)
+            return SkipReasonTriangleBudget;
+        return 0;
+    }
+};
+
+class SkipReport
+{
+    mutable std::mutex mutex;
+    std::vector<SkippedElement> elements;
+    std::unordered_set<uint32_t> ids;
+
+public:
+
+    void Add(const SkippedElement& e)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (ids.insert(e.expressId).second)
+            elements.push_back(e);
+    }
+
+    bool Contains(uint32_t expressId) const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return ids.find(expressId) != ids.end();
+    }
+
+    size_t Size() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return elements.size();
+    }
+
+    // The skipped elements ordered by express ID, so the report does not depend on the number of threads
+    std::vector<SkippedElement> Elements() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto r = elements;
+        std::sort(r.begin(), r.end(), [](const SkippedElement& a, const SkippedElement& b) { return a.expressId < b.expressId; });
+        return r;
+    }
+};
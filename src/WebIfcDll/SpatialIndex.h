@@ -0,0 +1,419 @@
+// Apache 2.0 License
+// Author: Christopher Diggins of Ara 3D Inc for Speckle Systems Ltd.
+// A bounding volume hierarchy over the world-space bounding boxes of elements,
+// answering box, frustum, ray and nearest-element queries without touching vertex data.
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <queue>
+#include <utility>
+#include <vector>
+
+// An axis-aligned box, laid out like the bounds arrays of the API: min xyz then max xyz.
+// A default constructed box is empty, and adding anything to it gives that thing's bounds.
+struct Aabb
+{
+    double min[3] = { std::numeric_limits<double>::max(), std::numeric_limits<double>::max(), std::numeric_limits<double>::max() };
+    double max[3] = { std::numeric_limits<double>::lowest(), std::numeric_limits<double>::lowest(), std::numeric_limits<double>::lowest() };
+
+    static Aabb FromArray(const double* bounds)
+    {
+        Aabb r;
+        std::copy(bounds, bounds + 3, r.min);
+        std::copy(bounds + 3, bounds + 6, r.max);
+        return r;
+    }
+
+    void ToArray(double* bounds) const
+    {
+        std::copy(min, min + 3, bounds);
+        std::copy(max, max + 3, bounds + 3);
+    }
+
+    bool IsEmpty() const
+    {
+        return min[0] > max[0] || min[1] > max[1] || min[2] > max[2];
+    }
+
+    void Add(const Aabb& b)
+    {
+        for (int r = 0; r < 3; ++r)
+        {
+            min[r] = std::min(min[r], b.min[r]);
+            max[r] = std::max(max[r], b.max[r]);
+        }
+    }
+
+    double Center(int axis) const
+    {
+        return (min[axis] + max[axis]) * 0.5;
+    }
+
+    double SurfaceArea() const
+    {
+        if (IsEmpty())
+            return 0;
+        auto dx = max[0] - min[0], dy = max[1] - min[1], dz = max[2] - min[2];
+        return 2 * (dx * dy + dy * dz + dz * dx);
+    }
+
+    bool Intersects(const Aabb& b) const
+    {
+        for (int r = 0; r < 3; ++r)
+            if (min[r] > b.max[r] || max[r] < b.min[r])
+                return false;
+        return true;
+    }
+
+    bool Contains(const Aabb& b) const
+    {
+        for (int r = 0; r < 3; ++r)
+            if (b.min[r] < min[r] || b.max[r] > max[r])
+                return false;
+        return true;
+    }
+
+    // Zero when the point is inside
+    double DistanceSquared(const double* p) const
+    {
+        double r = 0;
+        for (int i = 0; i < 3; ++i)
+        {
+            auto d = std::max({ min[i] - p[i], 0.0, p[i] - max[i] });
+            r += d * d;
+        }
+        return r;
+    }
+
+    // Slab test against a ray given by its origin and the reciprocal of its direction.
+    // On a hit, enter is the distance along the ray where it enters the box, or 0 if the origin is inside.
+    bool IntersectsRay(const double* origin, const double* invDir, double maxDistance, double& enter) const
+    {
+        auto t0 = 0.0, t1 = maxDistance;
+        for (int r = 0; r < 3; ++r)
+        {
+            auto a = (min[r] - origin[r]) * invDir[r];
+            auto b = (max[r] - origin[r]) * invDir[r];
+            // An axis parallel ray inside the slab gives NaN (0 * inf), which leaves the interval unchanged
+            if (a > b)
+                std::swap(a, b);
+            if (a > t0)
+                t0 = a;
+            if (b < t1)
+                t1 = b;
+            if (t0 > t1)
+                return false;
+        }
+        enter = t0;
+        return true;
+    }
+
+    // Planes are (a, b, c, d) with the inside where ax + by + cz + d >= 0.
+    // Returns -1 if the box is outside a plane, 1 if it is inside all of them, and 0 if it straddles.
+    int Classify(const double* planes, size_t numPlanes) const
+    {
+        auto inside = 1;
+        for (size_t i = 0; i < numPlanes; ++i)
+        {
+            auto p = planes + i * 4;
+            // The corners furthest along and against the plane normal
+            double far = p[3], near = p[3];
+            for (int r = 0; r < 3; ++r)
+            {
+                far += p[r] * (p[r] >= 0 ? max[r] : min[r]);
+                near += p[r] * (p[r] >= 0 ? min[r] : max[r]);
+            }
+            if (far < 0)
+                return -1;
+            if (near < 0)
+                inside = 0;
+        }
+        return inside;
+    }
+};
+
+class SpatialIndex
+{
+    struct Node
+    {
+        Aabb box;
+
+        // A leaf holds count items starting at first. An inner node has count 0,
+        // and its children are at first and first + 1.
+        uint32_t first;
+        uint32_t count;
+    };
+
+    static constexpr uint32_t LeafSize = 4;
+    static constexpr int NumBins = 16;
+
+    std::vector<Node> nodes;
+    std::vector<uint32_t> ids;
+    std::vector<Aabb> boxes;
+
+public:
+
+    // Builds the hierarchy with the surface area heuristic, over centroids sorted into bins.
+    // Items with empty boxes are left out.
+    void Build(const std::vector<uint32_t>& itemIds, const std::vector<Aabb>& itemBoxes)
+    {
+        nodes.clear();
+        ids.clear();
+        boxes.clear();
+        for (size_t i = 0; i < itemIds.size(); ++i)
+        {
+            if (itemBoxes[i].IsEmpty())
+                continue;
+            ids.push_back(itemIds[i]);
+            boxes.push_back(itemBoxes[i]);
+        }
+        if (ids.empty())
+            return;
+
+        std::vector<uint32_t> order(ids.size());
+        for (uint32_t i = 0; i < order.size(); ++i)
+            order[i] = i;
+        nodes.reserve(ids.size() * 2 / LeafSize + 1);
+        nodes.push_back({});
+        Split(0, order, 0, (uint32_t)order.size());
+
+        std::vector<uint32_t> sortedIds(order.size());
+        std::vector<Aabb> sortedBoxes(order.size());
+        for (size_t i = 0; i < order.size(); ++i)
+        {
+            sortedIds[i] = ids[order[i]];
+            sortedBoxes[i] = boxes[order[i]];
+        }
+        ids = std::move(sortedIds);
+        boxes = std::move(sortedBoxes);
+    }
+
+    size_t Size() const
+    {
+        return ids.size();
+    }
+
+    size_t Bytes() const
+    {
+        return nodes.capacity() * sizeof(Node) + ids.capacity() * sizeof(uint32_t) + boxes.capacity() * sizeof(Aabb);
+    }
+
+    // The bounds of every indexed item
+    Aabb Bounds() const
+    {
+        return nodes.empty() ? Aabb() : nodes[0].box;
+    }
+
+    // Calls f(id) for every item whose box intersects the query box
+    template<typename F>
+    void QueryBox(const Aabb& query, F f) const
+    {
+        Traverse(
+            [&](const Aabb& b) { return query.Contains(b) ? 1 : b.Intersects(query) ? 0 : -1; },
+            [&](uint32_t i, bool accepted) { if (accepted || boxes[i].Intersects(query)) f(ids[i]); });
+    }
+
+    // Calls f(id) for every item whose box is not entirely outside one of the planes.
+    // Like any box against frustum test, this may include boxes just outside a corner of the frustum.
+    template<typename F>
+    void QueryFrustum(const double* planes, size_t numPlanes, F f) const
+    {
+        Traverse(
+            [&](const Aabb& b) { return b.Classify(planes, numPlanes); },
+            [&](uint32_t i, bool accepted) { if (accepted || boxes[i].Classify(planes, numPlanes) >= 0) f(ids[i]); });
+    }
+
+    // The items whose box is hit by the ray within maxDistance, as (distance, id) sorted by the distance
+    // at which the ray enters the box. The direction does not need to be normalized; distances are in its units.
+    std::vector<std::pair<double, uint32_t>> QueryRay(const double* origin, const double* direction, double maxDistance) const
+    {
+        double invDir[3];
+        for (int r = 0; r < 3; ++r)
+            invDir[r] = 1.0 / direction[r];
+        std::vector<std::pair<double, uint32_t>> r;
+        double enter;
+        Traverse(
+            [&](const Aabb& b) { return b.IntersectsRay(origin, invDir, maxDistance, enter) ? 0 : -1; },
+            [&](uint32_t i, bool)
+            {
+                if (boxes[i].IntersectsRay(origin, invDir, maxDistance, enter))
+                    r.push_back({ enter, ids[i] });
+            });
+        std::sort(r.begin(), r.end());
+        return r;
+    }
+
+    // The count items whose boxes are closest to the point, as (distance, id) from the closest.
+    // The distance is zero for boxes that contain the point.
+    std::vector<std::pair<double, uint32_t>> QueryNearest(const double* point, size_t count) const
+    {
+        std::vector<std::pair<double, uint32_t>> r;
+        if (nodes.empty() || count == 0)
+            return r;
+
+        // Nodes are visited closest first, and the search stops when the closest remaining node
+        // is further than the furthest of the best items found so far
+        using Entry = std::pair<double, uint32_t>;
+        std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> open;
+        std::priority_queue<Entry> best;
+        open.push({ nodes[0].box.DistanceSquared(point), 0 });
+        while (!open.empty())
+        {
+            auto [d, n] = open.top();
+            open.pop();
+            if (best.size() == count && d > best.top().first)
+                break;
+            auto& node = nodes[n];
+            if (node.count == 0)
+            {
+                open.push({ nodes[node.first].box.DistanceSquared(point), node.first });
+                open.push({ nodes[node.first + 1].box.DistanceSquared(point), node.first + 1 });
+                continue;
+            }
+            for (auto i = node.first; i < node.first + node.count; ++i)
+            {
+                auto di = boxes[i].DistanceSquared(point);
+                if (best.size() < count)
+                    best.push({ di, i });
+                else if (di < best.top().first)
+                {
+                    best.pop();
+                    best.push({ di, i });
+                }
+            }
+        }
+
+        while (!best.empty())
+        {
+            r.push_back({ std::sqrt(best.top().first), ids[best.top().second] });
+            best.pop();
+        }
+        std::reverse(r.begin(), r.end());
+        return r;
+    }
+
+private:
+
+    // Visits the hierarchy depth first. classify(box) returns -1 to skip a node, 1 to accept all its items
+    // without further tests, or 0 to descend. visit(index, accepted) is called for the items of every leaf reached.
+    template<typename C, typename V>
+    void Traverse(C classify, V visit) const
+    {
+        if (nodes.empty())
+            return;
+        std::vector<std::pair<uint32_t, bool>> stack = { { 0, false } };
+        while (!stack.empty())
+        {
+            auto [n, accepted] = stack.back();
+            stack.pop_back();
+            auto& node = nodes[n];
+            if (!accepted)
+            {
+                auto c = classify(node.box);
+                if (c < 0)
+                    continue;
+                accepted = c > 0;
+            }
+            if (node.count == 0)
+            {
+                stack.push_back({ node.first + 1, accepted });
+                stack.push_back({ node.first, accepted });
+                continue;
+            }
+            for (auto i = node.first; i < node.first + node.count; ++i)
+                visit(i, accepted);
+        }
+    }
+
+    void Split(uint32_t n, std::vector<uint32_t>& order, uint32_t first, uint32_t count)
+    {
+        Aabb box, centroids;
+        for (auto i = first; i < first + count; ++i)
+        {
+            auto& b = boxes[order[i]];
+            box.Add(b);
+            Aabb c;
+            for (int r = 0; r < 3; ++r)
+                c.min[r] = c.max[r] = b.Center(r);
+            centroids.Add(c);
+        }
+        nodes[n].box = box;
+        nodes[n].first = first;
+        nodes[n].count = count;
+        if (count <= LeafSize)
+            return;
+
+        // Finds the bin boundary with the lowest surface area cost on the widest centroid axis
+        auto axis = 0;
+        for (int r = 1; r < 3; ++r)
+            if (centroids.max[r] - centroids.min[r] > centroids.max[axis] - centroids.min[axis])
+                axis = r;
+        auto lo = centroids.min[axis], extent = centroids.max[axis] - lo;
+        uint32_t mid;
+        if (extent <= 0)
+        {
+            mid = first + count / 2;
+        }
+        else
+        {
+            auto binOf = [&](uint32_t item)
+            {
+                return std::min(NumBins - 1, (int)((boxes[item].Center(axis) - lo) / extent * NumBins));
+            };
+            Aabb binBoxes[NumBins];
+            uint32_t binCounts[NumBins] = {};
+            for (auto i = first; i < first + count; ++i)
+            {
+                auto b = binOf(order[i]);
+                binBoxes[b].Add(boxes[order[i]]);
+                binCounts[b]++;
+            }
+
+            double rightAreas[NumBins] = {};
+            uint32_t rightCounts[NumBins] = {};
+            Aabb right;
+            uint32_t rightCount = 0;
+            for (int b = NumBins - 1; b > 0; --b)
+            {
+                right.Add(binBoxes[b]);
+                rightCount += binCounts[b];
+                rightAreas[b] = right.SurfaceArea();
+                rightCounts[b] = rightCount;
+            }
+            auto bestCost = std::numeric_limits<double>::max();
+            auto bestBin = 1;
+            Aabb left;
+            uint32_t leftCount = 0;
+            for (int b = 1; b < NumBins; ++b)
+            {
+                left.Add(binBoxes[b - 1]);
+                leftCount += binCounts[b - 1];
+                if (leftCount == 0 || rightCounts[b] == 0)
+                    continue;
+                auto cost = left.SurfaceArea() * leftCount + rightAreas[b] * rightCounts[b];
+                if (cost < bestCost)
+                {
+                    bestCost = cost;
+                    bestBin = b;
+                }
+            }
+            auto it = std::partition(order.begin() + first, order.begin() + first + count,
+                [&](uint32_t item) { return binOf(item) < bestBin; });
+            mid = (uint32_t)(it - order.begin());
+            if (mid == first || mid == first + count)
+                mid = first + count / 2;
+        }
+
+        auto child = (uint32_t)nodes.size();
+        nodes.push_back({});
+        nodes.push_back({});
+        nodes[n].first = child;
+        nodes[n].count = 0;
+        Split(child, order, first, mid - first);
+        Split(child + 1, order, mid, first + count - mid);
+    }
+};
@@ -0,0 +1,260 @@
+// Apache 2.0 License
+// Author: Christopher Diggins of Ara 3D Inc for Speckle Systems Ltd.
+// Builds Speckle objects as JSON text, and writes them as newline-delimited JSON chunks for batch upload.
+// Objects follow the Speckle serializer: detached children are replaced by references, every object lists
+// its detached descendants in "__closure", and its ID is the first 32 hex digits of the SHA-256 of its JSON.
+// Objects are independent until they are finished, so they can be built on worker threads.
+
+#pragma once
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#include "Sha256.h"
+
+namespace SpeckleJson
+{
+    inline void String(std::string& out, std::string_view s)
+    {
+        static const char digits[] = "0123456789abcdef";
+        out += '"';
+        for (auto c : s)
+        {
+            switch (c)
+            {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if ((unsigned char)c < 0x20)
+                {
+                    out += "\\u00";
+                    out += digits[(unsigned char)c >> 4];
+                    out += digits[c & 15];
+                }
+                else
+                    out += c;
+            }
+        }
+        out += '"';
+    }
+
+    // The shortest text that reads back as the same double. JSON has no NaN or infinity, so they are written as null.
+    inline void Number(std::string& out, double x)
+    {
+        if (!std::isfinite(x))
+        {
+            out += "null";
+            return;
+        }
+        char s[32];
+        auto r = std::to_chars(s, s + sizeof(s), x);
+        out.append(s, r.ptr);
+    }
+
+    inline void Integer(std::string& out, int64_t x)
+    {
+        char s[24];
+        auto r = std::to_chars(s, s + sizeof(s), x);
+        out.append(s, r.ptr);
+    }
+
+    // Speckle does not allow '.' or '/' in property names, and ignores empty ones
+    inline std::string Key(std::string_view name)
+    {
+        std::string r(name);
+        for (auto& c : r)
+            if (c == '.' || c == '/')
+                c = '_';
+        return r.empty() ? "_" : r;
+    }
+}
+
+// The ID of a finished object, and the IDs and depths of its detached descendants
+struct SpeckleRef
+{
+    std::string id;
+    std::vector<std::pair<std::string, int32_t>> closure;
+};
+
+// A Speckle object under construction. Members are appended to json, which becomes the whole document on Finish.
+struct SpeckleObject
+{
+    std::string json;
+    SpeckleRef ref;
+
+    // Starts a member, to be followed by its value
+    SpeckleObject& Key(std::string_view key)
+    {
+        if (!json.empty())
+            json += ',';
+        SpeckleJson::String(json, key);
+        json += ':';
+        return *this;
+    }
+
+    SpeckleObject& String(std::string_view key, std::string_view value)
+    {
+        Key(key);
+        SpeckleJson::String(json, value);
+        return *this;
+    }
+
+    SpeckleObject& Number(std::string_view key, double value)
+    {
+        Key(key);
+        SpeckleJson::Number(json, value);
+        return *this;
+    }
+
+    SpeckleObject& Integer(std::string_view key, int64_t value)
+    {
+        Key(key);
+        SpeckleJson::Integer(json, value);
+        return *this;
+    }
+
+    // Writes a reference to a detached child as a value, and adds the child to the closure
+    void Reference(const SpeckleRef& child)
+    {
+        json += "{\"speckle_type\":\"reference\",\"referencedId\":\"";
+        json += child.id;
+        json += "\",\"__closure\":null}";
+        ref.closure.push_back({ child.id, 1 });
+        for (auto& c : child.closure)
+            ref.closure.push_back({ c.first, c.second + 1 });
+    }
+
+    // Writes a list of references as the value of a member
+    void References(std::string_view key, const std::vector<const SpeckleRef*>& children)
+    {
+        Key(key);
+        json += '[';
+        for (size_t i = 0; i < children.size(); ++i)
+        {
+            if (i > 0)
+                json += ',';
+            Reference(*children[i]);
+        }
+        json += ']';
+    }
+
+    // Writes an inline child object, finished beforehand, as the value of a member
+    void Inline(std::string_view key, const SpeckleObject& child)
+    {
+        Key(key);
+        json += child.json;
+        ref.closure.insert(ref.closure.end(), child.ref.closure.begin(), child.ref.closure.end());
+    }
+
+    // Writes values split into detached Speckle DataChunks of at most chunkSize values,
+    // as Speckle does for large arrays such as mesh vertices. The chunks are finished and added to detached.
+    template<typename T>
+    void Chunks(std::string_view key, const T* values, size_t count, size_t chunkSize, std::vector<SpeckleObject>& detached)
+    {
+        Key(key);
+        json += '[';
+        for (size_t first = 0; first < count; first += chunkSize)
+        {
+            SpeckleObject chunk;
+            chunk.String("speckle_type", "Speckle.Core.Models.DataChunk");
+            chunk.Key("data");
+            chunk.json += '[';
+            for (auto i = first; i < std::min(count, first + chunkSize); ++i)
+            {
+                if (i > first)
+                    chunk.json += ',';
+                if constexpr (std::is_floating_point_v<T>)
+                    SpeckleJson::Number(chunk.json, (double)values[i]);
+                else
+                    SpeckleJson::Integer(chunk.json, (int64_t)values[i]);
+            }
+            chunk.json += ']';
+            chunk.Finish();
+            if (first > 0)
+                json += ',';
+            Reference(chunk.ref);
+            detached.push_back(std::move(chunk));
+        }
+        json += ']';
+    }
+
+    // Adds the closure, then computes the ID over the document without it, and inserts it as the first member
+    void Finish()
+    {
+        auto& closure = ref.closure;
+        std::sort(closure.begin(), closure.end());
+        closure.erase(std::unique(closure.begin(), closure.end(), [](auto& a, auto& b) { return a.first == b.first; }),
+            closure.end());
+        if (!closure.empty())
+        {
+            Key("__closure");
+            json += '{';
+            for (size_t i = 0; i < closure.size(); ++i)
+            {
+                if (i > 0)
+                    json += ',';
+                SpeckleJson::String(json, closure[i].first);
+                json += ':';
+                SpeckleJson::Integer(json, closure[i].second);
+            }
+            json += '}';
+        }
+        Integer("totalChildrenCount", (int64_t)closure.size());
+
+        ref.id = Sha256().Add("{").Add(json).Add("}").HexDigest(32);
+        std::string r = "{\"id\":\"";
+        r += ref.id;
+        r += "\",";
+        r += json;
+        r += '}';
+        json = std::move(r);
+    }
+};
+
+// Writes finished objects, one per line, to a sink in chunks of at most chunkBytes (unless a single object is larger).
+// Objects already written, such as identical meshes, are skipped.
+class SpeckleChunkWriter
+{
+    std::function<bool(const void*, size_t)> sink;
+    size_t chunkBytes;
+    std::string buffer;
+    std::unordered_set<std::string> written;
+
+public:
+
+    bool ok = true;
+    int64_t numObjects = 0;
+
+    SpeckleChunkWriter(std::function<bool(const void*, size_t)> sink, size_t chunkBytes)
+        : sink(std::move(sink)), chunkBytes(std::max<size_t>(chunkBytes, 1))
+    { }
+
+    void Write(const SpeckleObject& o)
+    {
+        if (!written.insert(o.ref.id).second)
+            return;
+        if (!buffer.empty() && buffer.size() + o.json.size() + 1 > chunkBytes)
+            Flush();
+        buffer += o.json;
+        buffer += '\n';
+        numObjects++;
+    }
+
+    void Flush()
+    {
+        if (ok && !buffer.empty())
+            ok = sink(buffer.data(), buffer.size());
+        buffer.clear();
+    }
+};
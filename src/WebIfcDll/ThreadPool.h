@@ -0,0 +1,150 @@
+// Apache 2.0 License
+// Author: Christopher Diggins of Ara 3D Inc for Speckle Systems Ltd.
+// A minimal work-stealing scheduler used to spread per-element work (tessellation, encoding, export)
+// across cores.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Returns the number of workers to use for a requested thread count.
+// Zero or negative values select the hardware concurrency.
+inline size_t ResolveNumThreads(int32_t requested)
+{
+    if (requested > 0)
+        return (size_t)requested;
+    auto n = std::thread::hardware_concurrency();
+    return n == 0 ? 1 : n;
+}
+
+// Runs a body over a range of task indices using a fixed number of workers.
+// Each worker is seeded with a contiguous slice of the range, and consumes it from the front.
+// When a worker runs dry it steals the back half of another worker's remaining slice.
+// The body receives the index of the worker executing it, so callers can keep per-worker state
+// (e.g. one geometry processor per worker) without any locking.
+class WorkStealingPool
+{
+    struct Slice
+    {
+        std::mutex mutex;
+        size_t begin = 0;
+        size_t end = 0;
+    };
+
+    size_t numWorkers;
+
+public:
+    explicit WorkStealingPool(size_t numWorkers)
+        : numWorkers(std::max<size_t>(numWorkers, 1))
+    { }
+
+    size_t NumWorkers() const
+    {
+        return numWorkers;
+    }
+
+    // Calls body(workerIndex, taskIndex) once for every task index in [0, numTasks).
+    // The calling thread participates as worker 0. Blocks until all tasks are complete.
+    // The first exception thrown by a task is rethrown once all workers have stopped.
+    template<typename F>
+    void ForEach(size_t numTasks, F body)
+    {
+        if (numTasks == 0)
+            return;
+
+        auto n = std::min(numWorkers, numTasks);
+        if (n == 1)
+        {
+            for (size_t i = 0; i < numTasks; ++i)
+                body(0, i);
+            return;
+        }
+
+        std::unique_ptr<Slice[]> slices(new Slice[n]);
+        for (size_t w = 0; w < n; ++w)
+        {
+            slices[w].begin = numTasks * w / n;
+            slices[w].end = numTasks * (w + 1) / n;
+        }
+
+        std::atomic<bool> failed(false);
+        std::exception_ptr error;
+        std::mutex errorMutex;
+
+        auto work = [&](size_t w)
+        {
+            auto& own = slices[w];
+            while (!failed)
+            {
+                size_t task;
+                {
+                    std::lock_guard<std::mutex> lock(own.mutex);
+                    task = own.begin < own.end ? own.begin++ : SIZE_MAX;
+                }
+
+                if (task == SIZE_MAX && !Steal(slices.get(), n, w, task))
+                    return;
+
+                try
+                {
+                    body(w, task);
+                }
+                catch (...)
+                {
+                    std::lock_guard<std::mutex> lock(errorMutex);
+                    if (!error)
+                        error = std::current_exception();
+                    failed = true;
+                }
+            }
+        };
+
+        std::vector<std::thread> threads;
+        threads.reserve(n - 1);
+        for (size_t w = 1; w < n; ++w)
+            threads.emplace_back(work, w);
+        work(0);
+        for (auto& t : threads)
+            t.join();
+
+        if (error)
+            std::rethrow_exception(error);
+    }
+
+private:
+
+    // Takes the back half of the first non-empty slice found after the thief's own.
+    // The first stolen task is returned, the rest becomes the thief's new slice.
+    // Tasks are never added after ForEach starts, so a full pass that finds nothing means we are done.
+    static bool Steal(Slice* slices, size_t n, size_t thief, size_t& task)
+    {
+        for (size_t i = 1; i < n; ++i)
+        {
+            auto& victim = slices[(thief + i) % n];
+            size_t begin, end;
+            {
+                std::lock_guard<std::mutex> lock(victim.mutex);
+                if (victim.begin >= victim.end)
+                    continue;
+                end = victim.end;
+                begin = victim.begin + (victim.end - victim.begin) / 2;
+                victim.end = begin;
+            }
+
+            task = begin;
+            auto& own = slices[thief];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            own.begin = begin + 1;
+            own.end = end;
+            return true;
+        }
+        return false;
+    }
+};
@@ -0,0 +1,239 @@
+// Apache 2.0 License
+// Author: Christopher Diggins of Ara 3D Inc for Speckle Systems Ltd.
+// Conversion of web-ifc vertex data (six doubles per vertex) into compact vertex formats.
+// Has no dependencies on the engine, so it can be shared by the DLL and the C++/CLI wrapper.
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+// Vertex layouts that can be produced natively
+enum VertexFormat : int32_t
+{
+    // Position and normal as 6 doubles, as stored by the engine (48 bytes)
+    VertexFormatDouble = 0,
+
+    // Position and normal as 6 floats (24 bytes)
+    VertexFormatFloat = 1,
+
+    // Position as 3 floats, normal as 2 octahedral-encoded snorm16 (16 bytes)
+    VertexFormatFloatOct = 2,
+
+    // Position as 3 unorm16 relative to the mesh bounds, 1 unused uint16,
+    // normal as 2 octahedral-encoded snorm16 (12 bytes).
+    // A position is decoded as min + q / 65535 * (max - min).
+    VertexFormatQuantized = 3,
+};
+
+// How vertices are encoded.
+// When worldSpace is non-zero, positions and normals are transformed by the placement transform.
+// The origin is subtracted from positions before conversion, so that georeferenced coordinates
+// keep their precision in 32-bit or quantized formats.
+struct VertexEncoding
+{
+    int32_t format;
+    int32_t worldSpace;
+    double originX, originY, originZ;
+};
+
+struct FloatVertex
+{
+    float Px, Py, Pz;
+    float Nx, Ny, Nz;
+};
+
+struct FloatOctVertex
+{
+    float Px, Py, Pz;
+    int16_t Nu, Nv;
+};
+
+struct QuantizedVertex
+{
+    uint16_t Px, Py, Pz, Unused;
+    int16_t Nu, Nv;
+};
+
+inline int32_t VertexStride(int32_t format)
+{
+    switch (format)
+    {
+    case VertexFormatFloat: return sizeof(FloatVertex);
+    case VertexFormatFloatOct: return sizeof(FloatOctVertex);
+    case VertexFormatQuantized: return sizeof(QuantizedVertex);
+    default: return 6 * sizeof(double);
+    }
+}
+
+inline int16_t ToSnorm16(double v)
+{
+    return (int16_t)std::lround(std::clamp(v, -1.0, 1.0) * 32767.0);
+}
+
+// Octahedral normal encoding: projects the unit sphere onto an octahedron, and unfolds it into a square.
+// See "A Survey of Efficient Representations for Independent Unit Vectors", Cigolle et al. 2014.
+inline void EncodeOctahedral(double x, double y, double z, int16_t& u, int16_t& v)
+{
+    auto l1 = std::abs(x) + std::abs(y) + std::abs(z);
+    if (l1 == 0)
+    {
+        u = v = 0;
+        return;
+    }
+    x /= l1;
+    y /= l1;
+    if (z < 0)
+    {
+        auto ox = (1 - std::abs(y)) * (x >= 0 ? 1 : -1);
+        auto oy = (1 - std::abs(x)) * (y >= 0 ? 1 : -1);
+        x = ox;
+        y = oy;
+    }
+    u = ToSnorm16(x);
+    v = ToSnorm16(y);
+}
+
+// Encodes vertices from the engine layout.
+// The transform is column-major (as in IfcPlacedGeometry::flatTransformation) and may be null for local space.
+// Bounds receives min xyz then max xyz of the encoded positions, and may be null.
+// It is required to decode VertexFormatQuantized.
+class VertexEncoder
+{
+    double m[16];
+    double n[9];
+    bool transformed;
+    double origin[3];
+
+public:
+
+    VertexEncoder(const double* transform, double ox, double oy, double oz)
+        : transformed(transform != nullptr)
+    {
+        origin[0] = ox;
+        origin[1] = oy;
+        origin[2] = oz;
+        if (!transformed)
+            return;
+        std::memcpy(m, transform, sizeof(m));
+
+        // Normals are transformed by the inverse transpose of the upper 3x3 matrix
+        auto a = m[0], b = m[4], c = m[8];
+        auto d = m[1], e = m[5], f = m[9];
+        auto g = m[2], h = m[6], i = m[10];
+        auto det = a * (e * i - f * h) - b * (d * i - f * g) + c * (d * h - e * g);
+        auto s = det == 0 ? 0 : 1 / det;
+        n[0] = (e * i - f * h) * s; n[1] = (f * g - d * i) * s; n[2] = (d * h - e * g) * s;
+        n[3] = (c * h - b * i) * s; n[4] = (a * i - c * g) * s; n[5] = (b * g - a * h) * s;
+        n[6] = (b * f - c * e) * s; n[7] = (c * d - a * f) * s; n[8] = (a * e - b * d) * s;
+    }
+
+    // Returns the position and normal of a single source vertex, after transformation and rebasing
+    void Transform(const double* src, double* p, double* nrm) const
+    {
+        if (transformed)
+        {
+            for (int r = 0; r < 3; ++r)
+            {
+                p[r] = m[r] * src[0] + m[4 + r] * src[1] + m[8 + r] * src[2] + m[12 + r];
+                nrm[r] = n[r * 3] * src[3] + n[r * 3 + 1] * src[4] + n[r * 3 + 2] * src[5];
+            }
+            auto len = std::sqrt(nrm[0] * nrm[0] + nrm[1] * nrm[1] + nrm[2] * nrm[2]);
+            if (len > 0)
+                for (int r = 0; r < 3; ++r)
+                    nrm[r] /= len;
+        }
+        else
+        {
+            std::memcpy(p, src, 3 * sizeof(double));
+            std::memcpy(nrm, src + 3, 3 * sizeof(double));
+        }
+        for (int r = 0; r < 3; ++r)
+            p[r] -= origin[r];
+    }
+
+    // Computes min xyz then max xyz of the encoded positions. Empty input gives zero bounds.
+    void ComputeBounds(const double* src, size_t numVertices, double* bounds) const
+    {
+        double p[3], nrm[3];
+        for (int r = 0; r < 3; ++r)
+        {
+            bounds[r] = numVertices ? std::numeric_limits<double>::max() : 0;
+            bounds[r + 3] = numVertices ? std::numeric_limits<double>::lowest() : 0;
+        }
+        for (size_t v = 0; v < numVertices; ++v)
+        {
+            Transform(src + v * 6, p, nrm);
+            for (int r = 0; r < 3; ++r)
+            {
+                bounds[r] = std::min(bounds[r], p[r]);
+                bounds[r + 3] = std::max(bounds[r + 3], p[r]);
+            }
+        }
+    }
+
+    void Encode(const double* src, size_t numVertices, int32_t format, void* dst, double* bounds) const
+    {
+        double box[6] = { 0, 0, 0, 0, 0, 0 };
+        if (format == VertexFormatQuantized || bounds)
+            ComputeBounds(src, numVertices, box);
+        if (bounds)
+            std::copy(box, box + 6, bounds);
+        EncodeWithBounds(src, numVertices, format, dst, box);
+    }
+
+    // Encodes with the given bounds instead of those of the vertices, so that quantized vertices 
+    // of several meshes merged into one buffer share the same range
+    void EncodeWithBounds(const double* src, size_t numVertices, int32_t format, void* dst, const double* box) const
+    {
+        auto lo = box;
+        auto hi = box + 3;
+        double p[3], nrm[3];
+
+        for (size_t v = 0; v < numVertices; ++v)
+        {
+            Transform(src + v * 6, p, nrm);
+            switch (format)
+            {
+            case VertexFormatFloat:
+            {
+                auto& out = static_cast<FloatVertex*>(dst)[v];
+                out = { (float)p[0], (float)p[1], (float)p[2], (float)nrm[0], (float)nrm[1], (float)nrm[2] };
+                break;
+            }
+            case VertexFormatFloatOct:
+            {
+                auto& out = static_cast<FloatOctVertex*>(dst)[v];
+                out.Px = (float)p[0];
+                out.Py = (float)p[1];
+                out.Pz = (float)p[2];
+                EncodeOctahedral(nrm[0], nrm[1], nrm[2], out.Nu, out.Nv);
+                break;
+            }
+            case VertexFormatQuantized:
+            {
+                auto& out = static_cast<QuantizedVertex*>(dst)[v];
+                uint16_t* q[3] = { &out.Px, &out.Py, &out.Pz };
+                for (int r = 0; r < 3; ++r)
+                {
+                    auto extent = hi[r] - lo[r];
+                    *q[r] = extent > 0 ? (uint16_t)std::lround((p[r] - lo[r]) / extent * 65535.0) : 0;
+                }
+                out.Unused = 0;
+                EncodeOctahedral(nrm[0], nrm[1], nrm[2], out.Nu, out.Nv);
+                break;
+            }
+            default:
+            {
+                auto out = static_cast<double*>(dst) + v * 6;
+                std::copy(p, p + 3, out);
+                std::copy(nrm, nrm + 3, out + 3);
+                break;
+            }
+            }
+        }
+    }
+};
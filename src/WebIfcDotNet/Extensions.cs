@@ -13,10 +13,10 @@ namespace WebIfcDotNet
             => model.GetLineIds().Where(id => model.GetLineType(id) == typeId);
 
         public static IEnumerable<LineData> GetLines(this Model model, IEnumerable<uint> ids)
-            => ids.Select(model.GetLineData);
+            => model.GetLineTable(ids).GetLines();
 
         public static IEnumerable<LineData> GetLines(this Model model, uint typeId)
-            => model.GetLines(model.GetLineIds(typeId));
+            => model.GetLineTable(typeId).GetLines();
 
         public static IEnumerable<LineData> GetLines(this Model model, string name)
             => model.GetLines(DotNetApi.GetTypeCodeFromName(name.ToUpperInvariant()));
@@ -20,6 +20,56 @@ public static class GraphTests
         OutputGraphDetails(g, logger);
     }
 
+    [Test]
+    public static void TestRelationIndexMatchesModelGraph()
+    {
+        var api = new DotNetApi();
+        var logger = new Logger(LogWriter.ConsoleWriter, "");
+        var f = "C:\\Users\\cdigg\\git\\web-ifc-dotnet\\src\\engine_web-ifc\\tests\\ifcfiles\\public\\AC20-FZK-Haus.ifc";
+        var g = ModelGraph.Load(api, logger, f);
+        var index = g.Model.GetRelationIndex();
+        logger.Log($"Indexed {index.RelationIds.Length} relations and {index.ForwardIds.Length} edges");
+
+        foreach (var r in g.GetRelations())
+        {
+            var related = index.GetRelated(r.From.Id).ToList();
+            foreach (var to in r.To)
+            {
+                Assert.That(related, Does.Contain(to.Id));
+                Assert.That(index.GetRelating(to.Id).ToList(), Does.Contain(r.From.Id));
+            }
+        }
+    }
+
+    [Test]
+    public static void TestPropertyTableMatchesModelGraph()
+    {
+        var api = new DotNetApi();
+        var logger = new Logger(LogWriter.ConsoleWriter, "");
+        var f = "C:\\Users\\cdigg\\git\\web-ifc-dotnet\\src\\engine_web-ifc\\tests\\ifcfiles\\public\\AC20-FZK-Haus.ifc";
+        var g = ModelGraph.Load(api, logger, f);
+        var table = g.Model.GetPropertyTable();
+        logger.Log($"Flattened {table.NumRows()} property rows with {table.Strings.Length} unique strings");
+
+        var rows = new Dictionary<(uint, uint, uint), int>();
+        for (var i = 0; i < table.NumRows(); i++)
+            rows[(table.ElementIds[i], table.PropertySetIds[i], table.PropertyIds[i])] = i;
+
+        foreach (var r in g.GetRelations().OfType<ModelPropSetRelation>())
+        {
+            var propSet = r.GetPropSet();
+            foreach (var element in r.To)
+            {
+                foreach (var prop in propSet.Properties)
+                {
+                    Assert.That(rows.TryGetValue((element.Id, propSet.Id, prop.Id), out var row), Is.True);
+                    Assert.That(table.GetString(table.PropertySetNameIds[row]), Is.EqualTo(propSet.Name));
+                    Assert.That(table.GetString(table.PropertyNameIds[row]), Is.EqualTo(prop.Name));
+                }
+            }
+        }
+    }
+
     public static void OutputGraphDetails(ModelGraph g, ILogger logger)
     {
 
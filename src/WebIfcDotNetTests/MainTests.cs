@@ -123,6 +123,29 @@ namespace WebIfcDotNetTests
             api.DisposeAll();
         }
 
+        [Test]
+        public static void TestLineTableMatchesLineData()
+        {
+            var api = new DotNetApi();
+            var model = api.Load(
+                "C:\\Users\\cdigg\\git\\web-ifc-dotnet\\src\\engine_web-ifc\\tests\\ifcfiles\\public\\AC20-FZK-Haus.ifc");
+
+            var lineIds = model.GetLineIds();
+            var table = model.GetLineTable(lineIds);
+            Assert.That(table.NumLines(), Is.EqualTo(lineIds.Count));
+            var lines = table.GetLines();
+            for (var i = 0; i < lineIds.Count; i++)
+            {
+                var expected = model.GetLineData(lineIds[i]);
+                Assert.That(lines[i].ExpressId, Is.EqualTo(expected.ExpressId));
+                Assert.That(lines[i].TypeCode, Is.EqualTo(expected.TypeCode));
+                Assert.That(lines[i].IfcValToString(), Is.EqualTo(expected.IfcValToString()));
+            }
+            Console.WriteLine($"Decoded {table.NumLines()} lines, {table.Values.Length} values, {table.Strings.Length} unique strings");
+
+            api.DisposeAll();
+        }
+
             
 
         [Test]
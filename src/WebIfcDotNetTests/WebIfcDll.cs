@@ -3,27 +3,637 @@
 namespace WebIfcDotNetTests
 {
 
+    [StructLayout(LayoutKind.Sequential)]
+    public struct ApiOptions
+    {
+        // Threads running the jobs started with BeginLoadModel, 0 uses one thread per hardware core
+        public int NumWorkers;
+    }
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct LoadOptions
+    {
+        // 1 uses the serial path, 0 uses one thread per hardware core.
+        // Each thread after the first parses its own copy of the file while extraction runs.
+        public int NumThreads;
+
+        // Tessellate elements on first access to GetGeometry instead of during load
+        public bool Lazy;
+
+        // Bytes of lazily tessellated geometry kept in memory, 0 means no limit
+        public ulong CacheBudgetBytes;
+
+        // Directory of the persistent geometry cache, null to disable it
+        [MarshalAs(UnmanagedType.LPUTF8Str)]
+        public string? CacheDirectory;
+
+        // Record loading phases and the tessellation of every element for WriteTrace
+        public bool Trace;
+
+        // Discard elements taking longer than this to tessellate, 0 means no limit
+        public double ElementTimeBudgetSeconds;
+
+        // Discard elements with more triangles than this, 0 means no limit
+        public long ElementTriangleBudget;
+
+        // Skip the remaining elements once tessellation during load has run this long, 0 means no limit
+        public double ExtractTimeBudgetSeconds;
+
+        // Pointer to an ElementFilterSpec selecting the elements to tessellate, zero for the default selection
+        public IntPtr Filter;
+
+        // Limits NumThreads so that the copy of the file parsed by each extra thread fits in this many bytes, 0 for no limit
+        public ulong WorkerMemoryBudgetBytes;
+
+        public static LoadOptions Default 
+            => new LoadOptions { NumThreads = 1 };
+    }
+
+    // Pointers to arrays of express IDs or type codes. An empty list does not filter.
+    [StructLayout(LayoutKind.Sequential)]
+    public struct ElementFilterSpec
+    {
+        public IntPtr IncludeTypes;
+        public long NumIncludeTypes;
+        public IntPtr ExcludeTypes;
+        public long NumExcludeTypes;
+        public IntPtr Containers;
+        public long NumContainers;
+        public IntPtr ExpressIds;
+        public long NumExpressIds;
+
+        // Keep opening elements and spaces
+        public int NoDefaultExclusions;
+        public int Reserved;
+    }
+
+    // Levels of detail, each simplified from the previous one until it reaches either target
+    [StructLayout(LayoutKind.Sequential)]
+    public struct LodOptions
+    {
+        public int NumLevels;
+
+        // 0 uses one thread per hardware core
+        public int NumThreads;
+
+        // Pointer to NumLevels fractions of the full triangle count to keep, or zero
+        public IntPtr TriangleRatios;
+
+        // Pointer to NumLevels largest errors as fractions of the bounding box diagonal, or zero.
+        // BuildLods returns -1 when both this and TriangleRatios are zero.
+        public IntPtr MaxErrors;
+    }
+
+    // Post-processing of every unique geometry. Each step runs when its field is non-zero.
+    [StructLayout(LayoutKind.Sequential)]
+    public struct OptimizeOptions
+    {
+        // In model units. 0 only merges identical positions.
+        public double PositionTolerance;
+
+        // Largest angle between merged normals, in radians
+        public double NormalTolerance;
+
+        // 0 uses one thread per hardware core
+        public int NumThreads;
+
+        public int Weld;
+        public int RemoveDegenerates;
+        public int OptimizeVertexCache;
+        public int OptimizeVertexFetch;
+    }
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct OptimizeStats
+    {
+        public long Geometries;
+        public long VerticesBefore;
+        public long VerticesAfter;
+        public long IndicesBefore;
+        public long IndicesAfter;
+        public double CacheMissRatioBefore;
+        public double CacheMissRatioAfter;
+    }
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct GlbOptions
+    {
+        // Also shares geometries with different IDs but identical buffers
+        public int DedupByContent;
+
+        // Draws repeated geometries with EXT_mesh_gpu_instancing instead of a node per placement
+        public int GpuInstancing;
+
+        // Subtracted from every placement
+        public double OriginX;
+        public double OriginY;
+        public double OriginZ;
+
+        // 0 uses one thread per hardware core
+        public int NumThreads;
+
+        public static GlbOptions Default
+            => new GlbOptions { DedupByContent = 1 };
+    }
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct SpeckleOptions
+    {
+        // Largest chunk passed to the sink at once, unless a single object is larger
+        public long ChunkBytes;
+
+        public int IncludeGeometry;
+        public int IncludeProperties;
+
+        // 0 uses one thread per hardware core
+        public int NumThreads;
+
+        public static SpeckleOptions Default
+            => new SpeckleOptions { ChunkBytes = 10 << 20, IncludeGeometry = 1, IncludeProperties = 1 };
+    }
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct MeshCounts
+    {
+        public long NumElements;
+        public long NumMeshes;
+        public long NumVertices;
+        public long NumIndices;
+    }
+
+    // Pointers to caller-allocated arrays, any of which may be null, and their capacities.
+    // Export stops before the first mesh that does not fit.
+    [StructLayout(LayoutKind.Sequential)]
+    public struct MeshBuffers
+    {
+        public IntPtr Vertices;
+        public IntPtr Indices;
+        public IntPtr ElementIds;
+        public IntPtr GeometryIds;
+        public IntPtr VertexOffsets;
+        public IntPtr VertexCounts;
+        public IntPtr IndexOffsets;
+        public IntPtr IndexCounts;
+        public IntPtr Transforms;
+        public IntPtr Colors;
+        public IntPtr Bounds;
+        public long MeshCapacity;
+        public long VertexCapacity;
+        public long IndexCapacity;
+    }
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct InstanceCounts
+    {
+        public long NumGeometries;
+        public long NumInstances;
+        public long NumVertices;
+        public long NumIndices;
+    }
+
+    // Pointers to caller-allocated arrays, any of which may be null
+    [StructLayout(LayoutKind.Sequential)]
+    public struct InstanceBuffers
+    {
+        public IntPtr Vertices;
+        public IntPtr Indices;
+        public IntPtr GeometryIds;
+        public IntPtr GeometryHashes;
+        public IntPtr VertexOffsets;
+        public IntPtr VertexCounts;
+        public IntPtr IndexOffsets;
+        public IntPtr IndexCounts;
+        public IntPtr Bounds;
+        public IntPtr ElementIds;
+        public IntPtr GeometryIndices;
+        public IntPtr Transforms;
+        public IntPtr Colors;
+    }
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct BatchCounts
+    {
+        public long NumBatches;
+        public long NumRanges;
+        public long NumVertices;
+        public long NumIndices;
+    }
+
+    // Pointers to caller-allocated arrays, any of which may be null.
+    // Indices are relative to the first vertex of their batch, and range first indices to its first index.
+    [StructLayout(LayoutKind.Sequential)]
+    public struct BatchBuffers
+    {
+        public IntPtr Vertices;
+        public IntPtr Indices;
+        public IntPtr VertexOffsets;
+        public IntPtr VertexCounts;
+        public IntPtr IndexOffsets;
+        public IntPtr IndexCounts;
+        public IntPtr Colors;
+        public IntPtr Bounds;
+        public IntPtr RangeOffsets;
+        public IntPtr RangeCounts;
+        public IntPtr RangeElementIds;
+        public IntPtr RangeFirstIndices;
+        public IntPtr RangeIndexCounts;
+    }
+
+    public enum VertexFormat
+    {
+        Double = 0,         // 6 doubles (48 bytes)
+        Float = 1,          // 6 floats (24 bytes)
+        FloatOct = 2,       // 3 floats, 2 octahedral snorm16 normal components (16 bytes)
+        Quantized = 3,      // 3 unorm16 relative to the mesh bounds, 1 unused, 2 octahedral snorm16 (12 bytes)
+    }
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct VertexEncoding
+    {
+        public VertexFormat Format;
+        public bool WorldSpace;
+        public double OriginX, OriginY, OriginZ;
+    }
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct LineTableCounts
+    {
+        public long NumLines;
+        public long NumValues;
+        public long NumReals;
+        public long NumStrings;
+        public long NumStringBytes;
+    }
+
+    // Pointers into a native line table, valid until FreeLineTable
+    [StructLayout(LayoutKind.Sequential)]
+    public struct LineTableArrays
+    {
+        public IntPtr LineIds;
+        public IntPtr LineTypes;
+        public IntPtr LineOffsets;
+        public IntPtr Tags;
+        public IntPtr Values;
+        public IntPtr Reals;
+        public IntPtr StringOffsets;
+        public IntPtr StringData;
+    }
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct RelationIndexCounts
+    {
+        public long NumRelations;
+        public long NumEdges;
+        public long NumOffsets;
+    }
+
+    // Pointers into the relation index of a model, valid for the lifetime of the model
+    [StructLayout(LayoutKind.Sequential)]
+    public struct RelationIndexArrays
+    {
+        public IntPtr RelationIds;
+        public IntPtr RelationTypes;
+        public IntPtr ForwardOffsets;
+        public IntPtr ForwardIds;
+        public IntPtr ForwardRelations;
+        public IntPtr ReverseOffsets;
+        public IntPtr ReverseIds;
+        public IntPtr ReverseRelations;
+    }
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct PropertyTableCounts
+    {
+        public long NumRows;
+        public long NumStrings;
+        public long NumStringBytes;
+    }
+
+    // Pointers to the columns of the property table of a model, valid for the lifetime of the model
+    [StructLayout(LayoutKind.Sequential)]
+    public struct PropertyTableArrays
+    {
+        public IntPtr ElementIds;
+        public IntPtr PropertySetIds;
+        public IntPtr PropertySetNameIds;
+        public IntPtr PropertyIds;
+        public IntPtr PropertyNameIds;
+        public IntPtr ComplexNameIds;
+        public IntPtr ValueTypeIds;
+        public IntPtr ValueIndices;
+        public IntPtr ValueKinds;
+        public IntPtr IntValues;
+        public IntPtr RealValues;
+        public IntPtr StringOffsets;
+        public IntPtr StringData;
+    }
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct GlobalIdTableCounts
+    {
+        public long NumIds;
+        public long NumDuplicates;
+    }
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct ChangeSetCounts
+    {
+        public long NumAdded;
+        public long NumRemoved;
+        public long NumModified;
+        public long NumUnchanged;
+        public long NumReused;
+        public long NumTessellated;
+        public double HashSeconds;
+    }
+
+    // Pointers to the arrays of the change set of a reloaded model, valid for the lifetime of the model.
+    // Removed and previous IDs are express IDs of the previous revision.
+    [StructLayout(LayoutKind.Sequential)]
+    public struct ChangeSetArrays
+    {
+        public IntPtr AddedIds;
+        public IntPtr RemovedIds;
+        public IntPtr ModifiedIds;
+        public IntPtr ModifiedPreviousIds;
+    }
+
+    // Pointers to the arrays of the GlobalId table of a model, valid for the lifetime of the model.
+    // GUIDs are 16 bytes each, in the byte order of their canonical text form.
+    [StructLayout(LayoutKind.Sequential)]
+    public struct GlobalIdTableArrays
+    {
+        public IntPtr ExpressIds;
+        public IntPtr Guids;
+        public IntPtr GuidOrder;
+    }
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct StreamOptions
+    {
+        // Background tessellation threads for lazy models, 0 uses one thread per hardware core
+        public int NumThreads;
+
+        // Finished elements waiting for the consumer before tessellation pauses
+        public int QueueCapacity;
+
+        // Bytes tessellated by a worker before its geometry processor cache is cleared, 0 means no limit
+        public ulong ProcessorBudgetBytes;
+
+        public static StreamOptions Default
+            => new StreamOptions { NumThreads = 1, QueueCapacity = 64 };
+    }
+
+    // Receives each streamed geometry on the calling thread, returns 0 to stop
+    [UnmanagedFunctionPointer(CallingConvention.Cdecl)]
+    public delegate int GeometryCallback(IntPtr userData, IntPtr geometry);
+
+    // Receives the next bytes of an exported document, returns 0 to abort
+    [UnmanagedFunctionPointer(CallingConvention.Cdecl)]
+    public delegate int WriteCallback(IntPtr userData, IntPtr data, long size);
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct ModelMemoryStats
+    {
+        public long SourceBytes;
+        public long TokenStreamBytes;
+        public long LineIndexBytes;
+        public long GeometryBytes;
+        public long WrapperBytes;
+        public long TableBytes;
+    }
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct TypeStats
+    {
+        public uint Type;
+        public int Reserved;
+        public long Elements;
+        public long Meshes;
+        public long Vertices;
+        public long Triangles;
+        public double Seconds;
+    }
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct ElementTiming
+    {
+        public uint ExpressId;
+        public uint Type;
+        public long Triangles;
+        public double Seconds;
+    }
+
+    public enum SkipReason
+    {
+        Exception = 1,
+        TimeBudget = 2,
+        TriangleBudget = 3,
+        Deadline = 4,
+    }
+
+    // An element whose geometry was discarded. Bounds are world-space, and only set if HasBounds is non-zero.
+    [StructLayout(LayoutKind.Sequential)]
+    public struct SkippedElement
+    {
+        public uint ExpressId;
+        public uint Type;
+        public SkipReason Reason;
+        public int HasBounds;
+        public long Triangles;
+        public double Seconds;
+        public double MinX, MinY, MinZ;
+        public double MaxX, MaxY, MaxZ;
+    }
+
+    // The arrays are owned by the model, and valid until the next call to GetStats
+    [StructLayout(LayoutKind.Sequential)]
+    public struct ModelStats
+    {
+        public long Elements;
+        public long Meshes;
+        public long Vertices;
+        public long Triangles;
+        public double TessellationSeconds;
+        public double ParseSeconds;
+        public double ExtractSeconds;
+        public long CacheHits;
+        public long CacheMisses;
+        public long BytesAllocated;
+        public int FromPersistentCache;
+        public int NumTypes;
+        public int NumSlowest;
+        public int NumSkipped;
+        public IntPtr Types;
+        public IntPtr Slowest;
+
+        public unsafe TypeStats[] GetTypes()
+            => new ReadOnlySpan<TypeStats>((void*)Types, NumTypes).ToArray();
+
+        public unsafe ElementTiming[] GetSlowest()
+            => new ReadOnlySpan<ElementTiming>((void*)Slowest, NumSlowest).ToArray();
+    }
+
+    // All meshes of a model, retrieved with two native calls 
+    public class ExportedMeshes
+    {
+        public MeshCounts Counts;
+        public double[] Vertices;
+        public uint[] Indices;
+        public uint[] ElementIds;
+        public uint[] GeometryIds;
+        public long[] VertexOffsets;
+        public int[] VertexCounts;
+        public long[] IndexOffsets;
+        public int[] IndexCounts;
+        public double[] Transforms;
+        public double[] Colors;
+
+        public unsafe ExportedMeshes(IntPtr api, IntPtr model)
+        {
+            WebIfcDll.GetMeshCounts(api, model, out Counts);
+            var numMeshes = Counts.NumMeshes;
+            Vertices = new double[Counts.NumVertices * 6];
+            Indices = new uint[Counts.NumIndices];
+            ElementIds = new uint[numMeshes];
+            GeometryIds = new uint[numMeshes];
+            VertexOffsets = new long[numMeshes];
+            VertexCounts = new int[numMeshes];
+            IndexOffsets = new long[numMeshes];
+            IndexCounts = new int[numMeshes];
+            Transforms = new double[numMeshes * 16];
+            Colors = new double[numMeshes * 4];
+
+            fixed (double* vertices = Vertices)
+            fixed (uint* indices = Indices)
+            fixed (uint* elementIds = ElementIds)
+            fixed (uint* geometryIds = GeometryIds)
+            fixed (long* vertexOffsets = VertexOffsets)
+            fixed (int* vertexCounts = VertexCounts)
+            fixed (long* indexOffsets = IndexOffsets)
+            fixed (int* indexCounts = IndexCounts)
+            fixed (double* transforms = Transforms)
+            fixed (double* colors = Colors)
+            {
+                var buffers = new MeshBuffers
+                {
+                    Vertices = (IntPtr)vertices,
+                    Indices = (IntPtr)indices,
+                    ElementIds = (IntPtr)elementIds,
+                    GeometryIds = (IntPtr)geometryIds,
+                    VertexOffsets = (IntPtr)vertexOffsets,
+                    VertexCounts = (IntPtr)vertexCounts,
+                    IndexOffsets = (IntPtr)indexOffsets,
+                    IndexCounts = (IntPtr)indexCounts,
+                    Transforms = (IntPtr)transforms,
+                    Colors = (IntPtr)colors,
+                    MeshCapacity = numMeshes,
+                    VertexCapacity = Counts.NumVertices,
+                    IndexCapacity = Counts.NumIndices,
+                };
+                WebIfcDll.ExportMeshes(api, model, ref buffers);
+            }
+        }
+    }
+
     public static class WebIfcDll
     {
         // NOTE: make sure the DLL is in the same directory as the built DLLs or Executable. 
+        // File names are passed as UTF-8, which is what the native API expects.
         private const string DllName = "web-ifc-dll.dll"; 
 
         // InitializeApi
         [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
         public static extern IntPtr InitializeApi();
 
+        // InitializeApiWithOptions
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern IntPtr InitializeApiWithOptions(ref ApiOptions options);
+
         // FinalizeApi
         [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
         public static extern void FinalizeApi(IntPtr api);
 
         // LoadModel
         [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
-        public static extern IntPtr LoadModel(IntPtr api, string fileName);
+        public static extern IntPtr LoadModel(IntPtr api, [MarshalAs(UnmanagedType.LPUTF8Str)] string fileName);
+
+        // LoadModelWithOptions
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern IntPtr LoadModelWithOptions(IntPtr api, [MarshalAs(UnmanagedType.LPUTF8Str)] string fileName, ref LoadOptions options);
+
+        // LoadModelFromBuffer
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern IntPtr LoadModelFromBuffer(IntPtr api, IntPtr data, UIntPtr size);
+
+        // LoadModelFromBufferWithOptions
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern IntPtr LoadModelFromBufferWithOptions(IntPtr api, IntPtr data, UIntPtr size, ref LoadOptions options);
+
+        // BeginLoadModel
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern IntPtr BeginLoadModel(IntPtr api, [MarshalAs(UnmanagedType.LPUTF8Str)] string fileName, ref LoadOptions options);
+
+        // BeginLoadModelFromBuffer
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern IntPtr BeginLoadModelFromBuffer(IntPtr api, IntPtr data, UIntPtr size, ref LoadOptions options);
+
+        // IsLoadJobDone
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern int IsLoadJobDone(IntPtr api, IntPtr job);
+
+        // EndLoadModel
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern IntPtr EndLoadModel(IntPtr api, IntPtr job);
+
+        // ReloadModel. Only new and modified elements are tessellated, the others reuse the geometry of previous.
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern IntPtr ReloadModel(IntPtr api, IntPtr previous, [MarshalAs(UnmanagedType.LPUTF8Str)] string fileName, ref LoadOptions options);
+
+        // ReloadModelFromBuffer
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern IntPtr ReloadModelFromBuffer(IntPtr api, IntPtr previous, IntPtr data, UIntPtr size, ref LoadOptions options);
+
+        // GetChangeSetCounts
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern void GetChangeSetCounts(IntPtr api, IntPtr model, out ChangeSetCounts counts);
+
+        // GetChangeSetArrays
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern void GetChangeSetArrays(IntPtr api, IntPtr model, out ChangeSetArrays arrays);
+
+        // UnloadModel
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern void UnloadModel(IntPtr api, IntPtr model);
+
+        // GetModelMemoryStats
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern void GetModelMemoryStats(IntPtr api, IntPtr model, out ModelMemoryStats stats);
+
+        // GetStats
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern void GetStats(IntPtr api, IntPtr model, out ModelStats stats);
+
+        // WriteTrace
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern int WriteTrace(IntPtr api, IntPtr model, [MarshalAs(UnmanagedType.LPUTF8Str)] string fileName);
+
+        // GetNumSkippedElements
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern long GetNumSkippedElements(IntPtr api, IntPtr model);
+
+        // GetSkippedElements
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern long GetSkippedElements(IntPtr api, IntPtr model, [Out] SkippedElement[] elements, long capacity);
 
         // GetGeometry
         [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
         public static extern IntPtr GetGeometry(IntPtr api, IntPtr model, uint id);
 
+        // GetGeometryId
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern uint GetGeometryId(IntPtr api, IntPtr geometry);
+
         // GetNumMeshes
         [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
         public static extern int GetNumMeshes(IntPtr api, IntPtr geometry);
@@ -55,5 +665,194 @@ namespace WebIfcDotNetTests
         // GetIndices
         [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
         public static extern IntPtr GetIndices(IntPtr api, IntPtr mesh);
+
+        // GetMeshBounds
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern void GetMeshBounds(IntPtr api, IntPtr mesh, double[] bounds);
+
+        // GetElementBounds
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern int GetElementBounds(IntPtr api, IntPtr model, uint id, double[] bounds);
+
+        // BuildSpatialIndex
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern long BuildSpatialIndex(IntPtr api, IntPtr model);
+
+        // QueryBox
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern long QueryBox(IntPtr api, IntPtr model, double[] box, uint[] ids, long capacity);
+
+        // QueryFrustum
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern long QueryFrustum(IntPtr api, IntPtr model, double[] planes, int numPlanes, uint[] ids, long capacity);
+
+        // QueryRay
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern long QueryRay(IntPtr api, IntPtr model, double[] origin, double[] direction, double maxDistance, uint[] ids, double[] distances, long capacity);
+
+        // QueryNearest
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern long QueryNearest(IntPtr api, IntPtr model, double[] point, uint[] ids, double[] distances, long count);
+
+        // BuildLods
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern int BuildLods(IntPtr api, IntPtr model, ref LodOptions options);
+
+        // GetNumLods
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern int GetNumLods(IntPtr api, IntPtr mesh);
+
+        // GetLodNumVertices
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern int GetLodNumVertices(IntPtr api, IntPtr mesh, int level);
+
+        // GetLodVertices
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern IntPtr GetLodVertices(IntPtr api, IntPtr mesh, int level);
+
+        // GetLodNumIndices
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern int GetLodNumIndices(IntPtr api, IntPtr mesh, int level);
+
+        // GetLodIndices
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern IntPtr GetLodIndices(IntPtr api, IntPtr mesh, int level);
+
+        // OptimizeGeometries
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern long OptimizeGeometries(IntPtr api, IntPtr model, ref OptimizeOptions options, out OptimizeStats stats);
+
+        // GetMeshCounts
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern void GetMeshCounts(IntPtr api, IntPtr model, out MeshCounts counts);
+
+        // ExportMeshes
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern long ExportMeshes(IntPtr api, IntPtr model, ref MeshBuffers buffers);
+
+        // GetVertexStride
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern int GetVertexStride(VertexFormat format);
+
+        // EncodeVertices
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern void EncodeVertices(IntPtr api, IntPtr mesh, ref VertexEncoding encoding, IntPtr vertices, IntPtr bounds);
+
+        // ExportEncodedMeshes
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern long ExportEncodedMeshes(IntPtr api, IntPtr model, ref VertexEncoding encoding, ref MeshBuffers buffers);
+
+        // GetInstanceCounts
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern void GetInstanceCounts(IntPtr api, IntPtr model, bool dedupByContent, out InstanceCounts counts);
+
+        // ExportInstances
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern long ExportInstances(IntPtr api, IntPtr model, bool dedupByContent, ref VertexEncoding encoding, ref InstanceBuffers buffers);
+
+        // GetBatchCounts
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern void GetBatchCounts(IntPtr api, IntPtr model, int maxVerticesPerBatch, out BatchCounts counts);
+
+        // ExportBatches
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern long ExportBatches(IntPtr api, IntPtr model, int maxVerticesPerBatch, ref VertexEncoding encoding, ref BatchBuffers buffers);
+
+        // ExportGlb
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern long ExportGlb(IntPtr api, IntPtr model, [MarshalAs(UnmanagedType.LPUTF8Str)] string fileName, ref GlbOptions options);
+
+        // ExportGlbToSink
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern long ExportGlbToSink(IntPtr api, IntPtr model, ref GlbOptions options, WriteCallback write, IntPtr userData);
+
+        // ExportSpeckle. rootId receives the 32 character ID of the root object and a terminating zero,
+        // so it must hold at least 33 bytes, or -1 is returned.
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern long ExportSpeckle(IntPtr api, IntPtr model, [MarshalAs(UnmanagedType.LPUTF8Str)] string fileName, ref SpeckleOptions options, byte[] rootId, long rootIdCapacity);
+
+        // ExportSpeckleToSink
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern long ExportSpeckleToSink(IntPtr api, IntPtr model, ref SpeckleOptions options, WriteCallback write, IntPtr userData, byte[] rootId, long rootIdCapacity);
+
+        // GetTypeCode
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern uint GetTypeCode(IntPtr api, [MarshalAs(UnmanagedType.LPUTF8Str)] string typeName);
+
+        // DecodeLines
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern IntPtr DecodeLines(IntPtr api, IntPtr model, uint[] expressIds, long count);
+
+        // DecodeLinesOfType
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern IntPtr DecodeLinesOfType(IntPtr api, IntPtr model, uint type);
+
+        // GetLineTableCounts
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern void GetLineTableCounts(IntPtr api, IntPtr table, out LineTableCounts counts);
+
+        // GetLineTableArrays
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern void GetLineTableArrays(IntPtr api, IntPtr table, out LineTableArrays arrays);
+
+        // FreeLineTable
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern void FreeLineTable(IntPtr api, IntPtr table);
+
+        // GetRelationIndexCounts
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern void GetRelationIndexCounts(IntPtr api, IntPtr model, out RelationIndexCounts counts);
+
+        // GetRelationIndexArrays
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern void GetRelationIndexArrays(IntPtr api, IntPtr model, out RelationIndexArrays arrays);
+
+        // GetPropertyTableCounts
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern void GetPropertyTableCounts(IntPtr api, IntPtr model, out PropertyTableCounts counts);
+
+        // GetPropertyTableArrays
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern void GetPropertyTableArrays(IntPtr api, IntPtr model, out PropertyTableArrays arrays);
+
+        // GetGlobalIdTableCounts
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern void GetGlobalIdTableCounts(IntPtr api, IntPtr model, out GlobalIdTableCounts counts);
+
+        // GetGlobalIdTableArrays
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern void GetGlobalIdTableArrays(IntPtr api, IntPtr model, out GlobalIdTableArrays arrays);
+
+        // GetGlobalIds. guids receives 16 bytes per express ID, zero for those without a GlobalId.
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern long GetGlobalIds(IntPtr api, IntPtr model, uint[] expressIds, long count, byte[] guids);
+
+        // GetExpressIdsOfGlobalIds. expressIds receives 0 for GlobalIds that are not used.
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern long GetExpressIdsOfGlobalIds(IntPtr api, IntPtr model, byte[] guids, long count, uint[] expressIds);
+
+        // DecodeGlobalId
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern int DecodeGlobalId([MarshalAs(UnmanagedType.LPUTF8Str)] string globalId, byte[] guid);
+
+        // EncodeGlobalId. globalId receives 22 characters and a terminating zero.
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern void EncodeGlobalId(byte[] guid, byte[] globalId);
+
+        // BeginGeometryStream
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern IntPtr BeginGeometryStream(IntPtr api, IntPtr model, ref StreamOptions options);
+
+        // NextStreamedGeometry
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern IntPtr NextStreamedGeometry(IntPtr api, IntPtr stream);
+
+        // EndGeometryStream
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern int EndGeometryStream(IntPtr api, IntPtr stream);
+
+        // StreamGeometry
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern long StreamGeometry(IntPtr api, IntPtr model, ref StreamOptions options, GeometryCallback callback, IntPtr userData);
     }
 }
\ No newline at end of file
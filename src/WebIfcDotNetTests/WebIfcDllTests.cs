@@ -1,4 +1,5 @@
-﻿using Ara3D.IfcParser;
+﻿using System.Runtime.InteropServices;
+using Ara3D.IfcParser;
 using Ara3D.Logging;
 using Ara3D.StepParser;
 using Ara3D.Utils;
@@ -98,4 +99,958 @@ public static class WebIfcDllTests
 
         logger.Log("Enumerated over all nodes");
     }
+
+    public static double[] GetDoubles(IntPtr ptr, int count)
+    {
+        var r = new double[count];
+        Marshal.Copy(ptr, r, 0, count);
+        return r;
+    }
+
+    public static int[] GetInts(IntPtr ptr, int count)
+    {
+        var r = new int[count];
+        Marshal.Copy(ptr, r, 0, count);
+        return r;
+    }
+
+    public static SkippedElement[] GetSkippedElements(IntPtr api, IntPtr model)
+    {
+        var r = new SkippedElement[WebIfcDll.GetNumSkippedElements(api, model)];
+        WebIfcDll.GetSkippedElements(api, model, r, r.Length);
+        return r;
+    }
+
+    public static void AssertSameGeometry(IntPtr api1, IntPtr geo1, IntPtr api2, IntPtr geo2)
+    {
+        var numMeshes = WebIfcDll.GetNumMeshes(api1, geo1);
+        Assert.AreEqual(numMeshes, WebIfcDll.GetNumMeshes(api2, geo2));
+        for (var i = 0; i < numMeshes; ++i)
+        {
+            var m1 = WebIfcDll.GetMesh(api1, geo1, i);
+            var m2 = WebIfcDll.GetMesh(api2, geo2, i);
+            var numVertices = WebIfcDll.GetNumVertices(api1, m1);
+            var numIndices = WebIfcDll.GetNumIndices(api1, m1);
+            Assert.AreEqual(numVertices, WebIfcDll.GetNumVertices(api2, m2));
+            Assert.AreEqual(numIndices, WebIfcDll.GetNumIndices(api2, m2));
+            Assert.AreEqual(GetDoubles(WebIfcDll.GetTransform(api1, m1), 16), GetDoubles(WebIfcDll.GetTransform(api2, m2), 16));
+            Assert.AreEqual(GetDoubles(WebIfcDll.GetColor(api1, m1), 4), GetDoubles(WebIfcDll.GetColor(api2, m2), 4));
+            Assert.AreEqual(GetDoubles(WebIfcDll.GetVertices(api1, m1), numVertices * 6), GetDoubles(WebIfcDll.GetVertices(api2, m2), numVertices * 6));
+            Assert.AreEqual(GetInts(WebIfcDll.GetIndices(api1, m1), numIndices), GetInts(WebIfcDll.GetIndices(api2, m2), numIndices));
+        }
+    }
+
+    [Test]
+    public static void TestParallelExtractionMatchesSerial()
+    {
+        var logger = CreateLogger();
+        var api = WebIfcDll.InitializeApi();
+
+        var serialOptions = LoadOptions.Default;
+        var serial = WebIfcDll.LoadModelWithOptions(api, inputFile, ref serialOptions);
+        logger.Log("Loaded model serially");
+
+        var parallelOptions = new LoadOptions { NumThreads = 0 };
+        var parallel = WebIfcDll.LoadModelWithOptions(api, inputFile, ref parallelOptions);
+        logger.Log("Loaded model in parallel");
+
+        var g = LoadIfc(inputFile);
+        foreach (var n in g.GetNodes())
+        {
+            var geo1 = WebIfcDll.GetGeometry(api, serial, n.Id);
+            var geo2 = WebIfcDll.GetGeometry(api, parallel, n.Id);
+            Assert.AreEqual(geo1 == IntPtr.Zero, geo2 == IntPtr.Zero);
+            if (geo1 != IntPtr.Zero)
+                AssertSameGeometry(api, geo1, api, geo2);
+        }
+
+        logger.Log("Compared all geometries");
+        WebIfcDll.FinalizeApi(api);
+    }
+
+    [Test]
+    public static void TestBulkExportMatchesPerMeshCalls()
+    {
+        var logger = CreateLogger();
+        var api = WebIfcDll.InitializeApi();
+        var model = WebIfcDll.LoadModel(api, inputFile);
+        logger.Log("Loaded model");
+
+        var exported = new ExportedMeshes(api, model);
+        logger.Log($"Exported {exported.Counts.NumMeshes} meshes from {exported.Counts.NumElements} elements");
+
+        for (var i = 0; i < exported.Counts.NumMeshes; ++i)
+        {
+            var geo = WebIfcDll.GetGeometry(api, model, exported.ElementIds[i]);
+            Assert.AreNotEqual(IntPtr.Zero, geo);
+            var numMeshes = WebIfcDll.GetNumMeshes(api, geo);
+            var j = 0;
+            while (i + j + 1 < exported.Counts.NumMeshes && exported.ElementIds[i + j + 1] == exported.ElementIds[i])
+                j++;
+            Assert.AreEqual(numMeshes, j + 1);
+
+            for (var k = 0; k < numMeshes; ++k, ++i)
+            {
+                var mesh = WebIfcDll.GetMesh(api, geo, k);
+                var numVertices = WebIfcDll.GetNumVertices(api, mesh);
+                var numIndices = WebIfcDll.GetNumIndices(api, mesh);
+                Assert.AreEqual(numVertices, exported.VertexCounts[i]);
+                Assert.AreEqual(numIndices, exported.IndexCounts[i]);
+                Assert.AreEqual(GetDoubles(WebIfcDll.GetVertices(api, mesh), numVertices * 6),
+                    exported.Vertices.Skip((int)exported.VertexOffsets[i] * 6).Take(numVertices * 6).ToArray());
+                Assert.AreEqual(GetDoubles(WebIfcDll.GetTransform(api, mesh), 16),
+                    exported.Transforms.Skip(i * 16).Take(16).ToArray());
+            }
+            i--;
+        }
+
+        WebIfcDll.FinalizeApi(api);
+    }
+
+    [Test]
+    public static unsafe void TestInstanceTable()
+    {
+        var logger = CreateLogger();
+        var api = WebIfcDll.InitializeApi();
+        var model = WebIfcDll.LoadModel(api, inputFile);
+
+        WebIfcDll.GetMeshCounts(api, model, out var meshCounts);
+        WebIfcDll.GetInstanceCounts(api, model, false, out var byId);
+        WebIfcDll.GetInstanceCounts(api, model, true, out var byContent);
+        logger.Log($"{meshCounts.NumMeshes} meshes, {byId.NumGeometries} geometries by ID, {byContent.NumGeometries} geometries by content");
+
+        Assert.AreEqual(meshCounts.NumMeshes, byId.NumInstances);
+        Assert.AreEqual(meshCounts.NumMeshes, byContent.NumInstances);
+        Assert.LessOrEqual(byContent.NumGeometries, byId.NumGeometries);
+        Assert.LessOrEqual(byContent.NumVertices, meshCounts.NumVertices);
+
+        var hashes = new ulong[byContent.NumGeometries];
+        var geometryIndices = new int[byContent.NumInstances];
+        fixed (ulong* hashesPtr = hashes)
+        fixed (int* geometryIndicesPtr = geometryIndices)
+        {
+            var encoding = new VertexEncoding { Format = VertexFormat.Double };
+            var buffers = new InstanceBuffers
+            {
+                GeometryHashes = (IntPtr)hashesPtr,
+                GeometryIndices = (IntPtr)geometryIndicesPtr,
+            };
+            WebIfcDll.ExportInstances(api, model, true, ref encoding, ref buffers);
+        }
+        Assert.IsTrue(geometryIndices.All(i => i >= 0 && i < byContent.NumGeometries));
+
+        WebIfcDll.FinalizeApi(api);
+    }
+
+    [Test]
+    public static void TestLoadFromBufferMatchesFile()
+    {
+        var logger = CreateLogger();
+        var api = WebIfcDll.InitializeApi();
+        var fromFile = WebIfcDll.LoadModel(api, inputFile);
+        logger.Log("Loaded model from file");
+
+        var bytes = File.ReadAllBytes(inputFile);
+        var data = Marshal.AllocHGlobal(bytes.Length);
+        try
+        {
+            Marshal.Copy(bytes, 0, data, bytes.Length);
+            var fromBuffer = WebIfcDll.LoadModelFromBuffer(api, data, (UIntPtr)bytes.Length);
+            logger.Log("Loaded model from buffer");
+
+            WebIfcDll.GetMeshCounts(api, fromFile, out var fileCounts);
+            WebIfcDll.GetMeshCounts(api, fromBuffer, out var bufferCounts);
+            Assert.AreEqual(fileCounts, bufferCounts);
+        }
+        finally
+        {
+            WebIfcDll.FinalizeApi(api);
+            Marshal.FreeHGlobal(data);
+        }
+    }
+
+    [Test]
+    public static void TestGeometryCacheMatchesUncached()
+    {
+        var logger = CreateLogger();
+        var cacheDirectory = Path.Combine(Path.GetTempPath(), "web-ifc-cache-test");
+        if (Directory.Exists(cacheDirectory))
+            Directory.Delete(cacheDirectory, true);
+        var api = WebIfcDll.InitializeApi();
+
+        var uncachedOptions = LoadOptions.Default;
+        var uncached = WebIfcDll.LoadModelWithOptions(api, inputFile, ref uncachedOptions);
+
+        var cachedOptions = new LoadOptions { NumThreads = 1, CacheDirectory = cacheDirectory };
+        var sw = System.Diagnostics.Stopwatch.StartNew();
+        WebIfcDll.LoadModelWithOptions(api, inputFile, ref cachedOptions);
+        logger.Log($"Cold load took {sw.ElapsedMilliseconds} msec");
+        Assert.AreEqual(1, Directory.GetFiles(cacheDirectory).Length);
+
+        sw.Restart();
+        var cached = WebIfcDll.LoadModelWithOptions(api, inputFile, ref cachedOptions);
+        logger.Log($"Warm load took {sw.ElapsedMilliseconds} msec");
+
+        var g = LoadIfc(inputFile);
+        foreach (var n in g.GetNodes())
+        {
+            var geo1 = WebIfcDll.GetGeometry(api, uncached, n.Id);
+            var geo2 = WebIfcDll.GetGeometry(api, cached, n.Id);
+            Assert.AreEqual(geo1 == IntPtr.Zero, geo2 == IntPtr.Zero);
+            if (geo1 != IntPtr.Zero)
+                AssertSameGeometry(api, geo1, api, geo2);
+        }
+
+        WebIfcDll.FinalizeApi(api);
+        Directory.Delete(cacheDirectory, true);
+    }
+
+    [Test]
+    public static void TestLazyExtractionMatchesEager()
+    {
+        var logger = CreateLogger();
+        var api = WebIfcDll.InitializeApi();
+
+        var eagerOptions = LoadOptions.Default;
+        var eager = WebIfcDll.LoadModelWithOptions(api, inputFile, ref eagerOptions);
+        logger.Log("Loaded model eagerly");
+
+        var lazyOptions = new LoadOptions { NumThreads = 1, Lazy = true, CacheBudgetBytes = 1024 * 1024 };
+        var lazy = WebIfcDll.LoadModelWithOptions(api, inputFile, ref lazyOptions);
+        logger.Log("Loaded model lazily");
+
+        var g = LoadIfc(inputFile);
+        foreach (var n in g.GetNodes())
+        {
+            var geo1 = WebIfcDll.GetGeometry(api, eager, n.Id);
+            var geo2 = WebIfcDll.GetGeometry(api, lazy, n.Id);
+            Assert.AreEqual(geo1 == IntPtr.Zero, geo2 == IntPtr.Zero);
+            if (geo1 != IntPtr.Zero)
+                AssertSameGeometry(api, geo1, api, geo2);
+        }
+
+        logger.Log("Compared all geometries");
+        WebIfcDll.FinalizeApi(api);
+    }
+
+    [Test]
+    public static void TestStreamedGeometryMatchesEager()
+    {
+        var logger = CreateLogger();
+        var api = WebIfcDll.InitializeApi();
+
+        var eagerOptions = LoadOptions.Default;
+        var eager = WebIfcDll.LoadModelWithOptions(api, inputFile, ref eagerOptions);
+
+        var lazyOptions = new LoadOptions { NumThreads = 1, Lazy = true };
+        var lazy = WebIfcDll.LoadModelWithOptions(api, inputFile, ref lazyOptions);
+
+        // A small queue and processor budget exercise the backpressure and cache clearing paths
+        var streamOptions = new StreamOptions { NumThreads = 4, QueueCapacity = 2, ProcessorBudgetBytes = 1024 * 1024 };
+        var stream = WebIfcDll.BeginGeometryStream(api, lazy, ref streamOptions);
+        var ids = new HashSet<uint>();
+        for (var geo = WebIfcDll.NextStreamedGeometry(api, stream); geo != IntPtr.Zero; geo = WebIfcDll.NextStreamedGeometry(api, stream))
+        {
+            var id = WebIfcDll.GetGeometryId(api, geo);
+            Assert.IsTrue(ids.Add(id));
+            AssertSameGeometry(api, WebIfcDll.GetGeometry(api, eager, id), api, geo);
+        }
+        Assert.AreEqual(0, WebIfcDll.EndGeometryStream(api, stream));
+        Assert.IsTrue(ids.Count > 0);
+        logger.Log($"Streamed {ids.Count} elements");
+
+        // The callback form can stop early
+        var delivered = 0;
+        var n = WebIfcDll.StreamGeometry(api, lazy, ref streamOptions, (_, _) => ++delivered < 10 ? 1 : 0, IntPtr.Zero);
+        Assert.AreEqual(Math.Min(10, ids.Count), n);
+
+        WebIfcDll.FinalizeApi(api);
+    }
+
+    [Test]
+    public static void TestUnloadModel()
+    {
+        var logger = CreateLogger();
+        var api = WebIfcDll.InitializeApi();
+        var options = new LoadOptions { NumThreads = 4 };
+
+        for (var i = 0; i < 3; i++)
+        {
+            var model = WebIfcDll.LoadModelWithOptions(api, inputFile, ref options);
+            WebIfcDll.GetModelMemoryStats(api, model, out var stats);
+            logger.Log($"Source {stats.SourceBytes}, tokens {stats.TokenStreamBytes}, lines {stats.LineIndexBytes}, " +
+                       $"geometry {stats.GeometryBytes}, wrappers {stats.WrapperBytes}, tables {stats.TableBytes}");
+            Assert.IsTrue(stats.SourceBytes > 0);
+            Assert.IsTrue(stats.TokenStreamBytes > 0);
+            Assert.IsTrue(stats.GeometryBytes > 0);
+            Assert.IsTrue(stats.WrapperBytes > 0);
+            WebIfcDll.UnloadModel(api, model);
+        }
+
+        // Models that are not unloaded are released by FinalizeApi
+        WebIfcDll.LoadModelWithOptions(api, inputFile, ref options);
+        WebIfcDll.FinalizeApi(api);
+    }
+
+    [Test]
+    public static void TestStats()
+    {
+        var logger = CreateLogger();
+        var api = WebIfcDll.InitializeApi();
+        var options = new LoadOptions { NumThreads = 4, Trace = true };
+        var model = WebIfcDll.LoadModelWithOptions(api, inputFile, ref options);
+
+        WebIfcDll.GetStats(api, model, out var stats);
+        logger.Log($"Tessellated {stats.Elements} elements, {stats.Triangles} triangles in {stats.TessellationSeconds:F3}s, " +
+                   $"parse {stats.ParseSeconds:F3}s, extract {stats.ExtractSeconds:F3}s, allocated {stats.BytesAllocated}");
+
+        // During an eager load every element is tessellated once, so the totals match the exported meshes
+        WebIfcDll.GetMeshCounts(api, model, out var counts);
+        Assert.AreEqual(counts.NumMeshes, stats.Meshes);
+        Assert.AreEqual(counts.NumVertices, stats.Vertices);
+        Assert.AreEqual(counts.NumIndices / 3, stats.Triangles);
+        Assert.IsTrue(stats.ParseSeconds > 0);
+        Assert.IsTrue(stats.BytesAllocated > 0);
+
+        var types = stats.GetTypes();
+        Assert.AreEqual(stats.Elements, types.Sum(t => t.Elements));
+        foreach (var t in types)
+            logger.Log($"Type {t.Type}: {t.Elements} elements, {t.Triangles} triangles, {t.Seconds:F4}s");
+
+        var slowest = stats.GetSlowest();
+        Assert.IsTrue(slowest.Length > 0);
+        for (var i = 1; i < slowest.Length; i++)
+            Assert.IsTrue(slowest[i - 1].Seconds >= slowest[i].Seconds);
+        logger.Log($"Slowest element #{slowest[0].ExpressId} took {slowest[0].Seconds:F4}s");
+
+        var tracePath = Path.Combine(Path.GetTempPath(), "web-ifc-trace.json");
+        Assert.AreEqual(0, WebIfcDll.WriteTrace(api, model, tracePath));
+        Assert.IsTrue(File.ReadAllText(tracePath).StartsWith("{\"traceEvents\""));
+        logger.Log($"Wrote trace to {tracePath}");
+
+        WebIfcDll.FinalizeApi(api);
+    }
+
+    [Test]
+    public static void TestSkipReport()
+    {
+        var logger = CreateLogger();
+        var api = WebIfcDll.InitializeApi();
+        var model = WebIfcDll.LoadModel(api, inputFile);
+        var full = new ExportedMeshes(api, model);
+
+        // Elements over the triangle budget are reported with their bounds, and have no geometry
+        var options = new LoadOptions { NumThreads = 4, ElementTriangleBudget = 100 };
+        var budgeted = WebIfcDll.LoadModelWithOptions(api, inputFile, ref options);
+        var skipped = GetSkippedElements(api, budgeted);
+        Assert.IsTrue(skipped.Length > 0);
+        WebIfcDll.GetStats(api, budgeted, out var stats);
+        Assert.AreEqual(skipped.Length, stats.NumSkipped);
+        foreach (var s in skipped)
+        {
+            Assert.AreEqual(SkipReason.TriangleBudget, s.Reason);
+            Assert.IsTrue(s.Triangles > 100);
+            Assert.AreNotEqual(0, s.HasBounds);
+            Assert.IsTrue(s.MinX <= s.MaxX && s.MinY <= s.MaxY && s.MinZ <= s.MaxZ);
+            Assert.AreEqual(IntPtr.Zero, WebIfcDll.GetGeometry(api, budgeted, s.ExpressId));
+        }
+        logger.Log($"Skipped {skipped.Length} elements over the triangle budget");
+
+        // The other elements are unchanged
+        var kept = new ExportedMeshes(api, budgeted);
+        var skippedIds = skipped.Select(s => s.ExpressId).ToHashSet();
+        Assert.AreEqual(full.ElementIds.Count(id => !skippedIds.Contains(id)), kept.Counts.NumMeshes);
+
+        // Once the deadline has passed, the remaining elements are skipped without being tessellated
+        options = new LoadOptions { NumThreads = 1, ExtractTimeBudgetSeconds = 1e-9 };
+        var late = WebIfcDll.LoadModelWithOptions(api, inputFile, ref options);
+        skipped = GetSkippedElements(api, late);
+        Assert.IsTrue(skipped.Length > 0);
+        Assert.IsTrue(skipped.All(s => s.Reason == SkipReason.Deadline && s.HasBounds == 0));
+        logger.Log($"Skipped {skipped.Length} elements after the deadline");
+
+        WebIfcDll.FinalizeApi(api);
+    }
+
+    public static uint[] GetLineIdsOfType(IntPtr api, IntPtr model, string typeName)
+    {
+        var table = WebIfcDll.DecodeLinesOfType(api, model, WebIfcDll.GetTypeCode(api, typeName));
+        WebIfcDll.GetLineTableCounts(api, table, out var counts);
+        WebIfcDll.GetLineTableArrays(api, table, out var arrays);
+        var r = new int[counts.NumLines];
+        Marshal.Copy(arrays.LineIds, r, 0, r.Length);
+        WebIfcDll.FreeLineTable(api, table);
+        return r.Select(id => (uint)id).ToArray();
+    }
+
+    public static unsafe IntPtr LoadFiltered(IntPtr api, uint[] includeTypes, uint[] containers, uint[] expressIds)
+    {
+        fixed (uint* include = includeTypes)
+        fixed (uint* within = containers)
+        fixed (uint* ids = expressIds)
+        {
+            var filter = new ElementFilterSpec
+            {
+                IncludeTypes = (IntPtr)include, NumIncludeTypes = includeTypes.Length,
+                Containers = (IntPtr)within, NumContainers = containers.Length,
+                ExpressIds = (IntPtr)ids, NumExpressIds = expressIds.Length,
+            };
+            var options = new LoadOptions { NumThreads = 4, Filter = (IntPtr)(&filter) };
+            return WebIfcDll.LoadModelWithOptions(api, inputFile, ref options);
+        }
+    }
+
+    [Test]
+    public static void TestElementFilter()
+    {
+        var logger = CreateLogger();
+        var api = WebIfcDll.InitializeApi();
+        var model = WebIfcDll.LoadModel(api, inputFile);
+        var all = new ExportedMeshes(api, model).ElementIds.ToHashSet();
+        var none = Array.Empty<uint>();
+
+        // Type filter
+        var walls = new[] { "IFCWALL", "IFCWALLSTANDARDCASE" }.Select(t => WebIfcDll.GetTypeCode(api, t)).ToArray();
+        var wallIds = new[] { "IFCWALL", "IFCWALLSTANDARDCASE" }.SelectMany(t => GetLineIdsOfType(api, model, t)).ToHashSet();
+        var filtered = new ExportedMeshes(api, LoadFiltered(api, walls, none, none)).ElementIds.ToHashSet();
+        Assert.IsTrue(filtered.Count > 0);
+        Assert.IsTrue(filtered.SetEquals(all.Where(wallIds.Contains)));
+        logger.Log($"Kept {filtered.Count} of {all.Count} elements by type");
+
+        // Explicitly included types are not excluded by default
+        var spaces = new[] { WebIfcDll.GetTypeCode(api, "IFCSPACE") };
+        filtered = new ExportedMeshes(api, LoadFiltered(api, spaces, none, none)).ElementIds.ToHashSet();
+        Assert.IsTrue(filtered.Count > 0);
+        Assert.IsFalse(filtered.Overlaps(all));
+        logger.Log($"Kept {filtered.Count} spaces");
+
+        // Spatial filter: no element is in two storeys
+        var storeys = GetLineIdsOfType(api, model, "IFCBUILDINGSTOREY");
+        Assert.IsTrue(storeys.Length > 1);
+        var union = new HashSet<uint>();
+        foreach (var storey in storeys)
+        {
+            filtered = new ExportedMeshes(api, LoadFiltered(api, none, new[] { storey }, none)).ElementIds.ToHashSet();
+            Assert.IsTrue(filtered.IsSubsetOf(all));
+            Assert.IsFalse(filtered.Overlaps(union));
+            union.UnionWith(filtered);
+            logger.Log($"Kept {filtered.Count} elements in storey #{storey}");
+        }
+        Assert.IsTrue(union.Count > 0);
+
+        // Express ID allowlist
+        var allowed = all.Take(3).ToArray();
+        filtered = new ExportedMeshes(api, LoadFiltered(api, none, none, allowed)).ElementIds.ToHashSet();
+        Assert.IsTrue(filtered.SetEquals(allowed));
+
+        WebIfcDll.FinalizeApi(api);
+    }
+
+    [Test]
+    public static void TestConcurrentLoads()
+    {
+        var logger = CreateLogger();
+        var api = WebIfcDll.InitializeApi();
+        var expected = new ExportedMeshes(api, WebIfcDll.LoadModel(api, inputFile));
+
+        // Jobs on the internal queue
+        var apiOptions = new ApiOptions { NumWorkers = 4 };
+        var jobApi = WebIfcDll.InitializeApiWithOptions(ref apiOptions);
+        var options = LoadOptions.Default;
+        var jobs = Enumerable.Range(0, 8).Select(_ => WebIfcDll.BeginLoadModel(jobApi, inputFile, ref options)).ToList();
+        var sw = System.Diagnostics.Stopwatch.StartNew();
+        foreach (var job in jobs)
+        {
+            var model = WebIfcDll.EndLoadModel(jobApi, job);
+            Assert.AreNotEqual(IntPtr.Zero, model);
+            Assert.AreEqual(expected.Vertices, new ExportedMeshes(jobApi, model).Vertices);
+            WebIfcDll.UnloadModel(jobApi, model);
+        }
+        logger.Log($"Loaded {jobs.Count} models on the job queue in {sw.Elapsed.TotalSeconds:F3}s");
+
+        // Caller threads loading and querying models of the same Api at once
+        Parallel.For(0, 8, _ =>
+        {
+            var model = WebIfcDll.LoadModel(jobApi, inputFile);
+            Assert.AreEqual(expected.Indices, new ExportedMeshes(jobApi, model).Indices);
+            WebIfcDll.UnloadModel(jobApi, model);
+        });
+        logger.Log($"Loaded 8 models from parallel threads");
+
+        WebIfcDll.FinalizeApi(jobApi);
+        WebIfcDll.FinalizeApi(api);
+    }
+
+    [Test]
+    public static unsafe void TestLods()
+    {
+        var logger = CreateLogger();
+        var api = WebIfcDll.InitializeApi();
+        var model = WebIfcDll.LoadModel(api, inputFile);
+        var ratios = new[] { 0.5, 0.1 };
+        fixed (double* r = ratios)
+        {
+            var options = new LodOptions { NumLevels = ratios.Length, TriangleRatios = (IntPtr)r };
+            Assert.AreEqual(ratios.Length, WebIfcDll.BuildLods(api, model, ref options));
+        }
+
+        var triangles = new long[ratios.Length + 1];
+        var exported = new ExportedMeshes(api, model);
+        foreach (var id in exported.ElementIds.Distinct())
+        {
+            var geo = WebIfcDll.GetGeometry(api, model, id);
+            for (var i = 0; i < WebIfcDll.GetNumMeshes(api, geo); i++)
+            {
+                var mesh = WebIfcDll.GetMesh(api, geo, i);
+                Assert.AreEqual(ratios.Length, WebIfcDll.GetNumLods(api, mesh));
+                var previous = WebIfcDll.GetNumIndices(api, mesh);
+                triangles[0] += previous / 3;
+                for (var level = 0; level < ratios.Length; level++)
+                {
+                    var numIndices = WebIfcDll.GetLodNumIndices(api, mesh, level);
+                    var numVertices = WebIfcDll.GetLodNumVertices(api, mesh, level);
+                    Assert.IsTrue(numIndices <= previous);
+                    var indices = GetInts(WebIfcDll.GetLodIndices(api, mesh, level), numIndices);
+                    Assert.IsTrue(indices.All(x => x >= 0 && x < numVertices));
+                    triangles[level + 1] += numIndices / 3;
+                    previous = numIndices;
+                }
+            }
+        }
+        logger.Log($"Triangles per level: {string.Join(", ", triangles)}");
+        Assert.IsTrue(triangles[2] < triangles[0]);
+
+        WebIfcDll.FinalizeApi(api);
+    }
+
+    [Test]
+    public static void TestOptimizeGeometries()
+    {
+        var logger = CreateLogger();
+        var api = WebIfcDll.InitializeApi();
+        var model = WebIfcDll.LoadModel(api, inputFile);
+        var before = new ExportedMeshes(api, model);
+
+        var options = new OptimizeOptions
+        {
+            PositionTolerance = 1e-6,
+            NormalTolerance = 0.01,
+            Weld = 1,
+            RemoveDegenerates = 1,
+            OptimizeVertexCache = 1,
+            OptimizeVertexFetch = 1,
+        };
+        var numGeometries = WebIfcDll.OptimizeGeometries(api, model, ref options, out var stats);
+        logger.Log($"Geometries: {stats.Geometries}, vertices: {stats.VerticesBefore} -> {stats.VerticesAfter}, " 
+            + $"indices: {stats.IndicesBefore} -> {stats.IndicesAfter}, " 
+            + $"cache miss ratio: {stats.CacheMissRatioBefore:F3} -> {stats.CacheMissRatioAfter:F3}");
+        Assert.IsTrue(numGeometries > 0);
+        Assert.AreEqual(numGeometries, stats.Geometries);
+        Assert.IsTrue(stats.VerticesAfter < stats.VerticesBefore);
+        Assert.IsTrue(stats.IndicesAfter <= stats.IndicesBefore);
+        Assert.IsTrue(stats.CacheMissRatioAfter <= stats.CacheMissRatioBefore);
+
+        var after = new ExportedMeshes(api, model);
+        Assert.AreEqual(before.Counts.NumMeshes, after.Counts.NumMeshes);
+        Assert.IsTrue(after.Counts.NumVertices < before.Counts.NumVertices);
+        for (var i = 0; i < after.Counts.NumMeshes; i++)
+        {
+            Assert.AreEqual(before.ElementIds[i], after.ElementIds[i]);
+            Assert.IsTrue(after.IndexCounts[i] <= before.IndexCounts[i]);
+            for (var j = 0; j < after.IndexCounts[i]; j++)
+                Assert.IsTrue(after.Indices[after.IndexOffsets[i] + j] < after.VertexCounts[i]);
+        }
+
+        WebIfcDll.FinalizeApi(api);
+    }
+
+    [Test]
+    public static void TestSpatialIndex()
+    {
+        var logger = CreateLogger();
+        var api = WebIfcDll.InitializeApi();
+        var model = WebIfcDll.LoadModel(api, inputFile);
+        var exported = new ExportedMeshes(api, model);
+
+        // Element bounds contain the bounds of their meshes
+        var elementBounds = new Dictionary<uint, double[]>();
+        foreach (var id in exported.ElementIds.Distinct())
+        {
+            var bounds = new double[6];
+            if (WebIfcDll.GetElementBounds(api, model, id, bounds) == 0)
+                continue;
+            elementBounds[id] = bounds;
+            var geo = WebIfcDll.GetGeometry(api, model, id);
+            for (var i = 0; i < WebIfcDll.GetNumMeshes(api, geo); i++)
+            {
+                var meshBounds = new double[6];
+                WebIfcDll.GetMeshBounds(api, WebIfcDll.GetMesh(api, geo, i), meshBounds);
+                if (meshBounds[0] > meshBounds[3])
+                    continue;
+                for (var r = 0; r < 3; r++)
+                {
+                    Assert.IsTrue(meshBounds[r] >= bounds[r]);
+                    Assert.IsTrue(meshBounds[r + 3] <= bounds[r + 3]);
+                }
+            }
+        }
+
+        var watch = System.Diagnostics.Stopwatch.StartNew();
+        Assert.AreEqual(elementBounds.Count, WebIfcDll.BuildSpatialIndex(api, model));
+        logger.Log($"Built spatial index over {elementBounds.Count} elements in {watch.ElapsedMilliseconds} msec");
+
+        // A box around the middle of the model matches a brute force search
+        var all = elementBounds.Values.Aggregate((a, b) => new[] 
+            { Math.Min(a[0], b[0]), Math.Min(a[1], b[1]), Math.Min(a[2], b[2]), Math.Max(a[3], b[3]), Math.Max(a[4], b[4]), Math.Max(a[5], b[5]) });
+        var box = new double[6];
+        for (var r = 0; r < 3; r++)
+        {
+            var quarter = (all[r + 3] - all[r]) / 4;
+            box[r] = all[r] + quarter;
+            box[r + 3] = all[r + 3] - quarter;
+        }
+        var expected = elementBounds
+            .Where(kv => Enumerable.Range(0, 3).All(r => kv.Value[r] <= box[r + 3] && kv.Value[r + 3] >= box[r]))
+            .Select(kv => kv.Key).OrderBy(x => x).ToList();
+        var ids = new uint[elementBounds.Count];
+        var n = WebIfcDll.QueryBox(api, model, box, ids, ids.Length);
+        CollectionAssert.AreEqual(expected, ids.Take((int)n).OrderBy(x => x).ToList());
+        Assert.AreEqual(n, WebIfcDll.QueryBox(api, model, box, ids, 0));
+
+        // The six planes of the full bounds keep every element
+        var planes = new[]
+        {
+            1, 0, 0, -all[0], -1, 0, 0, all[3],
+            0, 1, 0, -all[1], 0, -1, 0, all[4],
+            0, 0, 1, -all[2], 0, 0, -1, all[5],
+        };
+        Assert.AreEqual(elementBounds.Count, WebIfcDll.QueryFrustum(api, model, planes, 6, ids, ids.Length));
+
+        // A ray through the middle of the model hits elements in order of distance
+        var distances = new double[elementBounds.Count];
+        var origin = new[] { all[0] - 1, (all[1] + all[4]) / 2, (all[2] + all[5]) / 2 };
+        n = WebIfcDll.QueryRay(api, model, origin, new[] { 1.0, 0, 0 }, double.MaxValue, ids, distances, ids.Length);
+        Assert.IsTrue(n > 0);
+        for (var i = 1; i < n; i++)
+            Assert.IsTrue(distances[i] >= distances[i - 1]);
+
+        // The nearest elements to a corner are sorted by distance
+        n = WebIfcDll.QueryNearest(api, model, new[] { all[0], all[1], all[2] }, ids, distances, 10);
+        Assert.AreEqual(Math.Min(10, elementBounds.Count), n);
+        for (var i = 1; i < n; i++)
+            Assert.IsTrue(distances[i] >= distances[i - 1]);
+
+        WebIfcDll.FinalizeApi(api);
+    }
+
+    [Test]
+    public static unsafe void TestBatches()
+    {
+        var logger = CreateLogger();
+        var api = WebIfcDll.InitializeApi();
+        var model = WebIfcDll.LoadModel(api, inputFile);
+        WebIfcDll.GetMeshCounts(api, model, out var meshCounts);
+
+        WebIfcDll.GetBatchCounts(api, model, 0, out var counts);
+        logger.Log($"{meshCounts.NumMeshes} meshes merged into {counts.NumBatches} batches with {counts.NumRanges} pick ranges");
+        Assert.IsTrue(counts.NumBatches > 0);
+        Assert.IsTrue(counts.NumBatches < meshCounts.NumMeshes);
+        Assert.IsTrue(counts.NumVertices <= meshCounts.NumVertices);
+        Assert.IsTrue(counts.NumIndices <= meshCounts.NumIndices);
+
+        var stride = WebIfcDll.GetVertexStride(VertexFormat.Float);
+        var vertices = new byte[counts.NumVertices * stride];
+        var indices = new uint[counts.NumIndices];
+        var vertexCounts = new int[counts.NumBatches];
+        var indexOffsets = new long[counts.NumBatches];
+        var indexCounts = new int[counts.NumBatches];
+        var colors = new double[counts.NumBatches * 4];
+        var rangeOffsets = new long[counts.NumBatches];
+        var rangeCounts = new int[counts.NumBatches];
+        var rangeElementIds = new uint[counts.NumRanges];
+        var rangeFirstIndices = new int[counts.NumRanges];
+        var rangeIndexCounts = new int[counts.NumRanges];
+        fixed (byte* verticesPtr = vertices)
+        fixed (uint* indicesPtr = indices)
+        fixed (int* vertexCountsPtr = vertexCounts)
+        fixed (long* indexOffsetsPtr = indexOffsets)
+        fixed (int* indexCountsPtr = indexCounts)
+        fixed (double* colorsPtr = colors)
+        fixed (long* rangeOffsetsPtr = rangeOffsets)
+        fixed (int* rangeCountsPtr = rangeCounts)
+        fixed (uint* rangeElementIdsPtr = rangeElementIds)
+        fixed (int* rangeFirstIndicesPtr = rangeFirstIndices)
+        fixed (int* rangeIndexCountsPtr = rangeIndexCounts)
+        {
+            var encoding = new VertexEncoding { Format = VertexFormat.Float, WorldSpace = true };
+            var buffers = new BatchBuffers
+            {
+                Vertices = (IntPtr)verticesPtr,
+                Indices = (IntPtr)indicesPtr,
+                VertexCounts = (IntPtr)vertexCountsPtr,
+                IndexOffsets = (IntPtr)indexOffsetsPtr,
+                IndexCounts = (IntPtr)indexCountsPtr,
+                Colors = (IntPtr)colorsPtr,
+                RangeOffsets = (IntPtr)rangeOffsetsPtr,
+                RangeCounts = (IntPtr)rangeCountsPtr,
+                RangeElementIds = (IntPtr)rangeElementIdsPtr,
+                RangeFirstIndices = (IntPtr)rangeFirstIndicesPtr,
+                RangeIndexCounts = (IntPtr)rangeIndexCountsPtr,
+            };
+            Assert.AreEqual(counts.NumBatches, WebIfcDll.ExportBatches(api, model, 0, ref encoding, ref buffers));
+        }
+
+        // Every batch draws its own vertices, and its ranges cover its indices in order
+        var transparent = false;
+        for (var i = 0; i < counts.NumBatches; i++)
+        {
+            for (var j = 0; j < indexCounts[i]; j++)
+                Assert.IsTrue(indices[indexOffsets[i] + j] < vertexCounts[i]);
+            var next = 0;
+            for (var r = rangeOffsets[i]; r < rangeOffsets[i] + rangeCounts[i]; r++)
+            {
+                Assert.AreEqual(next, rangeFirstIndices[r]);
+                next += rangeIndexCounts[r];
+            }
+            Assert.AreEqual(indexCounts[i], next);
+
+            if (colors[i * 4 + 3] < 1)
+                transparent = true;
+            else
+                Assert.IsFalse(transparent, "Opaque batches come first");
+        }
+        var elementIds = new ExportedMeshes(api, model).ElementIds.ToHashSet();
+        Assert.IsTrue(rangeElementIds.All(elementIds.Contains));
+
+        // A vertex limit splits batches
+        WebIfcDll.GetBatchCounts(api, model, 1000, out var limited);
+        logger.Log($"{limited.NumBatches} batches of at most 1000 vertices");
+        Assert.IsTrue(limited.NumBatches > counts.NumBatches);
+        Assert.AreEqual(counts.NumVertices, limited.NumVertices);
+
+        WebIfcDll.FinalizeApi(api);
+    }
+
+    [Test]
+    public static void TestExportGlb()
+    {
+        var logger = CreateLogger();
+        var api = WebIfcDll.InitializeApi();
+        var model = WebIfcDll.LoadModel(api, inputFile);
+        WebIfcDll.GetInstanceCounts(api, model, 1, out var instanceCounts);
+
+        var glbPath = Path.Combine(Path.GetTempPath(), "web-ifc-export.glb");
+        var options = GlbOptions.Default;
+        var length = WebIfcDll.ExportGlb(api, model, glbPath, ref options);
+        var bytes = File.ReadAllBytes(glbPath);
+        logger.Log($"Wrote {length} bytes for {instanceCounts.NumGeometries} geometries and {instanceCounts.NumInstances} instances");
+        Assert.AreEqual(bytes.Length, length);
+
+        // Header, then a JSON chunk and a BIN chunk filling the rest of the file
+        Assert.AreEqual(0x46546C67u, BitConverter.ToUInt32(bytes, 0));
+        Assert.AreEqual(2u, BitConverter.ToUInt32(bytes, 4));
+        Assert.AreEqual((uint)bytes.Length, BitConverter.ToUInt32(bytes, 8));
+        var jsonLength = BitConverter.ToInt32(bytes, 12);
+        Assert.AreEqual(0x4E4F534Au, BitConverter.ToUInt32(bytes, 16));
+        var binLength = BitConverter.ToInt32(bytes, 20 + jsonLength);
+        Assert.AreEqual(0x004E4942u, BitConverter.ToUInt32(bytes, 24 + jsonLength));
+        Assert.AreEqual(bytes.Length, 28 + jsonLength + binLength);
+
+        using var json = System.Text.Json.JsonDocument.Parse(new ReadOnlyMemory<byte>(bytes, 20, jsonLength));
+        var root = json.RootElement;
+        Assert.AreEqual(binLength, root.GetProperty("buffers")[0].GetProperty("byteLength").GetInt64());
+        foreach (var view in root.GetProperty("bufferViews").EnumerateArray())
+            Assert.IsTrue(view.GetProperty("byteOffset").GetInt64() + view.GetProperty("byteLength").GetInt64() <= binLength);
+
+        // Each geometry is written once, and every node names its element
+        var elementIds = new ExportedMeshes(api, model).ElementIds.ToHashSet();
+        var nodes = root.GetProperty("nodes");
+        Assert.IsTrue(nodes.GetArrayLength() > 0 && nodes.GetArrayLength() <= instanceCounts.NumInstances);
+        Assert.IsTrue(root.GetProperty("accessors").GetArrayLength() <= instanceCounts.NumGeometries * 3);
+        foreach (var node in nodes.EnumerateArray())
+            Assert.IsTrue(elementIds.Contains(node.GetProperty("extras").GetProperty("expressId").GetUInt32()));
+
+        // The sink receives the same document
+        var stream = new MemoryStream();
+        var n = WebIfcDll.ExportGlbToSink(api, model, ref options, (_, data, size) =>
+        {
+            var chunk = new byte[size];
+            Marshal.Copy(data, chunk, 0, (int)size);
+            stream.Write(chunk);
+            return 1;
+        }, IntPtr.Zero);
+        Assert.AreEqual(length, n);
+        CollectionAssert.AreEqual(bytes, stream.ToArray());
+
+        // With GPU instancing, repeated geometries share a node
+        options.GpuInstancing = 1;
+        var instancedPath = Path.Combine(Path.GetTempPath(), "web-ifc-export-instanced.glb");
+        Assert.IsTrue(WebIfcDll.ExportGlb(api, model, instancedPath, ref options) > 0);
+        var instanced = File.ReadAllBytes(instancedPath);
+        using var instancedJson = System.Text.Json.JsonDocument.Parse(
+            new ReadOnlyMemory<byte>(instanced, 20, BitConverter.ToInt32(instanced, 12)));
+        Assert.IsTrue(instancedJson.RootElement.GetProperty("nodes").GetArrayLength() <= nodes.GetArrayLength());
+
+        WebIfcDll.FinalizeApi(api);
+    }
+
+    [Test]
+    public static void TestExportSpeckle()
+    {
+        var logger = CreateLogger();
+        var api = WebIfcDll.InitializeApi();
+        var model = WebIfcDll.LoadModel(api, inputFile);
+
+        var options = SpeckleOptions.Default;
+        options.ChunkBytes = 1 << 20;
+        var chunks = new List<string>();
+        var rootId = new byte[33];
+        var watch = System.Diagnostics.Stopwatch.StartNew();
+        var n = WebIfcDll.ExportSpeckleToSink(api, model, ref options, (_, data, size) =>
+        {
+            chunks.Add(Marshal.PtrToStringUTF8(data, (int)size));
+            return 1;
+        }, IntPtr.Zero, rootId, rootId.Length);
+        logger.Log($"Wrote {n} Speckle objects in {chunks.Count} chunks in {watch.Elapsed.TotalSeconds:F3}s");
+        Assert.IsTrue(n > 0);
+        Assert.IsTrue(chunks.All(c => c.EndsWith("\n")));
+
+        // Every object is one line, its ID is the hash of the rest of it, and every reference is to a written object
+        var lines = chunks.SelectMany(c => c.Split('\n', StringSplitOptions.RemoveEmptyEntries)).ToList();
+        Assert.AreEqual(n, lines.Count);
+        var ids = new HashSet<string>();
+        var referenced = new HashSet<string>();
+        foreach (var line in lines)
+        {
+            using var json = System.Text.Json.JsonDocument.Parse(line);
+            var id = json.RootElement.GetProperty("id").GetString();
+            var body = "{" + line.Substring(line.IndexOf(',') + 1);
+            var hash = Convert.ToHexString(System.Security.Cryptography.SHA256.HashData(System.Text.Encoding.UTF8.GetBytes(body)));
+            Assert.AreEqual(hash.Substring(0, 32).ToLowerInvariant(), id);
+            Assert.IsTrue(ids.Add(id));
+            foreach (var match in System.Text.RegularExpressions.Regex.Matches(line, "\"referencedId\":\"([0-9a-f]{32})\"").Cast<System.Text.RegularExpressions.Match>())
+                referenced.Add(match.Groups[1].Value);
+        }
+        Assert.IsTrue(referenced.IsSubsetOf(ids));
+
+        // The root comes last, and its closure holds every other object
+        var root = System.Text.Encoding.ASCII.GetString(rootId, 0, 32);
+        using var rootJson = System.Text.Json.JsonDocument.Parse(lines.Last());
+        Assert.AreEqual(root, rootJson.RootElement.GetProperty("id").GetString());
+        Assert.AreEqual(n - 1, rootJson.RootElement.GetProperty("totalChildrenCount").GetInt64());
+
+        // Every element with geometry is written with its express ID
+        var elementIds = new ExportedMeshes(api, model).ElementIds.ToHashSet();
+        var written = lines.Select(l => System.Text.Json.JsonDocument.Parse(l).RootElement)
+            .Where(e => e.TryGetProperty("expressID", out _))
+            .Select(e => e.GetProperty("expressID").GetUInt32()).ToHashSet();
+        Assert.IsTrue(elementIds.IsSubsetOf(written));
+
+        WebIfcDll.FinalizeApi(api);
+    }
+
+    [Test]
+    public static void TestGlobalIds()
+    {
+        var logger = CreateLogger();
+        var api = WebIfcDll.InitializeApi();
+        var model = WebIfcDll.LoadModel(api, inputFile);
+
+        var watch = System.Diagnostics.Stopwatch.StartNew();
+        WebIfcDll.GetGlobalIdTableCounts(api, model, out var counts);
+        WebIfcDll.GetGlobalIdTableArrays(api, model, out var arrays);
+        logger.Log($"Decoded {counts.NumIds} GlobalIds ({counts.NumDuplicates} duplicates) in {watch.Elapsed.TotalSeconds:F3}s");
+        Assert.IsTrue(counts.NumIds > 0);
+
+        var n = (int)counts.NumIds;
+        var ids = GetInts(arrays.ExpressIds, n).Select(id => (uint)id).ToArray();
+        var guids = new byte[n * 16];
+        Marshal.Copy(arrays.Guids, guids, 0, guids.Length);
+
+        // Lookups agree with the table in both directions
+        var found = new byte[n * 16];
+        Assert.AreEqual(n, WebIfcDll.GetGlobalIds(api, model, ids, n, found));
+        CollectionAssert.AreEqual(guids, found);
+        var foundIds = new uint[n];
+        Assert.AreEqual(n, WebIfcDll.GetExpressIdsOfGlobalIds(api, model, guids, n, foundIds));
+        for (var i = 0; i < n; i++)
+            Assert.IsTrue(foundIds[i] <= ids[i]);
+        if (counts.NumDuplicates == 0)
+            CollectionAssert.AreEqual(ids, foundIds);
+
+        // Express IDs without a GlobalId map to zero bytes
+        var none = new byte[16];
+        Assert.AreEqual(0, WebIfcDll.GetGlobalIds(api, model, new uint[] { uint.MaxValue }, 1, none));
+        Assert.IsTrue(none.All(b => b == 0));
+
+        // Encoding and decoding round trip
+        var text = new byte[23];
+        var guid = new byte[16];
+        for (var i = 0; i < Math.Min(n, 1000); i++)
+        {
+            var expected = guids.AsSpan(i * 16, 16).ToArray();
+            WebIfcDll.EncodeGlobalId(expected, text);
+            Assert.AreEqual(1, WebIfcDll.DecodeGlobalId(System.Text.Encoding.ASCII.GetString(text, 0, 22), guid));
+            CollectionAssert.AreEqual(expected, guid);
+        }
+        Assert.AreEqual(0, WebIfcDll.DecodeGlobalId("not a GlobalId", guid));
+
+        WebIfcDll.FinalizeApi(api);
+    }
+
+    [Test]
+    public static void TestReloadModel()
+    {
+        var logger = CreateLogger();
+        var api = WebIfcDll.InitializeApi();
+        var previous = WebIfcDll.LoadModel(api, inputFile);
+        var expected = new ExportedMeshes(api, previous);
+        var options = LoadOptions.Default;
+
+        // Reloading the same file changes nothing, and reuses the geometry
+        var watch = System.Diagnostics.Stopwatch.StartNew();
+        var same = WebIfcDll.ReloadModel(api, previous, inputFile, ref options);
+        WebIfcDll.GetChangeSetCounts(api, same, out var counts);
+        logger.Log($"Reloaded in {watch.Elapsed.TotalSeconds:F3}s: {counts.NumUnchanged} unchanged, {counts.NumReused} reused, {counts.NumTessellated} tessellated, hashed in {counts.HashSeconds:F3}s");
+        Assert.AreEqual(0, counts.NumAdded);
+        Assert.AreEqual(0, counts.NumRemoved);
+        Assert.AreEqual(0, counts.NumModified);
+        Assert.IsTrue(counts.NumReused > 0);
+        var reloaded = new ExportedMeshes(api, same);
+        Assert.AreEqual(expected.Counts, reloaded.Counts);
+        CollectionAssert.AreEqual(expected.ElementIds, reloaded.ElementIds);
+        CollectionAssert.AreEqual(expected.Vertices, reloaded.Vertices);
+        CollectionAssert.AreEqual(expected.Indices, reloaded.Indices);
+
+        // Deleting the line of an element removes it, and leaves the other elements unchanged
+        var removedId = expected.ElementIds[0];
+        var text = System.Text.Encoding.Latin1.GetString(File.ReadAllBytes(inputFile));
+        var edited = System.Text.RegularExpressions.Regex.Replace(text, $@"^#{removedId}\s*=[^;]*;\r?\n", "",
+            System.Text.RegularExpressions.RegexOptions.Multiline);
+        Assert.AreNotEqual(text.Length, edited.Length);
+        var bytes = System.Text.Encoding.Latin1.GetBytes(edited);
+        var data = Marshal.AllocHGlobal(bytes.Length);
+        try
+        {
+            Marshal.Copy(bytes, 0, data, bytes.Length);
+            var revision = WebIfcDll.ReloadModelFromBuffer(api, previous, data, (UIntPtr)bytes.Length, ref options);
+            WebIfcDll.GetChangeSetCounts(api, revision, out var revisionCounts);
+            WebIfcDll.GetChangeSetArrays(api, revision, out var arrays);
+            logger.Log($"Reloaded edit: {revisionCounts.NumRemoved} removed, {revisionCounts.NumModified} modified, {revisionCounts.NumTessellated} tessellated");
+            Assert.AreEqual(0, revisionCounts.NumAdded);
+            Assert.AreEqual(1, revisionCounts.NumRemoved);
+            Assert.AreEqual(removedId, (uint)Marshal.ReadInt32(arrays.RemovedIds));
+            Assert.IsTrue(revisionCounts.NumTessellated < counts.NumUnchanged);
+
+            // The reloaded models do not depend on the previous one
+            WebIfcDll.UnloadModel(api, previous);
+            Assert.IsFalse(new ExportedMeshes(api, revision).ElementIds.Contains(removedId));
+            CollectionAssert.AreEqual(expected.Vertices, new ExportedMeshes(api, same).Vertices);
+        }
+        finally
+        {
+            WebIfcDll.FinalizeApi(api);
+            Marshal.FreeHGlobal(data);
+        }
+    }
 }